@@ -2,13 +2,19 @@
 
 
 #include "Mammals/TBMammalBase.h"
+#include "TBTurnedBasedManager.h"
+#include "SquareMapGeneration/TBGridFields.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "TBProfiler.h"
 
 // Sets default values
 ATBMammalBase::ATBMammalBase()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Movement is interpolated by the manager's movement system, mammals never tick
+	PrimaryActorTick.bCanEverTick = false;
+
+	// the manager can put its mammals in a garbage collection cluster
+	bCanBeInCluster = true;
 
 	MammalMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("MammalMeshComp"));
 	RootComponent = MammalMesh;
@@ -17,6 +23,10 @@ ATBMammalBase::ATBMammalBase()
 	StarveCounter = 0;
 	bCanEat = false;
 	bCanBreed = true;
+	bCanHunt = true;
+	bCanEvade = true;
+	Species = ETBMammalSpecies::Mouse;
+	PreyMask = 0;
 }
 
 // Called when the game starts or when spawned
@@ -26,40 +36,43 @@ void ATBMammalBase::BeginPlay()
 	
 }
 
-// Called every frame
-void ATBMammalBase::Tick(float DeltaTime)
+void ATBMammalBase::SetCurrentTile(const FTBTileHandle TargetPos)
 {
-	Super::Tick(DeltaTime);
-
-	// do smooth interpolation 
-	if(bMoveStarted)
-	{
-		SetActorLocation(UKismetMathLibrary::VInterpTo(
-			GetActorLocation(), CurrentMoveTargetPosition, DeltaTime, MoveInterpSpeed));
+	CurrentTile = TargetPos;
+}
 
-		if(GetActorLocation().Equals(CurrentMoveTargetPosition, 0.01))
-		{
-			OnMoveFinished(true);
-		}
-	}
+FTBTileHandle ATBMammalBase::GetCurrentTile() const
+{
+	return CurrentTile;
 }
 
-void ATBMammalBase::SetCurrentTile(FTileInfo* TargetPos)
+void ATBMammalBase::SetCounters(const uint8 NewStarveCounter, const uint8 NewBreedCounter, const uint8 NewSavedBreedCounter)
 {
-	CurrentTile = TargetPos;
+	StarveCounter = NewStarveCounter;
+	BreedCounter = NewBreedCounter;
+	SavedBreedCounter = NewSavedBreedCounter;
 }
 
-FTileInfo* ATBMammalBase::GetCurrentTile()
+void ATBMammalBase::ResetForPool()
 {
-	return CurrentTile;
+	Handle.Reset();
+	CurrentTile.Reset();
+	EatTarget.Reset();
+	SetCounters(0, 0, 0);
+
+	OnStarved.Clear();
+	OnKilled.Clear();
+	OnTurnFinished.Clear();
+	OnBred.Clear();
 }
 
 void ATBMammalBase::ExecuteTurn()
 {
-	if(bCanEat)
+	if(bCanEat && PreyMask != 0)
 	{
+		TB_PROFILE_SCOPE(Eat);
 		EatTarget = GetRandomEatTarget();
-		if(EatTarget)
+		if(EatTarget.IsValid())
 		{
 			StartEat(EatTarget);
 			return;
@@ -69,18 +82,21 @@ void ATBMammalBase::ExecuteTurn()
 	StartRandomMove();
 }
 
-FTileInfo* ATBMammalBase::GetRandomEatTarget() const
+FTBTileHandle ATBMammalBase::GetRandomEatTarget() const
 {
-	TArray<FTileInfo*> AdjacentTiles = MapGeneratorRef->GetAllAdjacentTiles(CurrentTile);
+	// temporaries come from the round arena, they are released together at the end of the round
+	FTBRoundArena& RoundArena = TurnBasedManagerRef->GetRoundArena();
+	TTBArenaArray<FTBTileHandle> AdjacentTiles = RoundArena.AllocateArray<FTBTileHandle>(ATBSquareMapGenerator::MaxAdjacentTiles);
+	MapGeneratorRef->GetAllAdjacentTiles(CurrentTile, AdjacentTiles);
 
 	if(AdjacentTiles.Num() <= 0)
-		return nullptr;
+		return FTBTileHandle();
 
-	// find if there any eatable mammal within 1 unit
-	TArray<FTileInfo*> EatableMammalTiles;
+	// find if there any eatable mammal within 1 unit, the tiles store the species so no mammal is resolved
+	TTBArenaArray<FTBTileHandle> EatableMammalTiles = RoundArena.AllocateArray<FTBTileHandle>(AdjacentTiles.Num());
 	for(int i = 0 ; i < AdjacentTiles.Num() ; i++)
 	{
-		if(!AdjacentTiles[i]->bIsEmptyTile && AdjacentTiles[i]->MammalRef && AdjacentTiles[i]->MammalRef->GetClass() == EatableMammalClass)
+		if(MapGeneratorRef->IsTileOccupiedBySpecies(AdjacentTiles[i], PreyMask))
 		{
 			EatableMammalTiles.Add(AdjacentTiles[i]);
 		}
@@ -88,7 +104,7 @@ FTileInfo* ATBMammalBase::GetRandomEatTarget() const
 
 	// nothing eatable
 	if(EatableMammalTiles.Num() <= 0)
-		return nullptr;
+		return FTBTileHandle();
 	
 	// select random target mammal
 	const int RandomIndex = UKismetMathLibrary::RandomIntegerInRange(0, EatableMammalTiles.Num()-1);
@@ -98,7 +114,10 @@ FTileInfo* ATBMammalBase::GetRandomEatTarget() const
 
 void ATBMammalBase::StartRandomMove()
 {
-	const TArray<FTileInfo*> AdjacentEmptyTiles = MapGeneratorRef->GetAllAdjacentEmptyTiles(CurrentTile);
+	TB_PROFILE_SCOPE(Move);
+
+	TTBArenaArray<FTBTileHandle> AdjacentEmptyTiles = TurnBasedManagerRef->GetRoundArena().AllocateArray<FTBTileHandle>(ATBSquareMapGenerator::MaxAdjacentTiles);
+	MapGeneratorRef->GetAllAdjacentEmptyTiles(CurrentTile, AdjacentEmptyTiles);
 
 	if(AdjacentEmptyTiles.Num() <= 0)
 	{
@@ -106,52 +125,57 @@ void ATBMammalBase::StartRandomMove()
 		return;
 	}
 
+	// hunters only keep the tiles closest to the prey, ties are still picked randomly
+	const FTBDistanceField& PreyDistanceField = TurnBasedManagerRef->GetPreyDistanceField();
+	if(bCanEat && bCanHunt && PreyDistanceField.IsBuilt())
+	{
+		PreyDistanceField.KeepClosestTiles(CurrentTile, AdjacentEmptyTiles);
+	}
+
+	// prey keeps the safest tiles, the move has to happen anyway so it doesn't compare them with the current tile
+	const FTBInfluenceMap& ThreatInfluenceMap = TurnBasedManagerRef->GetThreatInfluenceMap();
+	if(!bCanEat && bCanEvade && ThreatInfluenceMap.IsBuilt())
+	{
+		ThreatInfluenceMap.KeepLeastInfluencedTiles(AdjacentEmptyTiles);
+	}
+
 	// empty current tile
-	CurrentTile->bIsEmptyTile = true;
-	CurrentTile->MammalRef = nullptr;
+	MapGeneratorRef->ClearTile(CurrentTile);
 
 	// select random target empty tile to move
 	const int RandomIndex = UKismetMathLibrary::RandomIntegerInRange(0, AdjacentEmptyTiles.Num()-1);
 
-	// set move target position that will be used to interpolate in Tick()
-	CurrentMoveTargetPosition = AdjacentEmptyTiles[RandomIndex]->WordLocation;
-	CurrentMoveTargetPosition.Z = GetActorLocation().Z;
-
 	// apply the move
 	CurrentTile = AdjacentEmptyTiles[RandomIndex];
-	CurrentTile->bIsEmptyTile = false;
-	CurrentTile->MammalRef = this;
-	
+	MapGeneratorRef->SetTileOccupant(CurrentTile, Handle, Species);
 
-	// start the interpolation in Tick()
-	bMoveStarted = true;
-	PrimaryActorTick.bCanEverTick = true;
+	// start the interpolation
+	StartMoveTo(MapGeneratorRef->GetTileWorldLocation(CurrentTile));
 }
 
-void ATBMammalBase::StartEat(const FTileInfo* EatTargetTile)
+void ATBMammalBase::StartEat(const FTBTileHandle EatTargetTile)
 {
 	// empty current tile
-	CurrentTile->bIsEmptyTile = true;
-	CurrentTile->MammalRef = nullptr;
+	MapGeneratorRef->ClearTile(CurrentTile);
 
 	
-	// set move target position that will be used to interpolate in Tick()
-	CurrentMoveTargetPosition = EatTargetTile->WordLocation;
-	CurrentMoveTargetPosition.Z = GetActorLocation().Z;
-	
-	// start the interpolation in Tick()
-	bMoveStarted = true;
-	PrimaryActorTick.bCanEverTick = true;
+	// start the interpolation
+	StartMoveTo(MapGeneratorRef->GetTileWorldLocation(EatTargetTile));
 }
 
-void ATBMammalBase::OnMoveFinished(const bool bWasSuccessful)
+void ATBMammalBase::StartMoveTo(const FVector& TargetPosition)
 {
-	// disable movement in tick
-	bMoveStarted = false;
-	PrimaryActorTick.bCanEverTick = false; 
+	// keep the current height, tiles are below the mammal
+	FVector MoveTargetPosition = TargetPosition;
+	MoveTargetPosition.Z = GetActorLocation().Z;
+
+	TurnBasedManagerRef->RequestMammalMove(this, MoveTargetPosition);
+}
 
+void ATBMammalBase::OnMoveFinished(const bool bWasSuccessful)
+{
 	// if eat target is valid, we requested a move with eat 
-	if(EatTarget)
+	if(EatTarget.IsValid())
 	{
 		//reset starve counter
 		if(bCanStarve)
@@ -159,12 +183,14 @@ void ATBMammalBase::OnMoveFinished(const bool bWasSuccessful)
 
 		
 		//call on killed event for the victim
-		EatTarget->MammalRef->OnKilled.Broadcast(EatTarget->MammalRef);
+		if(ATBMammalBase* Victim = TurnBasedManagerRef->ResolveMammal(MapGeneratorRef->GetTileOccupant(EatTarget)))
+		{
+			Victim->OnKilled.Broadcast(Victim);
+		}
 		
 		//apply the move
 		CurrentTile = EatTarget;
-		CurrentTile->MammalRef = this;
-		CurrentTile->bIsEmptyTile  =false;
+		MapGeneratorRef->SetTileOccupant(CurrentTile, Handle, Species);
 	}
 	else if(bCanStarve)
 	{
@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mammals/TBMammalCluster.h"
+#include "Mammals/TBMammalBase.h"
+
+void UTBMammalCluster::AddMammal(ATBMammalBase* Mammal)
+{
+	Mammals.Add(Mammal);
+
+	// creating the cluster pulls in every actor of Mammals with its components
+	if(!HasAnyInternalFlags(EInternalObjectFlags::ClusterRoot))
+	{
+		CreateCluster();
+		return;
+	}
+	Mammal->AddToCluster(this);
+}
+
+void UTBMammalCluster::RemoveMammal(ATBMammalBase* Mammal)
+{
+	Mammals.RemoveSingleSwap(Mammal, false);
+}
+
+void UTBMammalCluster::RebuildIfDissolved()
+{
+	if(Mammals.Num() > 0 && !HasAnyInternalFlags(EInternalObjectFlags::ClusterRoot))
+	{
+		CreateCluster();
+	}
+}
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mammals/TBMammalMovementSystem.h"
+#include "Mammals/TBMammalBase.h"
+#include "Async/ParallelFor.h"
+
+void FTBMammalMovementSystem::AddMove(ATBMammalBase* Mammal, const FVector& TargetLocation, const float InterpSpeed, const bool bNotifyMammal)
+{
+	if(!Mammal) return;
+
+	// a mammal can only have one active move, restart it if it already has one
+	RemoveMove(Mammal);
+
+	MoveIndices.Add(Mammal, Mammals.Add(Mammal));
+	CurrentLocations.Add(Mammal->GetActorLocation());
+	TargetLocations.Add(TargetLocation);
+	InterpSpeeds.Add(InterpSpeed);
+	NotifyMammals.Add(bNotifyMammal);
+}
+
+void FTBMammalMovementSystem::FinishMoveInstantly(ATBMammalBase* Mammal, const FVector& TargetLocation)
+{
+	RemoveMove(Mammal);
+
+	Mammal->SetActorLocation(TargetLocation);
+	Mammal->OnMoveFinished(true);
+}
+
+void FTBMammalMovementSystem::RemoveMove(const ATBMammalBase* Mammal)
+{
+	int32 Index;
+	if(!MoveIndices.RemoveAndCopyValue(Mammal, Index)) return;
+
+	// the last move takes the freed place, so a removal doesn't shift the arrays
+	Mammals.RemoveAtSwap(Index, 1, false);
+	CurrentLocations.RemoveAtSwap(Index, 1, false);
+	TargetLocations.RemoveAtSwap(Index, 1, false);
+	InterpSpeeds.RemoveAtSwap(Index, 1, false);
+	NotifyMammals.RemoveAtSwap(Index, 1, false);
+	if(Mammals.IsValidIndex(Index))
+	{
+		MoveIndices[Mammals[Index]] = Index;
+	}
+}
+
+void FTBMammalMovementSystem::Tick(const float DeltaTime)
+{
+	const int32 NumMoves = Mammals.Num();
+	if(NumMoves <= 0) return;
+
+	FinishedFlags.SetNumUninitialized(NumMoves, false);
+
+	// interpolate all active moves, this only touches the location arrays so it is safe to run in parallel
+	ParallelFor(NumMoves, [this, DeltaTime](const int32 Index)
+	{
+		CurrentLocations[Index] = FMath::VInterpTo(CurrentLocations[Index], TargetLocations[Index], DeltaTime, InterpSpeeds[Index]);
+		FinishedFlags[Index] = CurrentLocations[Index].Equals(TargetLocations[Index], 0.01);
+	}, NumMoves < ParallelMoveThreshold ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	// push the new locations to the actors in one pass
+	for(int32 i = 0; i < NumMoves; i++)
+	{
+		Mammals[i]->SetActorLocation(CurrentLocations[i]);
+	}
+
+	// remove finished moves before calling OnMoveFinished, because finishing a move can start a new one
+	FinishedMammals.Reset();
+	int32 WriteIndex = 0;
+	for(int32 i = 0; i < NumMoves; i++)
+	{
+		if(FinishedFlags[i])
+		{
+			MoveIndices.Remove(Mammals[i]);
+			if(NotifyMammals[i])
+			{
+				FinishedMammals.Add(Mammals[i]);
+			}
+			continue;
+		}
+
+		Mammals[WriteIndex] = Mammals[i];
+		CurrentLocations[WriteIndex] = CurrentLocations[i];
+		TargetLocations[WriteIndex] = TargetLocations[i];
+		InterpSpeeds[WriteIndex] = InterpSpeeds[i];
+		NotifyMammals[WriteIndex] = NotifyMammals[i];
+		if(WriteIndex != i)
+		{
+			MoveIndices[Mammals[WriteIndex]] = WriteIndex;
+		}
+		WriteIndex++;
+	}
+	Mammals.SetNum(WriteIndex, false);
+	CurrentLocations.SetNum(WriteIndex, false);
+	TargetLocations.SetNum(WriteIndex, false);
+	InterpSpeeds.SetNum(WriteIndex, false);
+	NotifyMammals.SetNum(WriteIndex, false);
+
+	for(ATBMammalBase* Mammal : FinishedMammals)
+	{
+		// a previous callback may have killed this mammal
+		if(IsValid(Mammal))
+		{
+			Mammal->OnMoveFinished(true);
+		}
+	}
+}
+
+void FTBMammalMovementSystem::Reset()
+{
+	Mammals.Reset();
+	CurrentLocations.Reset();
+	TargetLocations.Reset();
+	InterpSpeeds.Reset();
+	NotifyMammals.Reset();
+	MoveIndices.Reset();
+	FinishedFlags.Reset();
+	FinishedMammals.Reset();
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquareMapGeneration/TBBakedMapAsset.h"
+#include "Serialization/CustomVersion.h"
+
+// Layout of the bulk arrays, which are not tagged properties. Add a version for every change and read the old layouts behind it.
+struct FTBBakedMapVersion
+{
+	enum Type
+	{
+		// assets saved before the version was registered have the same arrays as the initial version
+		BeforeCustomVersionWasAdded = 0,
+		InitialVersion = 1,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+const FGuid FTBBakedMapVersion::GUID(0x13384405, 0x085F4125, 0xAE84D042, 0x1B0CE965);
+static FCustomVersionRegistration GRegisterTBBakedMapVersion(FTBBakedMapVersion::GUID, FTBBakedMapVersion::LatestVersion, TEXT("TBBakedMapVersion"));
+
+void UTBBakedMapAsset::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FTBBakedMapVersion::GUID);
+
+	Super::Serialize(Ar);
+
+	// a layout this build doesn't know can't be skipped safely, the generator makes the map at runtime instead
+	if(Ar.IsLoading() && Ar.CustomVer(FTBBakedMapVersion::GUID) > FTBBakedMapVersion::LatestVersion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UTBBakedMapAsset::Serialize -> %s was saved with baked map version %d, this build reads up to %d!"),
+			*GetName(), Ar.CustomVer(FTBBakedMapVersion::GUID), static_cast<int32>(FTBBakedMapVersion::LatestVersion));
+		bHasValidBakedData = false;
+		return;
+	}
+
+	// elements are plain data, so cooked loads read each array with one memory copy instead of element by element
+	BlockWalkableMasks.BulkSerialize(Ar);
+	BlockNumObstacles.BulkSerialize(Ar);
+	TileInstanceLocations.BulkSerialize(Ar);
+	ObstacleInstanceLocations.BulkSerialize(Ar);
+	ObstacleTerrainValues.BulkSerialize(Ar);
+	bHasValidBakedData = !Ar.IsError();
+}
+
+void UTBBakedMapAsset::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetAllocatedSize());
+}
+
+SIZE_T UTBBakedMapAsset::GetAllocatedSize() const
+{
+	return BlockWalkableMasks.GetAllocatedSize() + BlockNumObstacles.GetAllocatedSize() + TileInstanceLocations.GetAllocatedSize()
+		+ ObstacleInstanceLocations.GetAllocatedSize() + ObstacleTerrainValues.GetAllocatedSize();
+}
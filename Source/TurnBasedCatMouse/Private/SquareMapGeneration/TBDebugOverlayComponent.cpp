@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquareMapGeneration/TBDebugOverlayComponent.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Debug/DebugDrawService.h"
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "GameFramework/PlayerController.h"
+
+UTBDebugOverlayComponent::UTBDebugOverlayComponent()
+{
+	// drawing happens in the debug draw service callback, no need to tick
+	PrimaryComponentTick.bCanEverTick = false;
+
+	DebugTileRadius = 12;
+	CatTextColor = FColor::Orange;
+	MouseTextColor = FColor::White;
+	HoveredTextColor = FColor::Yellow;
+}
+
+void UTBDebugOverlayComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	DrawDelegateHandle = UDebugDrawService::Register(TEXT("Game"), FDebugDrawDelegate::CreateUObject(this, &UTBDebugOverlayComponent::DrawOverlay));
+}
+
+void UTBDebugOverlayComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UDebugDrawService::Unregister(DrawDelegateHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UTBDebugOverlayComponent::SetMammalCounters(const FTBMammalHandle Mammal, const FTBMammalDebugCounters& Counters)
+{
+	const int32 Index = Mammal.GetIndex();
+	if(Index >= MammalCounters.Num())
+	{
+		MammalCounters.SetNum(Index + 1);
+	}
+	MammalCounters[Index] = Counters;
+}
+
+void UTBDebugOverlayComponent::ResetMammalCounters()
+{
+	MammalCounters.Reset();
+}
+
+void UTBDebugOverlayComponent::DrawOverlay(UCanvas* Canvas, APlayerController* PlayerController)
+{
+	const ATBSquareMapGenerator* MapGenerator = Cast<ATBSquareMapGenerator>(GetOwner());
+	if(!MapGenerator || !MapGenerator->ShowDebug || !Canvas || !PlayerController || !PlayerController->PlayerCameraManager) return;
+
+	// find the tile the camera looks at on the map plane
+	const FVector CameraLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+	const FVector CameraDirection = PlayerController->PlayerCameraManager->GetCameraRotation().Vector();
+	const FVector MapOrigin = MapGenerator->GetTileWorldLocation(0, 0);
+
+	FVector FocusLocation = CameraLocation;
+	if(!FMath::IsNearlyZero(CameraDirection.Z))
+	{
+		FocusLocation = FMath::LinePlaneIntersection(CameraLocation, CameraLocation + CameraDirection, MapOrigin, FVector::UpVector);
+	}
+	const FIntPoint FocusTile = MapGenerator->GetTileCoordinatesAtWorldLocation(FocusLocation);
+
+	// only the tiles around the focus are drawn, the rest of the map costs nothing
+	const int32 MapSize = MapGenerator->GetSquareMapSize();
+	const int32 MinX = FMath::Max(FocusTile.X - DebugTileRadius, 0);
+	const int32 MaxX = FMath::Min(FocusTile.X + DebugTileRadius, MapSize - 1);
+	const int32 MinY = FMath::Max(FocusTile.Y - DebugTileRadius, 0);
+	const int32 MaxY = FMath::Min(FocusTile.Y + DebugTileRadius, MapSize - 1);
+
+	for(int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		for(int32 X = MinX; X <= MaxX; X++)
+		{
+			DrawTileCounters(Canvas, PlayerController, MapGenerator, MapGenerator->GetTileAt(X, Y), false);
+		}
+	}
+
+	// the hovered tile is always drawn, even outside of the radius
+	FHitResult HitResult;
+	if(PlayerController->GetHitResultUnderCursor(ECC_Visibility, false, HitResult))
+	{
+		const FIntPoint HoveredTile = MapGenerator->GetTileCoordinatesAtWorldLocation(HitResult.Location);
+		DrawTileCounters(Canvas, PlayerController, MapGenerator, MapGenerator->GetTileAt(HoveredTile.X, HoveredTile.Y), true);
+	}
+}
+
+void UTBDebugOverlayComponent::DrawTileCounters(UCanvas* Canvas, APlayerController* PlayerController, const ATBSquareMapGenerator* MapGenerator, const FTBTileHandle Tile, const bool bIsHovered) const
+{
+	if(!Tile.IsValid()) return;
+
+	const FTBMammalHandle Mammal = MapGenerator->GetTileOccupant(Tile);
+	if(!Mammal.IsValid() || !MammalCounters.IsValidIndex(Mammal.GetIndex())) return;
+
+	FVector2D ScreenLocation;
+	const FVector TextLocation = MapGenerator->GetTileWorldLocation(Tile) + FVector(0, 0, MapGenerator->GetTileHalfExtents().Z * 4);
+	if(!PlayerController->ProjectWorldLocationToScreen(TextLocation, ScreenLocation)) return;
+
+	const FTBMammalDebugCounters& Counters = MammalCounters[Mammal.GetIndex()];
+	const FString Text = FString::Printf(TEXT("S:%d B:%d (%d)"), Counters.StarveCounter, Counters.BreedCounter, Counters.SavedBreedCounter);
+
+	if(bIsHovered)
+	{
+		Canvas->SetDrawColor(HoveredTextColor);
+	}
+	else
+	{
+		Canvas->SetDrawColor(MapGenerator->GetTileOccupantSpecies(Tile) == ETBMammalSpecies::Cat ? CatTextColor : MouseTextColor);
+	}
+	Canvas->DrawText(GEngine->GetSmallFont(), Text, ScreenLocation.X, ScreenLocation.Y);
+}
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquareMapGeneration/TBGridFields.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+bool FTBDistanceField::Build(const ATBSquareMapGenerator& Map, const TArray<FTBTileHandle>& Sources, const int32 InMaxDistance)
+{
+	bIsBuilt = false;
+
+	// the settings are blueprint writable, the editor clamp doesn't protect them
+	const int32 MaxDistance = FMath::Max(InMaxDistance, 1);
+
+	const int32 MapSize = Map.GetSquareMapSize();
+	if(MapSize > MaxMapSize) return false;
+
+	const int32 NumTiles = MapSize * MapSize;
+	Distances.SetNumUninitialized(NumTiles, false);
+	Frontier.SetNumUninitialized(NumTiles, false);
+	NextFrontier.SetNumUninitialized(NumTiles, false);
+
+	// all bytes 0xFF is Unreached
+	FMemory::Memset(Distances.GetData(), 0xFF, NumTiles * sizeof(int32));
+
+	int32 FrontierNum = 0;
+	for(const FTBTileHandle Source : Sources)
+	{
+		if(Map.IsValidTile(Source) && Distances[Source.GetIndex()] == Unreached)
+		{
+			Distances[Source.GetIndex()] = 0;
+			Frontier[FrontierNum++] = Source;
+		}
+	}
+
+	for(int32 Distance = 1; Distance <= MaxDistance && FrontierNum > 0; Distance++)
+	{
+		// every tile of the wave is expanded at once, the first thread to reach a tile claims it for the next wave.
+		// All claimers would write the same distance, so the field does not depend on the thread order.
+		int32 NextFrontierNum = 0;
+		ParallelFor(FrontierNum, [this, &Map, Distance, &NextFrontierNum](const int32 Index)
+		{
+			Map.ForEachAdjacentTile(Frontier[Index], [this, &Map, Distance, &NextFrontierNum](const FTBTileHandle Tile)
+			{
+				// other threads claim cells concurrently, the early out must be an atomic read too
+				int32* Cell = &Distances[Tile.GetIndex()];
+				if(FPlatformAtomics::AtomicRead_Relaxed(Cell) != Unreached || !Map.IsTileWalkable(Tile)) return;
+
+				if(FPlatformAtomics::InterlockedCompareExchange(Cell, Distance, Unreached) == Unreached)
+				{
+					NextFrontier[FPlatformAtomics::InterlockedIncrement(&NextFrontierNum) - 1] = Tile;
+				}
+			});
+		}, FrontierNum < ParallelWaveThreshold ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+		Swap(Frontier, NextFrontier);
+		FrontierNum = NextFrontierNum;
+	}
+
+	bIsBuilt = true;
+	return true;
+}
+
+void FTBDistanceField::Reset()
+{
+	bIsBuilt = false;
+}
+
+bool FTBInfluenceMap::Build(const ATBSquareMapGenerator& Map, const TArray<FTBTileHandle>& Sources, const int32 InRadius)
+{
+	bIsBuilt = false;
+
+	// the windows read Radius tiles back, a radius below 1 would read before the rows
+	const int32 Radius = FMath::Max(InRadius, 1);
+
+	const int32 MapSize = Map.GetSquareMapSize();
+	if(MapSize > MaxMapSize) return false;
+
+	const int32 NumTiles = MapSize * MapSize;
+	Influence.SetNumZeroed(NumTiles, false);
+	RowSums.SetNumUninitialized(NumTiles, false);
+
+	for(const FTBTileHandle Source : Sources)
+	{
+		if(Map.IsValidTile(Source))
+		{
+			Influence[Source.GetIndex()] += 1.f;
+		}
+	}
+
+	// horizontal pass, a running sum over the window of each row
+	ParallelFor(MapSize, [this, MapSize, Radius](const int32 Y)
+	{
+		const float* Row = &Influence[Y * MapSize];
+		float* OutRow = &RowSums[Y * MapSize];
+
+		float Sum = 0;
+		for(int32 X = 0; X < FMath::Min(Radius, MapSize); X++)
+		{
+			Sum += Row[X];
+		}
+		for(int32 X = 0; X < MapSize; X++)
+		{
+			if(X + Radius < MapSize) Sum += Row[X + Radius];
+			OutRow[X] = Sum;
+			if(X - Radius >= 0) Sum -= Row[X - Radius];
+		}
+	});
+
+	// vertical pass, the same running sum down the columns, 4 columns at once
+	const int32 NumColumnGroups = MapSize / 4;
+	ParallelFor(NumColumnGroups + 1, [this, MapSize, Radius, NumColumnGroups](const int32 Group)
+	{
+		if(Group < NumColumnGroups)
+		{
+			const int32 X = Group * 4;
+			VectorRegister4Float Sum = VectorZeroFloat();
+			for(int32 Y = 0; Y < FMath::Min(Radius, MapSize); Y++)
+			{
+				Sum = VectorAdd(Sum, VectorLoad(&RowSums[Y * MapSize + X]));
+			}
+			for(int32 Y = 0; Y < MapSize; Y++)
+			{
+				if(Y + Radius < MapSize) Sum = VectorAdd(Sum, VectorLoad(&RowSums[(Y + Radius) * MapSize + X]));
+				VectorStore(Sum, &Influence[Y * MapSize + X]);
+				if(Y - Radius >= 0) Sum = VectorSubtract(Sum, VectorLoad(&RowSums[(Y - Radius) * MapSize + X]));
+			}
+			return;
+		}
+
+		// the columns that don't fill a register
+		for(int32 X = NumColumnGroups * 4; X < MapSize; X++)
+		{
+			float Sum = 0;
+			for(int32 Y = 0; Y < FMath::Min(Radius, MapSize); Y++)
+			{
+				Sum += RowSums[Y * MapSize + X];
+			}
+			for(int32 Y = 0; Y < MapSize; Y++)
+			{
+				if(Y + Radius < MapSize) Sum += RowSums[(Y + Radius) * MapSize + X];
+				Influence[Y * MapSize + X] = Sum;
+				if(Y - Radius >= 0) Sum -= RowSums[(Y - Radius) * MapSize + X];
+			}
+		}
+	});
+
+	bIsBuilt = true;
+	return true;
+}
+
+void FTBInfluenceMap::Reset()
+{
+	bIsBuilt = false;
+}
@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquareMapGeneration/TBHexMapGenerator.h"
+
+ATBHexMapGenerator::ATBHexMapGenerator()
+{
+	GridTopology = ETBGridTopology::Hex;
+}
+
+bool ATBHexMapGenerator::GenerateSquareMap()
+{
+	// the topology is what makes this a hex map, don't let the blueprint defaults change it
+	GridTopology = ETBGridTopology::Hex;
+
+	return Super::GenerateSquareMap();
+}
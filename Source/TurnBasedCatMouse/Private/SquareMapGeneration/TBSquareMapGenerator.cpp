@@ -2,21 +2,62 @@
 
 
 #include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "SquareMapGeneration/TBDebugOverlayComponent.h"
+#include "SquareMapGeneration/TBTileHeatmapComponent.h"
+#include "SquareMapGeneration/TBBakedMapAsset.h"
 #include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Algo/StableSort.h"
+#include "Async/ParallelFor.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "TBProfiler.h"
+
+// Shared by every generator, a respawned generator must not hand out the generation of a previous map again
+static FTBTileHandle::StorageType TBLastMapGeneration = 0;
 
 // Sets default values
 ATBSquareMapGenerator::ATBSquareMapGenerator()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
 	SquareMapSize = 8;
+	bUseSparseGrid = false;
+	RenderChunkRadius = 4;
+	NumChunksPerSide = 0;
+	MapGeneration = 0;
+	TileJournal = nullptr;
+	bUseMortonTileLayout = false;
+	bIsMortonTileLayout = false;
+	GridTopology = ETBGridTopology::Square4;
+	MapTopology = ETBGridTopology::Square4;
+	RowSpacing = 0;
+	OddRowShift = 0;
+	ObstacleDensity = 0;
+	TerrainNoiseScale = 0.08f;
+	TerrainSeed = 0;
+	MapObstacleDensity = 0;
+	MapTerrainNoiseScale = 0;
+	WaterThreshold = -1;
+	RockThreshold = 1;
+	bUsePerMammalDebugWidgets = false;
+	MapMemoryBudgetMB = 512;
+	BakedMap = nullptr;
+	bIsTileInstanceFlushScheduled = false;
 
 	InstancedStaticMeshComponent = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("InstancedStaticMeshComponent"));
 	InstancedStaticMeshComponent->SetupAttachment(RootComponent);
+
+	ObstacleMeshComponent = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("ObstacleMeshComponent"));
+	ObstacleMeshComponent->SetupAttachment(RootComponent);
+	ObstacleMeshComponent->NumCustomDataFloats = 1;
+
+	DebugOverlayComponent = CreateDefaultSubobject<UTBDebugOverlayComponent>(TEXT("DebugOverlayComponent"));
+
+	TileHeatmapComponent = CreateDefaultSubobject<UTBTileHeatmapComponent>(TEXT("TileHeatmapComponent"));
 	
 	//TileScale = FVector(1,1,1);
 
@@ -56,295 +97,1181 @@ void ATBSquareMapGenerator::BeginPlay()
 	
 }
 
+void ATBSquareMapGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	DestroyBorderWalls();
+}
+
+void ATBSquareMapGenerator::DestroyBorderWalls()
+{
+	for(AActor* Wall : BorderWalls)
+	{
+		if(IsValid(Wall))
+		{
+			Wall->Destroy();
+		}
+	}
+	BorderWalls.Reset();
+}
+
 bool ATBSquareMapGenerator::GenerateSquareMap()
 {
+	TB_PROFILE_SCOPE(Generation);
+
 	if(!InstancedStaticMeshComponent->GetStaticMesh()) return false;
-	
-	// clamp to min 8x8, max 99x99;
-	SquareMapSize = FMath::Clamp(SquareMapSize, 2, 999);
 
-	Tiles.Empty();
+	InitializeMapGrid(GetActorLocation());
 
-	
-	// Resize the outer array to match the SquareMapSize
-	Tiles.SetNum(SquareMapSize);
+	// obstacles are not empty tiles, take them out of the summaries before any mammal is placed
+	const bool bUseBakedMap = CanUseBakedMap();
+	if(bUseBakedMap)
+	{
+		LoadBakedWalkableMasks();
+	}
+	else
+	{
+		GenerateWalkableMasks();
+	}
 
-	const FVector StartLoc = GetActorLocation();
-	FVector CurrentLoc  = StartLoc;
-	
+	// bind the heatmap before any chunk is streamed in, streamed components copy the tile material.
+	// The material maps world locations to texels on a square layout, so hex maps have no heatmap.
+	TileHeatmapComponent->InitializeHeatmap(MapTopology == ETBGridTopology::Hex ? nullptr : InstancedStaticMeshComponent, SquareMapSize, GetTileWorldLocation(0, 0),
+		FVector2D(TileHalfExtents.X * 2, -TileHalfExtents.Y * 2));
 
-	//spawn tiles
-	for (int y = 0; y < SquareMapSize; y++)
+	// stream out the chunks of the previous map, pooled components are reused
+	for(const TPair<int32, int32>& StreamedChunk : StreamedChunkMeshComponents)
 	{
-		// Resize each inner array to match the SquareMapSize
-		Tiles[y].SetNum(SquareMapSize);
+		ChunkMeshComponentPool[StreamedChunk.Value]->SetVisibility(false);
+		ChunkObstacleComponentPool[StreamedChunk.Value]->SetVisibility(false);
+		FreeChunkMeshComponents.Add(StreamedChunk.Value);
+	}
+	StreamedChunkMeshComponents.Reset();
+	ObstacleMeshComponent->ClearInstances();
 
-		CurrentLoc.X = StartLoc.X;
-		
-		for(int x = 0; x < SquareMapSize; x++)
+	// queued changes point to the instances of the previous map
+	PendingTileTransforms.Reset();
+	PendingTileCustomData.Reset();
+
+	if(bUseSparseGrid)
+	{
+		// chunks are allocated on demand and meshes are streamed in Tick()
+		LastCameraChunk = FIntPoint(INDEX_NONE, INDEX_NONE);
+		SetActorTickEnabled(true);
+
+		// sparse maps only render the streamed chunks
+		InstancedStaticMeshComponent->ClearInstances();
+	}
+	else
+	{
+		SetActorTickEnabled(false);
+
+		// allocate all the chunks up front
+		for(int ChunkY = 0; ChunkY < NumChunksPerSide; ChunkY++)
 		{
-			FTransform Transform;
-			Transform.SetLocation(CurrentLoc);
-			InstancedStaticMeshComponent->AddInstance(Transform, true);
-
-			
-			// save the tile 
-			//Tiles2D[y][x] = FTileInfo(FVector2D(x,y), CurrentLoc, true, nullptr);
-			
-			
-
-			FTileInfo* Tile = new FTileInfo(FVector2D(x,y), CurrentLoc, true, nullptr);
-			Tiles[y][x] = Tile;
-			AllTiles.Add(Tile);
-			
-			// move right by tile extents
-			CurrentLoc.X += TileHalfExtents.X * 2;
+			for(int ChunkX = 0; ChunkX < NumChunksPerSide; ChunkX++)
+			{
+				GetOrAllocateChunk(ChunkX, ChunkY);
+			}
 		}
 
-		// move down by tile extents
-		CurrentLoc.Y -= TileHalfExtents.Y * 2;
+		//spawn tiles, obstacles of the whole map go to one instanced component
+		if(bUseBakedMap)
+		{
+			UpdateDenseTileInstances(BakedMap->TileInstanceLocations);
+			AddObstacleInstances(ObstacleMeshComponent, BakedMap->ObstacleInstanceLocations, BakedMap->ObstacleTerrainValues);
+		}
+		else
+		{
+			TArray<FVector> TileLocations;
+			BuildTileInstanceLocations(TileLocations);
+			UpdateDenseTileInstances(TileLocations);
+			AddObstacleInstances(ObstacleMeshComponent, FIntPoint(0, 0), FIntPoint(SquareMapSize - 1, SquareMapSize - 1));
+		}
 	}
 	// -Y is North, +X is East 
 
 	//spawn walls
-	SpawnBorderWalls();
-	
+	TArray<FTransform> WallPlacements;
+	FVector MapMiddle;
+	if(bUseBakedMap)
+	{
+		MapMiddle = BakedMap->SquareMapMiddle;
+		WallPlacements = BakedMap->BorderWallPlacements;
+	}
+	else
+	{
+		GetBorderWallPlacements(MapMiddle, WallPlacements);
+	}
+	SquareMapMiddle = MapStartLocation + MapMiddle;
+
+	DestroyBorderWalls();
+	if(WallClass)
+	{
+		SpawnBorderWalls(WallPlacements);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("ATBSquareMapGenerator::GenerateSquareMap -> %dx%d map %s"), SquareMapSize, SquareMapSize,
+		bUseBakedMap ? TEXT("loaded from the baked map") : TEXT("generated"));
 	return true;
 }
 
+void ATBSquareMapGenerator::InitializeMapGrid(const FVector& StartLocation)
+{
+	// clamp to min 2x2, max 999x999 or MaxSparseSquareMapSize in sparse mode
+	SquareMapSize = FMath::Clamp(SquareMapSize, 2, bUseSparseGrid ? MaxSparseSquareMapSize : 999);
+
+	MapStartLocation = StartLocation;
 
-void ATBSquareMapGenerator::SpawnBorderWalls()
+	// tile layout of the topology, the rest of the map does not depend on it.
+	// Pooled chunk meshes were laid out for the previous topology, rebuild them on their next use.
+	if(MapTopology != GridTopology)
+	{
+		for(FIntPoint& Layout : ChunkMeshComponentLayouts)
+		{
+			Layout = FIntPoint::ZeroValue;
+		}
+	}
+	MapTopology = GridTopology;
+	DispatchGridTopology(MapTopology, [this](auto TopologyTraits)
+	{
+		RowSpacing = TileHalfExtents.Y * 2 * decltype(TopologyTraits)::RowSpacing;
+		OddRowShift = TileHalfExtents.X * 2 * decltype(TopologyTraits)::OddRowShift;
+	});
+
+	const SIZE_T EstimatedBytes = EstimateMapMemory(SquareMapSize, bUseSparseGrid);
+	if(EstimatedBytes > static_cast<SIZE_T>(FMath::Max(MapMemoryBudgetMB, 0.f) * 1024.0 * 1024.0))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBSquareMapGenerator::GenerateSquareMap -> %dx%d map is estimated at %.1f MB, over the budget of %.1f MB!"),
+			SquareMapSize, SquareMapSize, EstimatedBytes / (1024.0 * 1024.0), MapMemoryBudgetMB);
+	}
+
+	// invalidate tile handles of the previous map
+	TBLastMapGeneration = FTBTileHandle::GetNextGeneration(TBLastMapGeneration);
+	MapGeneration = TBLastMapGeneration;
+
+	NumChunksPerSide = FMath::DivideAndRoundUp(SquareMapSize, TileChunkSize);
+	bIsMortonTileLayout = bUseMortonTileLayout;
+
+	Chunks.Empty();
+	AllocatedChunkIndices.Empty();
+	Chunks.SetNum(NumChunksPerSide * NumChunksPerSide);
+
+	// every block starts empty, edge blocks can have less tiles
+	BlockSummaries.SetNum(NumChunksPerSide * NumChunksPerSide);
+	BlockRowEmptyTiles.SetNum(NumChunksPerSide);
+	for(int ChunkY = 0; ChunkY < NumChunksPerSide; ChunkY++)
+	{
+		const int BlockHeight = FMath::Min(TileChunkSize, SquareMapSize - ChunkY * TileChunkSize);
+		BlockRowEmptyTiles[ChunkY] = 0;
+		for(int ChunkX = 0; ChunkX < NumChunksPerSide; ChunkX++)
+		{
+			const int BlockWidth = FMath::Min(TileChunkSize, SquareMapSize - ChunkX * TileChunkSize);
+			FTBBlockSummary& Summary = BlockSummaries[ChunkY * NumChunksPerSide + ChunkX];
+			Summary = FTBBlockSummary();
+			Summary.NumEmptyTiles = BlockWidth * BlockHeight;
+			BlockRowEmptyTiles[ChunkY] += Summary.NumEmptyTiles;
+		}
+	}
+	TotalEmptyTiles = SquareMapSize * SquareMapSize;
+}
+
+bool ATBSquareMapGenerator::CanUseBakedMap() const
 {
-	const bool bIsEven = (SquareMapSize % 2) == 0;
-	const int middleIndex = SquareMapSize / 2;
-	const FVector totalHalfExtents = TileHalfExtents * SquareMapSize;
-	const float ScaleMultiplierY = totalHalfExtents.Y / TileHalfExtents.Y;
-	const float ScaleMultiplierX = totalHalfExtents.X / TileHalfExtents.X;
-	
-	if(middleIndex-1 < 0 || !WallClass)
+	if(!BakedMap) return false;
+
+	if(!BakedMap->HasValidBakedData())
 	{
-		return;
+		UE_LOG(LogTemp, Warning, TEXT("ATBSquareMapGenerator::CanUseBakedMap -> %s could not be read, generating the map at runtime. Please bake it again!"), *BakedMap->GetName());
+		return false;
 	}
-	
-	// middle position x
-	FVector middleX = bIsEven ? (Tiles[0][middleIndex-1]->WordLocation + Tiles[0][middleIndex]->WordLocation)/2 :
-										 Tiles[0][middleIndex]->WordLocation;
-	// middle position y
-	FVector middleY = bIsEven ? (Tiles[middleIndex-1][0]->WordLocation + Tiles[middleIndex][0]->WordLocation)/2 :
-	 								 Tiles[middleIndex][0]->WordLocation;
 
-	// combine and set middle position
-	FVector middlePos = middleX;
-	middlePos.Y = middleY.Y;
-	middlePos.Z += TileHalfExtents.Z * 2;
+	const bool bSameSettings = BakedMap->SquareMapSize == SquareMapSize
+		&& BakedMap->bUseSparseGrid == bUseSparseGrid
+		&& BakedMap->bUseMortonTileLayout == bUseMortonTileLayout
+		&& BakedMap->GridTopology == GridTopology
+		&& BakedMap->ObstacleDensity == FMath::Clamp(ObstacleDensity, 0.f, 1.f)
+		&& BakedMap->TerrainNoiseScale == TerrainNoiseScale
+		&& BakedMap->TerrainSeed == TerrainSeed
+		&& BakedMap->TileHalfExtents.Equals(TileHalfExtents, 0.01);
+	if(!bSameSettings)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBSquareMapGenerator::CanUseBakedMap -> %s was baked with other settings or another tile mesh, generating the map at runtime. Please bake it again!"),
+			*BakedMap->GetName());
+		return false;
+	}
 
-	// save middle pos, it can be useful later
-	SquareMapMiddle = middlePos;
+	// same settings but arrays of another size, the asset is broken
+	const int32 NumBlocks = NumChunksPerSide * NumChunksPerSide;
+	const int32 NumTileInstances = bUseSparseGrid ? 0 : SquareMapSize * SquareMapSize;
+	if(BakedMap->BlockNumObstacles.Num() != NumBlocks
+		|| (BakedMap->BlockWalkableMasks.Num() != 0 && BakedMap->BlockWalkableMasks.Num() != NumBlocks * TileChunkMaskWords)
+		|| BakedMap->TileInstanceLocations.Num() != NumTileInstances
+		|| BakedMap->ObstacleInstanceLocations.Num() != BakedMap->ObstacleTerrainValues.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("ATBSquareMapGenerator::CanUseBakedMap -> %s has data of the wrong size, generating the map at runtime!"), *BakedMap->GetName());
+		return false;
+	}
+	return true;
+}
 
-	// calculate move deltas from middle to borders
-	float MoveDeltaX = (TileHalfExtents.X * 2) * (SquareMapSize-middleIndex);
-	MoveDeltaX += bIsEven ? TileHalfExtents.X : 0;
+void ATBSquareMapGenerator::LoadBakedWalkableMasks()
+{
+	MapObstacleDensity = BakedMap->ObstacleDensity;
+	MapTerrainNoiseScale = BakedMap->TerrainNoiseScale;
+	TerrainNoiseOffset = BakedMap->TerrainNoiseOffset;
+	WaterThreshold = BakedMap->WaterThreshold;
+	RockThreshold = BakedMap->RockThreshold;
+	BlockWalkableMasks = BakedMap->BlockWalkableMasks;
 
-	float MoveDeltaY = (TileHalfExtents.Y * 2) * (SquareMapSize-middleIndex);
-	MoveDeltaY += bIsEven ? TileHalfExtents.Y : 0;
+	for(int32 ChunkIndex = 0; ChunkIndex < BlockSummaries.Num(); ChunkIndex++)
+	{
+		const int32 NumObstacles = BakedMap->BlockNumObstacles[ChunkIndex];
+		BlockSummaries[ChunkIndex].NumObstacles = NumObstacles;
+		BlockSummaries[ChunkIndex].NumEmptyTiles -= NumObstacles;
+		BlockRowEmptyTiles[ChunkIndex / NumChunksPerSide] -= NumObstacles;
+		TotalEmptyTiles -= NumObstacles;
+	}
+}
 
-	
-	//spawn left wall
-	FVector leftWallPos = middlePos;
-	leftWallPos.X -= MoveDeltaX;
-	AActor* leftWall = GetWorld()->SpawnActor<AActor>(WallClass, leftWallPos, FRotator::ZeroRotator, GetActorSpawnParameters());
-	FVector oldScaleL = leftWall->GetActorScale3D();
-	oldScaleL.Y *= ScaleMultiplierY;
-	leftWall->SetActorScale3D(oldScaleL);
+void ATBSquareMapGenerator::BuildTileInstanceLocations(TArray<FVector>& OutLocations) const
+{
+	OutLocations.Reset(SquareMapSize * SquareMapSize);
+	for (int y = 0; y < SquareMapSize; y++)
+	{
+		for(int x = 0; x < SquareMapSize; x++)
+		{
+			OutLocations.Add(GetTileWorldLocation(x, y) - MapStartLocation);
+		}
+	}
+}
 
-	//spawn right wall
-	FVector rightWallPos = middlePos;
-	rightWallPos.X += MoveDeltaX;
-	AActor* rightWall = GetWorld()->SpawnActor<AActor>(WallClass, rightWallPos, FRotator::ZeroRotator, GetActorSpawnParameters());
-	FVector oldScaleR = rightWall->GetActorScale3D();
-	oldScaleR.Y *= ScaleMultiplierY;
-	rightWall->SetActorScale3D(oldScaleR);
+void ATBSquareMapGenerator::UpdateDenseTileInstances(const TArray<FVector>& Locations)
+{
+	const int32 NumTiles = Locations.Num();
+	const int32 NumReused = FMath::Min(InstancedStaticMeshComponent->GetInstanceCount(), NumTiles);
 
-	//spawn up wall
-	FVector upWallPos = middlePos;
-	upWallPos.Y += MoveDeltaY;
-	AActor* upWall = GetWorld()->SpawnActor<AActor>(WallClass, upWallPos, FRotator::ZeroRotator, GetActorSpawnParameters());
-	FVector oldScaleU = upWall->GetActorScale3D();
-	oldScaleU.X *= ScaleMultiplierX;
-	upWall->SetActorScale3D(oldScaleU);
+	// instances are relative to the component
+	const FVector Offset = MapStartLocation - InstancedStaticMeshComponent->GetComponentLocation();
+	TArray<FTransform> Transforms;
+	Transforms.Reserve(NumTiles);
+	for(const FVector& Location : Locations)
+	{
+		Transforms.Add(FTransform(Location + Offset));
+	}
 
-	//spawn down wall
-	FVector downWallPos = middlePos;
-	downWallPos.Y -= MoveDeltaY;
-	AActor* downWall = GetWorld()->SpawnActor<AActor>(WallClass, downWallPos, FRotator::ZeroRotator, GetActorSpawnParameters());
-	FVector oldScaleD = downWall->GetActorScale3D();
-	oldScaleD.X *= ScaleMultiplierX;
-	downWall->SetActorScale3D(oldScaleD);
+	// remove the instances the smaller map doesn't need, from the back so the others keep their indices
+	if(InstancedStaticMeshComponent->GetInstanceCount() > NumTiles)
+	{
+		TArray<int32> RemovedInstances;
+		for(int32 i = InstancedStaticMeshComponent->GetInstanceCount() - 1; i >= NumTiles; i--)
+		{
+			RemovedInstances.Add(i);
+		}
+		InstancedStaticMeshComponent->RemoveInstances(RemovedInstances);
+	}
+
+	// move the existing instances in one batch, then add the missing ones in one batch
+	if(NumReused > 0)
+	{
+		InstancedStaticMeshComponent->BatchUpdateInstancesTransforms(0, TArray<FTransform>(Transforms.GetData(), NumReused), false, false, true);
+	}
+	if(NumReused < NumTiles)
+	{
+		InstancedStaticMeshComponent->AddInstances(TArray<FTransform>(Transforms.GetData() + NumReused, NumTiles - NumReused), false, false);
+	}
+
+	// reused instances keep the custom data of the previous map
+	FMemory::Memzero(InstancedStaticMeshComponent->PerInstanceSMCustomData.GetData(), InstancedStaticMeshComponent->PerInstanceSMCustomData.Num() * sizeof(float));
+	InstancedStaticMeshComponent->MarkRenderStateDirty();
 }
 
+bool ATBSquareMapGenerator::SetTileInstanceTransform(const FTBTileHandle Tile, const FTransform& Transform)
+{
+	if(!IsValidTile(Tile) || InstancedStaticMeshComponent->GetInstanceCount() != SquareMapSize * SquareMapSize) return false;
 
+	PendingTileTransforms.Add({ static_cast<int32>(Tile.GetIndex()), Transform });
+	ScheduleTileInstanceFlush();
+	return true;
+}
 
-FActorSpawnParameters ATBSquareMapGenerator::GetActorSpawnParameters()
+bool ATBSquareMapGenerator::SetTileInstanceCustomData(const FTBTileHandle Tile, const int32 DataIndex, const float Value)
 {
-	FActorSpawnParameters Parameters;
-	Parameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-	Parameters.Owner = this;
+	if(!IsValidTile(Tile) || InstancedStaticMeshComponent->GetInstanceCount() != SquareMapSize * SquareMapSize) return false;
+	if(DataIndex < 0 || DataIndex >= InstancedStaticMeshComponent->NumCustomDataFloats) return false;
 
-	return Parameters;
+	PendingTileCustomData.Add({ static_cast<int32>(Tile.GetIndex()), DataIndex, Value });
+	ScheduleTileInstanceFlush();
+	return true;
 }
 
-FVector ATBSquareMapGenerator::GetTileHalfExtents() const
+void ATBSquareMapGenerator::ScheduleTileInstanceFlush()
 {
-	return TileHalfExtents;
+	if(bIsTileInstanceFlushScheduled) return;
+
+	bIsTileInstanceFlushScheduled = true;
+	GetWorldTimerManager().SetTimerForNextTick(this, &ATBSquareMapGenerator::FlushTileInstanceUpdates);
 }
 
+void ATBSquareMapGenerator::FlushTileInstanceUpdates()
+{
+	bIsTileInstanceFlushScheduled = false;
+	if(PendingTileTransforms.Num() <= 0 && PendingTileCustomData.Num() <= 0) return;
 
-// Called every frame
-void ATBSquareMapGenerator::Tick(float DeltaTime)
+	// sorted by instance, the stable sort keeps the last change of a tile last
+	Algo::StableSortBy(PendingTileTransforms, &FTBPendingTileTransform::InstanceIndex);
+
+	// contiguous instances are updated with one batch call per range
+	TArray<FTransform> RangeTransforms;
+	int32 RangeStart = 0;
+	for(const FTBPendingTileTransform& Pending : PendingTileTransforms)
+	{
+		const int32 RangeEnd = RangeStart + RangeTransforms.Num();
+		if(RangeTransforms.Num() > 0 && Pending.InstanceIndex == RangeEnd - 1)
+		{
+			RangeTransforms.Last() = Pending.Transform;
+			continue;
+		}
+		if(RangeTransforms.Num() > 0 && Pending.InstanceIndex != RangeEnd)
+		{
+			InstancedStaticMeshComponent->BatchUpdateInstancesTransforms(RangeStart, RangeTransforms, true, false, true);
+			RangeTransforms.Reset();
+		}
+		if(RangeTransforms.Num() <= 0)
+		{
+			RangeStart = Pending.InstanceIndex;
+		}
+		RangeTransforms.Add(Pending.Transform);
+	}
+	if(RangeTransforms.Num() > 0)
+	{
+		InstancedStaticMeshComponent->BatchUpdateInstancesTransforms(RangeStart, RangeTransforms, true, false, true);
+	}
+
+	// custom data is only copied to the instance data, the render state is rebuilt once below
+	for(const FTBPendingTileCustomData& Pending : PendingTileCustomData)
+	{
+		InstancedStaticMeshComponent->SetCustomDataValue(Pending.InstanceIndex, Pending.DataIndex, Pending.Value, false);
+	}
+
+	UE_LOG(LogTemp, Verbose, TEXT("ATBSquareMapGenerator::FlushTileInstanceUpdates -> %d transforms, %d custom data values"),
+		PendingTileTransforms.Num(), PendingTileCustomData.Num());
+
+	PendingTileTransforms.Reset();
+	PendingTileCustomData.Reset();
+	InstancedStaticMeshComponent->MarkRenderStateDirty();
+}
+
+FTBTileChunk* ATBSquareMapGenerator::GetOrAllocateChunk(const int32 ChunkX, const int32 ChunkY)
 {
-	Super::Tick(DeltaTime);
+	const int32 ChunkIndex = ChunkY * NumChunksPerSide + ChunkX;
+	if(FTBTileChunk* Chunk = Chunks[ChunkIndex].Get())
+	{
+		return Chunk;
+	}
+
+	// default tiles are empty
+	FTBTileChunk* Chunk = new FTBTileChunk();
+	Chunk->Tiles.SetNum(TileChunkSize * TileChunkSize);
 
+	Chunks[ChunkIndex].Reset(Chunk);
+	AllocatedChunkIndices.Add(ChunkIndex);
+	return Chunk;
 }
 
-FVector ATBSquareMapGenerator::GetSquareMapMiddle()
+FTBMapMemoryStats ATBSquareMapGenerator::GetMemoryStats() const
 {
-	return SquareMapMiddle;
+	FTBMapMemoryStats Stats;
+	Stats.NumTiles = static_cast<int64>(SquareMapSize) * SquareMapSize;
+	Stats.NumAllocatedChunks = AllocatedChunkIndices.Num();
+
+	Stats.TileChunkBytes = Chunks.GetAllocatedSize() + AllocatedChunkIndices.GetAllocatedSize();
+	for(const int32 ChunkIndex : AllocatedChunkIndices)
+	{
+		Stats.TileChunkBytes += sizeof(FTBTileChunk) + Chunks[ChunkIndex]->Tiles.GetAllocatedSize();
+	}
+
+	Stats.BlockSummaryBytes = BlockSummaries.GetAllocatedSize() + BlockRowEmptyTiles.GetAllocatedSize() + BlockWalkableMasks.GetAllocatedSize();
+
+	Stats.TileMeshBytes = InstancedStaticMeshComponent->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	for(UHierarchicalInstancedStaticMeshComponent* MeshComponent : ChunkMeshComponentPool)
+	{
+		Stats.TileMeshBytes += MeshComponent->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	}
+	Stats.TileMeshBytes += ObstacleMeshComponent->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	for(UHierarchicalInstancedStaticMeshComponent* MeshComponent : ChunkObstacleComponentPool)
+	{
+		Stats.TileMeshBytes += MeshComponent->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	}
+
+	Stats.HeatmapBytes = TileHeatmapComponent->GetAllocatedSize();
+	return Stats;
+}
+
+SIZE_T ATBSquareMapGenerator::EstimateMapMemory(const int32 MapSize, const bool bSparse) const
+{
+	const int64 NumTiles = static_cast<int64>(MapSize) * MapSize;
+	const int64 ChunksPerSide = FMath::DivideAndRoundUp(MapSize, TileChunkSize);
+	const int64 NumChunks = ChunksPerSide * ChunksPerSide;
+	const int64 ChunkBytes = sizeof(FTBTileChunk) + TileChunkSize * TileChunkSize * sizeof(FTileInfo);
+
+	int64 Bytes = NumChunks * (sizeof(TUniquePtr<FTBTileChunk>) + sizeof(FTBBlockSummary)) + ChunksPerSide * sizeof(int32);
+	if(ObstacleDensity > 0)
+	{
+		Bytes += NumChunks * TileChunkMaskWords * sizeof(uint64);
+	}
+	if(bSparse)
+	{
+		const int64 StreamedChunks = FMath::Min<int64>(FMath::Square(RenderChunkRadius * 2 + 1), NumChunks);
+		Bytes += StreamedChunks * TileChunkSize * TileChunkSize * EstimatedBytesPerTileInstance;
+	}
+	else
+	{
+		Bytes += NumChunks * ChunkBytes + NumTiles * EstimatedBytesPerTileInstance;
+	}
+
+	if(MapSize <= TileHeatmapComponent->MaxHeatmapSize && TileHeatmapComponent->HeatmapMode != ETBTileHeatmapMode::Disabled)
+	{
+		// CPU buffer plus the texture
+		Bytes += NumTiles * sizeof(FColor) * 2;
+	}
+	return Bytes;
 }
 
+FVector ATBSquareMapGenerator::GetTileWorldLocation(const int32 X, const int32 Y) const
+{
+	// move right by tile extents for X, move down by the row spacing for Y. Odd rows are shifted on hex maps.
+	return MapStartLocation + FVector(X * TileHalfExtents.X * 2 + (Y & 1) * OddRowShift, -Y * RowSpacing, 0);
+}
 
-FTileInfo* ATBSquareMapGenerator::GetTileAtDirection(const FTileInfo* SourceTile, const EDirectionType Direction) const
+FVector ATBSquareMapGenerator::GetTileWorldLocation(const FTBTileHandle Tile) const
 {
-	FTileInfo* TileResult = nullptr;
-	
-	if(Tiles.Num() <= 0) return TileResult;
-	
-	const FVector2D Position2D = SourceTile->Pos2D;
-	
-	
-	if(Direction == EDirectionType::South)
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	return GetTileWorldLocation(Coordinates.X, Coordinates.Y);
+}
+
+FIntPoint ATBSquareMapGenerator::GetTileCoordinatesAtWorldLocation(const FVector& WorldLocation) const
+{
+	// tile locations are tile centers, round to the nearest row and then to the nearest tile of the row
+	const int32 Y = FMath::FloorToInt32((MapStartLocation.Y - WorldLocation.Y) / RowSpacing + 0.5);
+	const int32 X = FMath::FloorToInt32((WorldLocation.X - MapStartLocation.X - (Y & 1) * OddRowShift) / (TileHalfExtents.X * 2) + 0.5);
+	return FIntPoint(X, Y);
+}
+
+FTBTileHandle ATBSquareMapGenerator::GetTileAt(const int32 X, const int32 Y) const
+{
+	if(X < 0 || Y < 0 || X >= SquareMapSize || Y >= SquareMapSize || Chunks.Num() <= 0) return FTBTileHandle();
+
+	return FTBTileHandle::Make(Y * SquareMapSize + X, MapGeneration);
+}
+
+const FTileInfo* ATBSquareMapGenerator::FindTile(const FTBTileHandle Tile) const
+{
+	if(!IsValidTile(Tile)) return nullptr;
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	const FTBTileChunk* Chunk = Chunks[GetChunkIndexOfTile(Coordinates.X, Coordinates.Y)].Get();
+	return Chunk ? &Chunk->Tiles[GetLocalIndexOfTile(Coordinates.X, Coordinates.Y)] : nullptr;
+}
+
+FTileInfo* ATBSquareMapGenerator::FindTile(const FTBTileHandle Tile)
+{
+	if(!IsValidTile(Tile)) return nullptr;
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	FTBTileChunk* Chunk = Chunks[GetChunkIndexOfTile(Coordinates.X, Coordinates.Y)].Get();
+	return Chunk ? &Chunk->Tiles[GetLocalIndexOfTile(Coordinates.X, Coordinates.Y)] : nullptr;
+}
+
+FTileInfo* ATBSquareMapGenerator::GetOrAllocateTile(const FTBTileHandle Tile)
+{
+	if(!ensureMsgf(IsValidTile(Tile), TEXT("ATBSquareMapGenerator::GetOrAllocateTile -> tile handle is stale or invalid!"))) return nullptr;
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	FTBTileChunk* Chunk = GetOrAllocateChunk(Coordinates.X / TileChunkSize, Coordinates.Y / TileChunkSize);
+	return &Chunk->Tiles[GetLocalIndexOfTile(Coordinates.X, Coordinates.Y)];
+}
+
+bool ATBSquareMapGenerator::IsTileEmpty(const FTBTileHandle Tile) const
+{
+	if(!IsValidTile(Tile)) return false;
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	return IsTileEmptyAt(Coordinates.X, Coordinates.Y);
+}
+
+bool ATBSquareMapGenerator::IsTileWalkable(const FTBTileHandle Tile) const
+{
+	if(!IsValidTile(Tile)) return false;
+	if(BlockWalkableMasks.Num() <= 0) return true;
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	const int32 LocalIndex = GetLocalIndexOfTile(Coordinates.X, Coordinates.Y);
+	return (BlockWalkableMasks[GetChunkIndexOfTile(Coordinates.X, Coordinates.Y) * TileChunkMaskWords + LocalIndex / 64] >> (LocalIndex % 64)) & 1;
+}
+
+ETBTerrainType ATBSquareMapGenerator::GetTileTerrain(const int32 X, const int32 Y) const
+{
+	if(MapObstacleDensity <= 0) return ETBTerrainType::Ground;
+
+	const float Noise = FMath::PerlinNoise2D(FVector2D(X, Y) * MapTerrainNoiseScale + TerrainNoiseOffset);
+	if(Noise < WaterThreshold) return ETBTerrainType::Water;
+	if(Noise > RockThreshold) return ETBTerrainType::Rock;
+	return ETBTerrainType::Ground;
+}
+
+void ATBSquareMapGenerator::GenerateWalkableMasks()
+{
+	MapObstacleDensity = FMath::Clamp(ObstacleDensity, 0.f, 1.f);
+	MapTerrainNoiseScale = TerrainNoiseScale;
+	BlockWalkableMasks.Empty();
+	if(MapObstacleDensity <= 0) return;
+
+	// perlin noise is not uniform, so the thresholds are taken from the distribution of a sample of the map
+	FRandomStream TerrainStream(TerrainSeed);
+	TerrainNoiseOffset = FVector2D(TerrainStream.FRandRange(0, 10000), TerrainStream.FRandRange(0, 10000));
+
+	TArray<float> NoiseSamples;
+	NoiseSamples.SetNumUninitialized(4096);
+	for(float& Sample : NoiseSamples)
+	{
+		const FVector2D SamplePoint(TerrainStream.FRandRange(0, SquareMapSize), TerrainStream.FRandRange(0, SquareMapSize));
+		Sample = FMath::PerlinNoise2D(SamplePoint * MapTerrainNoiseScale + TerrainNoiseOffset);
+	}
+	NoiseSamples.Sort();
+	WaterThreshold = NoiseSamples[FMath::Clamp(FMath::FloorToInt32(NoiseSamples.Num() * MapObstacleDensity * 0.5f), 0, NoiseSamples.Num() - 1)];
+	RockThreshold = NoiseSamples[FMath::Clamp(FMath::FloorToInt32(NoiseSamples.Num() * (1 - MapObstacleDensity * 0.5f)), 0, NoiseSamples.Num() - 1)];
+
+	// blocks are independent, each one writes only its own mask words and summary
+	BlockWalkableMasks.SetNumZeroed(NumChunksPerSide * NumChunksPerSide * TileChunkMaskWords);
+	ParallelFor(NumChunksPerSide * NumChunksPerSide, [this](const int32 ChunkIndex)
 	{
-		// if south tile is valid
-		if(Position2D.Y - 1 >= 0)
+		const int32 ChunkX = ChunkIndex % NumChunksPerSide;
+		const int32 ChunkY = ChunkIndex / NumChunksPerSide;
+		const int32 BlockWidth = FMath::Min(TileChunkSize, SquareMapSize - ChunkX * TileChunkSize);
+		const int32 BlockHeight = FMath::Min(TileChunkSize, SquareMapSize - ChunkY * TileChunkSize);
+		uint64* Mask = &BlockWalkableMasks[ChunkIndex * TileChunkMaskWords];
+
+		int32 NumObstacles = 0;
+		for(int32 LocalY = 0; LocalY < BlockHeight; LocalY++)
 		{
-			TileResult = Tiles[Position2D.Y-1][Position2D.X];
-			return TileResult;
+			for(int32 LocalX = 0; LocalX < BlockWidth; LocalX++)
+			{
+				const int32 X = ChunkX * TileChunkSize + LocalX;
+				const int32 Y = ChunkY * TileChunkSize + LocalY;
+				if(GetTileTerrain(X, Y) == ETBTerrainType::Ground)
+				{
+					const int32 LocalIndex = GetLocalIndexOfTile(X, Y);
+					Mask[LocalIndex / 64] |= 1ull << (LocalIndex % 64);
+				}
+				else
+				{
+					NumObstacles++;
+				}
+			}
 		}
+		BlockSummaries[ChunkIndex].NumObstacles = NumObstacles;
+	});
+
+	for(int32 ChunkIndex = 0; ChunkIndex < BlockSummaries.Num(); ChunkIndex++)
+	{
+		const int32 NumObstacles = BlockSummaries[ChunkIndex].NumObstacles;
+		BlockSummaries[ChunkIndex].NumEmptyTiles -= NumObstacles;
+		BlockRowEmptyTiles[ChunkIndex / NumChunksPerSide] -= NumObstacles;
+		TotalEmptyTiles -= NumObstacles;
 	}
-	else if(Direction == EDirectionType::North)
+}
+
+void ATBSquareMapGenerator::GetObstacleInstances(const FIntPoint& MinTile, const FIntPoint& MaxTile, TArray<FVector>& OutLocations, TArray<float>& OutTerrainValues) const
+{
+	if(BlockWalkableMasks.Num() <= 0) return;
+
+	for(int32 Y = MinTile.Y; Y <= MaxTile.Y; Y++)
 	{
-		// if north tile is valid
-		if(Position2D.Y + 1 < Tiles.Num())
+		for(int32 X = MinTile.X; X <= MaxTile.X; X++)
 		{
-			TileResult = Tiles[Position2D.Y+1][Position2D.X];
-			return TileResult;
+			const ETBTerrainType Terrain = GetTileTerrain(X, Y);
+			if(Terrain == ETBTerrainType::Ground) continue;
+
+			// obstacles stand on top of the tile
+			OutLocations.Add(GetTileWorldLocation(X, Y) - MapStartLocation + FVector(0, 0, TileHalfExtents.Z * 2));
+			OutTerrainValues.Add(static_cast<float>(Terrain));
 		}
 	}
-	else if(Direction == EDirectionType::West)
+}
+
+void ATBSquareMapGenerator::AddObstacleInstances(UHierarchicalInstancedStaticMeshComponent* MeshComponent, const FIntPoint& MinTile, const FIntPoint& MaxTile) const
+{
+	TArray<FVector> Locations;
+	TArray<float> TerrainValues;
+	GetObstacleInstances(MinTile, MaxTile, Locations, TerrainValues);
+	AddObstacleInstances(MeshComponent, Locations, TerrainValues);
+}
+
+void ATBSquareMapGenerator::AddObstacleInstances(UHierarchicalInstancedStaticMeshComponent* MeshComponent, const TArray<FVector>& Locations, const TArray<float>& TerrainValues) const
+{
+	if(Locations.Num() <= 0) return;
+
+	// instances are relative to the component
+	const FVector Offset = MapStartLocation - MeshComponent->GetComponentLocation();
+	TArray<FTransform> Transforms;
+	Transforms.Reserve(Locations.Num());
+	for(const FVector& Location : Locations)
+	{
+		Transforms.Add(FTransform(Location + Offset));
+	}
+
+	const int32 FirstInstance = MeshComponent->GetInstanceCount();
+	MeshComponent->AddInstances(Transforms, false);
+
+	// the terrain is the only custom data float, copy it in one go instead of per instance
+	check(MeshComponent->NumCustomDataFloats == 1);
+	FMemory::Memcpy(&MeshComponent->PerInstanceSMCustomData[FirstInstance], TerrainValues.GetData(), TerrainValues.Num() * sizeof(float));
+	MeshComponent->MarkRenderStateDirty();
+}
+
+FTBMammalHandle ATBSquareMapGenerator::GetTileOccupant(const FTBTileHandle Tile) const
+{
+	const FTileInfo* TileInfo = FindTile(Tile);
+	return TileInfo ? TileInfo->Mammal : FTBMammalHandle();
+}
+
+bool ATBSquareMapGenerator::IsTileOccupiedBySpecies(const FTBTileHandle Tile, const uint8 SpeciesMask) const
+{
+	if(!IsValidTile(Tile)) return false;
+
+	// one mask test per species in the mask, the tile itself is never read
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	const int32 LocalIndex = GetLocalIndexOfTile(Coordinates.X, Coordinates.Y);
+	return (GetSpeciesTileBits(GetChunkIndexOfTile(Coordinates.X, Coordinates.Y), LocalIndex / 64, SpeciesMask) >> (LocalIndex % 64)) & 1;
+}
+
+ETBMammalSpecies ATBSquareMapGenerator::GetTileOccupantSpecies(const FTBTileHandle Tile) const
+{
+	const FTileInfo* TileInfo = FindTile(Tile);
+	check(TileInfo && !TileInfo->IsEmpty());
+	return TileInfo->Species;
+}
+
+void ATBSquareMapGenerator::SetTileOccupant(const FTBTileHandle Tile, const FTBMammalHandle Mammal, const ETBMammalSpecies Species)
+{
+	FTileInfo* TileInfoPtr = GetOrAllocateTile(Tile);
+	if(!TileInfoPtr) return;
+
+	FTileInfo& TileInfo = *TileInfoPtr;
+	if(TileJournal)
+	{
+		TileJournal->Add(FTBTileDelta{Tile, TileInfo.Mammal, TileInfo.Species});
+	}
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	const int32 LocalIndex = GetLocalIndexOfTile(Coordinates.X, Coordinates.Y);
+	FTBTileChunk& Chunk = *Chunks[GetChunkIndexOfTile(Coordinates.X, Coordinates.Y)];
+	if(!TileInfo.IsEmpty())
+	{
+		UpdateBlockSummary(Coordinates.X, Coordinates.Y, TileInfo.Species, -1);
+		Chunk.SpeciesMasks[static_cast<uint8>(TileInfo.Species)][LocalIndex / 64] &= ~(1ull << (LocalIndex % 64));
+	}
+
+	TileInfo.Mammal = Mammal;
+	TileInfo.Species = Species;
+	UpdateBlockSummary(Coordinates.X, Coordinates.Y, Species, 1);
+
+	Chunk.OccupiedMask[LocalIndex / 64] |= 1ull << (LocalIndex % 64);
+	Chunk.SpeciesMasks[static_cast<uint8>(Species)][LocalIndex / 64] |= 1ull << (LocalIndex % 64);
+}
+
+void ATBSquareMapGenerator::ClearTile(const FTBTileHandle Tile)
+{
+	// unallocated tiles are already empty
+	FTileInfo* TileInfo = FindTile(Tile);
+	if(!TileInfo || TileInfo->IsEmpty()) return;
+
+	if(TileJournal)
+	{
+		TileJournal->Add(FTBTileDelta{Tile, TileInfo->Mammal, TileInfo->Species});
+	}
+
+	const FIntPoint Coordinates = GetTileCoordinates(Tile);
+	UpdateBlockSummary(Coordinates.X, Coordinates.Y, TileInfo->Species, -1);
+	TileInfo->Mammal.Reset();
+
+	const int32 LocalIndex = GetLocalIndexOfTile(Coordinates.X, Coordinates.Y);
+	FTBTileChunk& Chunk = *Chunks[GetChunkIndexOfTile(Coordinates.X, Coordinates.Y)];
+	Chunk.OccupiedMask[LocalIndex / 64] &= ~(1ull << (LocalIndex % 64));
+	Chunk.SpeciesMasks[static_cast<uint8>(TileInfo->Species)][LocalIndex / 64] &= ~(1ull << (LocalIndex % 64));
+}
+
+void ATBSquareMapGenerator::RestoreTile(const FTBTileDelta& Delta)
+{
+	if(Delta.OldMammal.IsValid())
+	{
+		SetTileOccupant(Delta.Tile, Delta.OldMammal, Delta.OldSpecies);
+	}
+	else
+	{
+		ClearTile(Delta.Tile);
+	}
+}
+
+void ATBSquareMapGenerator::UpdateBlockSummary(const int32 X, const int32 Y, const ETBMammalSpecies Species, const int32 Delta)
+{
+	const int32 ChunkIndex = GetChunkIndexOfTile(X, Y);
+	FTBBlockSummary& Summary = BlockSummaries[ChunkIndex];
+
+	// a mammal entering the block takes an empty tile
+	Summary.NumEmptyTiles -= Delta;
+	BlockRowEmptyTiles[ChunkIndex / NumChunksPerSide] -= Delta;
+	TotalEmptyTiles -= Delta;
+
+	Summary.NumMammals += Delta;
+	Summary.NumMammalsOfSpecies[static_cast<uint8>(Species)] += Delta;
+}
+
+void ATBSquareMapGenerator::GetActiveChunkIndices(TArray<int32>& OutChunkIndices) const
+{
+	ForEachActiveChunk([&OutChunkIndices](const int32 ChunkIndex, const FTBTileChunk&)
 	{
-		// if west tile is valid
-		if(Position2D.X - 1 >= 0)
+		OutChunkIndices.Add(ChunkIndex);
+	});
+}
+
+void ATBSquareMapGenerator::GetSpeciesTiles(const uint8 SpeciesMask, TArray<FTBTileHandle>& OutTiles) const
+{
+	ForEachActiveChunk([this, SpeciesMask, &OutTiles](const int32 ChunkIndex, const FTBTileChunk&)
+	{
+		const FTBBlockSummary& Summary = BlockSummaries[ChunkIndex];
+		int32 NumOfSpecies = 0;
+		for(uint8 Mask = SpeciesMask; Mask != 0; Mask &= Mask - 1)
 		{
-			TileResult = Tiles[Position2D.Y][Position2D.X - 1];
-			return TileResult;
+			NumOfSpecies += Summary.NumMammalsOfSpecies[FMath::CountTrailingZeros(Mask)];
 		}
-			
-	}
-	else if(Direction == EDirectionType::East)
+		if(NumOfSpecies <= 0) return;
+
+		const int32 ChunkStartX = (ChunkIndex % NumChunksPerSide) * TileChunkSize;
+		const int32 ChunkStartY = (ChunkIndex / NumChunksPerSide) * TileChunkSize;
+		for(int32 Word = 0; Word < TileChunkMaskWords; Word++)
+		{
+			for(uint64 Bits = GetSpeciesTileBits(ChunkIndex, Word, SpeciesMask); Bits != 0; Bits &= Bits - 1)
+			{
+				const FIntPoint LocalCoordinates = GetLocalTileCoordinates(Word * 64 + FMath::CountTrailingZeros64(Bits));
+				OutTiles.Add(GetTileAt(ChunkStartX + LocalCoordinates.X, ChunkStartY + LocalCoordinates.Y));
+			}
+		}
+	});
+}
+
+void ATBSquareMapGenerator::GetBlockDensityHistogram(const ETBMammalSpecies Species, TArrayView<uint32> OutBins) const
+{
+	if(OutBins.Num() <= 0) return;
+
+	FMemory::Memzero(OutBins.GetData(), OutBins.Num() * sizeof(uint32));
+
+	// mammals only stand on allocated chunks, every other block is empty
+	int32 NumCountedBlocks = 0;
+	ForEachActiveChunk([this, Species, OutBins, &NumCountedBlocks](const int32 ChunkIndex, const FTBTileChunk&)
 	{
-		// if east tile is valid
-		if(Position2D.X + 1 < Tiles.Num())
+		const int32 NumOfSpecies = BlockSummaries[ChunkIndex].NumMammalsOfSpecies[static_cast<uint8>(Species)];
+		if(NumOfSpecies <= 0) return;
+
+		const int32 BlockWidth = FMath::Min(TileChunkSize, SquareMapSize - (ChunkIndex % NumChunksPerSide) * TileChunkSize);
+		const int32 BlockHeight = FMath::Min(TileChunkSize, SquareMapSize - (ChunkIndex / NumChunksPerSide) * TileChunkSize);
+		OutBins[FMath::Min(NumOfSpecies * OutBins.Num() / (BlockWidth * BlockHeight), OutBins.Num() - 1)]++;
+		NumCountedBlocks++;
+	});
+	OutBins[0] += BlockSummaries.Num() - NumCountedBlocks;
+}
+
+void ATBSquareMapGenerator::ReleaseEmptyChunks()
+{
+	if(!bUseSparseGrid) return;
+
+	for(int i = AllocatedChunkIndices.Num() - 1; i >= 0; i--)
+	{
+		const int32 ChunkIndex = AllocatedChunkIndices[i];
+		if(BlockSummaries[ChunkIndex].GetNumMammals() <= 0)
 		{
-			TileResult = Tiles[Position2D.Y][Position2D.X + 1];
-			return TileResult;
+			Chunks[ChunkIndex].Reset();
+			AllocatedChunkIndices.RemoveAtSwap(i);
 		}
 	}
-
-	return TileResult;
 }
 
-TArray<FTileInfo*> ATBSquareMapGenerator::GetAllAdjacentEmptyTiles(const FTileInfo* SourceTile) const
+void ATBSquareMapGenerator::UpdateStreamedChunks()
 {
-	TArray<FTileInfo*> AdjacentEmptyTiles;
-	
-	if(Tiles.Num() <= 0) return AdjacentEmptyTiles;
-	
-	
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::North))
+	if(NumChunksPerSide <= 0) return;
+
+	FVector CameraLocation = SquareMapMiddle;
+	if(const APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0))
+	{
+		CameraLocation = CameraManager->GetCameraLocation();
+	}
+
+	// find the chunk under the camera
+	const FIntPoint CameraTile = GetTileCoordinatesAtWorldLocation(CameraLocation);
+	const FIntPoint CameraChunk(
+		FMath::Clamp(FMath::FloorToInt32(static_cast<float>(CameraTile.X) / TileChunkSize), 0, NumChunksPerSide - 1),
+		FMath::Clamp(FMath::FloorToInt32(static_cast<float>(CameraTile.Y) / TileChunkSize), 0, NumChunksPerSide - 1));
+
+	// nothing to do until the camera moves to another chunk
+	if(CameraChunk == LastCameraChunk) return;
+	LastCameraChunk = CameraChunk;
+
+	const int32 MinChunkX = FMath::Max(CameraChunk.X - RenderChunkRadius, 0);
+	const int32 MaxChunkX = FMath::Min(CameraChunk.X + RenderChunkRadius, NumChunksPerSide - 1);
+	const int32 MinChunkY = FMath::Max(CameraChunk.Y - RenderChunkRadius, 0);
+	const int32 MaxChunkY = FMath::Min(CameraChunk.Y + RenderChunkRadius, NumChunksPerSide - 1);
+
+	// stream out chunks that are out of range
+	for(auto It = StreamedChunkMeshComponents.CreateIterator(); It; ++It)
 	{
-		if(TileResult->bIsEmptyTile)
+		const int32 ChunkX = It.Key() % NumChunksPerSide;
+		const int32 ChunkY = It.Key() / NumChunksPerSide;
+		if(ChunkX < MinChunkX || ChunkX > MaxChunkX || ChunkY < MinChunkY || ChunkY > MaxChunkY)
 		{
-			AdjacentEmptyTiles.Add(TileResult);
+			ChunkMeshComponentPool[It.Value()]->SetVisibility(false);
+			ChunkObstacleComponentPool[It.Value()]->SetVisibility(false);
+			FreeChunkMeshComponents.Add(It.Value());
+			It.RemoveCurrent();
 		}
 	}
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::South))
+
+	// stream in chunks that are in range
+	for(int32 ChunkY = MinChunkY; ChunkY <= MaxChunkY; ChunkY++)
 	{
-		if(TileResult->bIsEmptyTile)
+		for(int32 ChunkX = MinChunkX; ChunkX <= MaxChunkX; ChunkX++)
 		{
-			AdjacentEmptyTiles.Add(TileResult);
+			if(!StreamedChunkMeshComponents.Contains(ChunkY * NumChunksPerSide + ChunkX))
+			{
+				StreamInChunk(ChunkX, ChunkY);
+			}
 		}
 	}
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::West))
+}
+
+void ATBSquareMapGenerator::StreamInChunk(const int32 ChunkX, const int32 ChunkY)
+{
+	int32 PoolIndex;
+	if(FreeChunkMeshComponents.Num() > 0)
+	{
+		PoolIndex = FreeChunkMeshComponents.Pop(false);
+	}
+	else
 	{
-		if(TileResult->bIsEmptyTile)
+		UHierarchicalInstancedStaticMeshComponent* MeshComponent = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+		MeshComponent->SetStaticMesh(InstancedStaticMeshComponent->GetStaticMesh());
+		for(int i = 0; i < InstancedStaticMeshComponent->GetNumMaterials(); i++)
+		{
+			MeshComponent->SetMaterial(i, InstancedStaticMeshComponent->GetMaterial(i));
+		}
+		MeshComponent->SetMobility(EComponentMobility::Movable);
+		MeshComponent->RegisterComponent();
+
+		PoolIndex = ChunkMeshComponentPool.Add(MeshComponent);
+		ChunkMeshComponentLayouts.Add(FIntPoint::ZeroValue);
+
+		UHierarchicalInstancedStaticMeshComponent* ObstacleComponent = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+		ObstacleComponent->SetStaticMesh(ObstacleMeshComponent->GetStaticMesh());
+		for(int i = 0; i < ObstacleMeshComponent->GetNumMaterials(); i++)
 		{
-			AdjacentEmptyTiles.Add(TileResult);
+			ObstacleComponent->SetMaterial(i, ObstacleMeshComponent->GetMaterial(i));
 		}
+		ObstacleComponent->NumCustomDataFloats = 1;
+		ObstacleComponent->SetMobility(EComponentMobility::Movable);
+		ObstacleComponent->RegisterComponent();
+		ChunkObstacleComponentPool.Add(ObstacleComponent);
 	}
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::East))
+
+	UHierarchicalInstancedStaticMeshComponent* MeshComponent = ChunkMeshComponentPool[PoolIndex];
+
+	// edge chunks can be smaller than TileChunkSize, rebuild the instances only when the layout changes
+	const FIntPoint Layout(
+		FMath::Min(TileChunkSize, SquareMapSize - ChunkX * TileChunkSize),
+		FMath::Min(TileChunkSize, SquareMapSize - ChunkY * TileChunkSize));
+
+	if(ChunkMeshComponentLayouts[PoolIndex] != Layout)
 	{
-		if(TileResult->bIsEmptyTile)
+		// chunks start on even rows, so the relative layout is the same for every chunk of the map
+		TArray<FTransform> Transforms;
+		Transforms.Reserve(Layout.X * Layout.Y);
+		for(int LocalY = 0; LocalY < Layout.Y; LocalY++)
 		{
-			AdjacentEmptyTiles.Add(TileResult);
+			for(int LocalX = 0; LocalX < Layout.X; LocalX++)
+			{
+				Transforms.Add(FTransform(GetTileWorldLocation(LocalX, LocalY) - MapStartLocation));
+			}
 		}
+
+		MeshComponent->ClearInstances();
+		MeshComponent->AddInstances(Transforms, false);
+		ChunkMeshComponentLayouts[PoolIndex] = Layout;
 	}
 
-	return AdjacentEmptyTiles;
+	// instances are relative to the component, moving the component moves the whole chunk
+	MeshComponent->SetWorldLocation(GetTileWorldLocation(ChunkX * TileChunkSize, ChunkY * TileChunkSize));
+	MeshComponent->SetVisibility(true);
+
+	// obstacles differ for every chunk, so their instances are always rebuilt
+	UHierarchicalInstancedStaticMeshComponent* ObstacleComponent = ChunkObstacleComponentPool[PoolIndex];
+	ObstacleComponent->ClearInstances();
+	if(BlockSummaries[ChunkY * NumChunksPerSide + ChunkX].NumObstacles > 0)
+	{
+		ObstacleComponent->SetWorldLocation(MeshComponent->GetComponentLocation());
+		AddObstacleInstances(ObstacleComponent, FIntPoint(ChunkX * TileChunkSize, ChunkY * TileChunkSize),
+			FIntPoint(ChunkX * TileChunkSize + Layout.X - 1, ChunkY * TileChunkSize + Layout.Y - 1));
+		ObstacleComponent->SetVisibility(true);
+	}
+
+	StreamedChunkMeshComponents.Add(ChunkY * NumChunksPerSide + ChunkX, PoolIndex);
 }
 
-TArray<FTileInfo*> ATBSquareMapGenerator::GetAllAdjacentTiles(const FTileInfo* SourceTile) const
+
+void ATBSquareMapGenerator::GetBorderWallPlacements(FVector& OutMapMiddle, TArray<FTransform>& OutPlacements) const
 {
-	TArray<FTileInfo*> AdjacentEmptyTiles;
-	
-	if(Tiles.Num() <= 0) return AdjacentEmptyTiles;
+	const bool bIsEven = (SquareMapSize % 2) == 0;
+	const int middleIndex = SquareMapSize / 2;
+	// rows can be closer than a tile and odd rows can be shifted (hex), walls are scaled to the real extents
+	const float ScaleMultiplierY = SquareMapSize * RowSpacing / (TileHalfExtents.Y * 2);
+	const float ScaleMultiplierX = SquareMapSize + OddRowShift / (TileHalfExtents.X * 2);
+
+	OutMapMiddle = FVector::ZeroVector;
+	OutPlacements.Reset();
+	if(middleIndex-1 < 0)
+	{
+		return;
+	}
 	
+	// middle position x
+	FVector middleX = bIsEven ? (GetTileWorldLocation(middleIndex-1, 0) + GetTileWorldLocation(middleIndex, 0))/2 :
+										 GetTileWorldLocation(middleIndex, 0);
+	// middle position y
+	FVector middleY = bIsEven ? (GetTileWorldLocation(0, middleIndex-1) + GetTileWorldLocation(0, middleIndex))/2 :
+	 								 GetTileWorldLocation(0, middleIndex);
+
+	// combine and set middle position
+	FVector middlePos = middleX;
+	middlePos.Y = middleY.Y;
+	middlePos.X += OddRowShift / 2;
+	middlePos.Z += TileHalfExtents.Z * 2;
+
+	// save middle pos, it can be useful later
+	middlePos -= MapStartLocation;
+	OutMapMiddle = middlePos;
+
+	// calculate move deltas from middle to borders
+	float MoveDeltaX = (TileHalfExtents.X * 2) * (SquareMapSize-middleIndex);
+	MoveDeltaX += bIsEven ? TileHalfExtents.X : 0;
+	MoveDeltaX += OddRowShift / 2;
+
+	float MoveDeltaY = RowSpacing * (SquareMapSize-middleIndex);
+	MoveDeltaY += bIsEven ? RowSpacing / 2 : 0;
+
 	
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::North))
+	//left wall
+	FVector leftWallPos = middlePos;
+	leftWallPos.X -= MoveDeltaX;
+	OutPlacements.Add(FTransform(FRotator::ZeroRotator, leftWallPos, FVector(1, ScaleMultiplierY, 1)));
+
+	//right wall
+	FVector rightWallPos = middlePos;
+	rightWallPos.X += MoveDeltaX;
+	OutPlacements.Add(FTransform(FRotator::ZeroRotator, rightWallPos, FVector(1, ScaleMultiplierY, 1)));
+
+	//up wall
+	FVector upWallPos = middlePos;
+	upWallPos.Y += MoveDeltaY;
+	OutPlacements.Add(FTransform(FRotator::ZeroRotator, upWallPos, FVector(ScaleMultiplierX, 1, 1)));
+
+	//down wall
+	FVector downWallPos = middlePos;
+	downWallPos.Y -= MoveDeltaY;
+	OutPlacements.Add(FTransform(FRotator::ZeroRotator, downWallPos, FVector(ScaleMultiplierX, 1, 1)));
+}
+
+void ATBSquareMapGenerator::SpawnBorderWalls(const TArray<FTransform>& Placements)
+{
+	for(const FTransform& Placement : Placements)
+	{
+		AActor* Wall = GetWorld()->SpawnActor<AActor>(WallClass, MapStartLocation + Placement.GetLocation(), Placement.Rotator(), GetActorSpawnParameters());
+		BorderWalls.Add(Wall);
+		Wall->SetActorScale3D(Wall->GetActorScale3D() * Placement.GetScale3D());
+	}
+}
+
+#if WITH_EDITOR
+void ATBSquareMapGenerator::BakeMap()
+{
+	if(!BakedMap)
 	{
-		AdjacentEmptyTiles.Add(TileResult);
+		UE_LOG(LogTemp, Error, TEXT("ATBSquareMapGenerator::BakeMap -> Please set BakedMap to a baked map asset!"));
+		return;
 	}
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::South))
+
+	// BeginPlay doesn't run in the editor, take the extents from the mesh here
+	const UStaticMesh* StaticMesh = InstancedStaticMeshComponent->GetStaticMesh();
+	if(!StaticMesh)
 	{
-		AdjacentEmptyTiles.Add(TileResult);
+		UE_LOG(LogTemp, Error, TEXT("ATBSquareMapGenerator::BakeMap -> Please set the static mesh for InstancedStaticMeshComponent!"));
+		return;
 	}
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::West))
+	// the bake clamps SquareMapSize and changes the extents and the grid of the editor actor, record them for undo
+	Modify();
+	TileHalfExtents = StaticMesh->GetBoundingBox().GetExtent();
+
+	// the same grid and terrain GenerateSquareMap would make, relative to the first tile and without any instance or actor
+	const double StartTime = FPlatformTime::Seconds();
+	InitializeMapGrid(FVector::ZeroVector);
+	GenerateWalkableMasks();
+
+	BakedMap->Modify();
+	BakedMap->SquareMapSize = SquareMapSize;
+	BakedMap->bUseSparseGrid = bUseSparseGrid;
+	BakedMap->bUseMortonTileLayout = bUseMortonTileLayout;
+	BakedMap->GridTopology = GridTopology;
+	BakedMap->ObstacleDensity = MapObstacleDensity;
+	BakedMap->TerrainNoiseScale = TerrainNoiseScale;
+	BakedMap->TerrainSeed = TerrainSeed;
+	BakedMap->TileHalfExtents = TileHalfExtents;
+
+	BakedMap->WaterThreshold = WaterThreshold;
+	BakedMap->RockThreshold = RockThreshold;
+	BakedMap->TerrainNoiseOffset = TerrainNoiseOffset;
+
+	BakedMap->BlockWalkableMasks = BlockWalkableMasks;
+	BakedMap->BlockNumObstacles.SetNumUninitialized(BlockSummaries.Num());
+	for(int32 ChunkIndex = 0; ChunkIndex < BlockSummaries.Num(); ChunkIndex++)
 	{
-		AdjacentEmptyTiles.Add(TileResult);
+		BakedMap->BlockNumObstacles[ChunkIndex] = BlockSummaries[ChunkIndex].NumObstacles;
 	}
-	if(FTileInfo* TileResult = GetTileAtDirection(SourceTile, EDirectionType::East))
+
+	// sparse maps stream their instances, only the grid is baked
+	BakedMap->TileInstanceLocations.Reset();
+	BakedMap->ObstacleInstanceLocations.Reset();
+	BakedMap->ObstacleTerrainValues.Reset();
+	if(!bUseSparseGrid)
 	{
-		AdjacentEmptyTiles.Add(TileResult);
+		BuildTileInstanceLocations(BakedMap->TileInstanceLocations);
+		GetObstacleInstances(FIntPoint(0, 0), FIntPoint(SquareMapSize - 1, SquareMapSize - 1), BakedMap->ObstacleInstanceLocations, BakedMap->ObstacleTerrainValues);
 	}
 
+	GetBorderWallPlacements(BakedMap->SquareMapMiddle, BakedMap->BorderWallPlacements);
+	BakedMap->MarkPackageDirty();
+
+	UE_LOG(LogTemp, Log, TEXT("ATBSquareMapGenerator::BakeMap -> Baked the %dx%d map into %s in %.2f s, %.1f MB"), SquareMapSize, SquareMapSize,
+		*BakedMap->GetName(), FPlatformTime::Seconds() - StartTime, BakedMap->GetAllocatedSize() / (1024.0 * 1024.0));
+
+	// the grid was only needed for the bake, don't keep it on the editor object
+	Chunks.Empty();
+	BlockSummaries.Empty();
+	BlockRowEmptyTiles.Empty();
+	BlockWalkableMasks.Empty();
+	NumChunksPerSide = 0;
+}
+#endif
+
+
+
+FActorSpawnParameters ATBSquareMapGenerator::GetActorSpawnParameters()
+{
+	FActorSpawnParameters Parameters;
+	Parameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	Parameters.Owner = this;
+
+	return Parameters;
+}
+
+FVector ATBSquareMapGenerator::GetTileHalfExtents() const
+{
+	return TileHalfExtents;
+}
+
+
+// Called every frame
+void ATBSquareMapGenerator::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// only ticks in sparse mode
+	UpdateStreamedChunks();
+}
+
+FVector ATBSquareMapGenerator::GetSquareMapMiddle()
+{
+	return SquareMapMiddle;
+}
+
+
+FTBTileHandle ATBSquareMapGenerator::GetTileAtDirection(const FTBTileHandle SourceTile, const EDirectionType Direction) const
+{
+	if(Chunks.Num() <= 0 || !IsValidTile(SourceTile)) return FTBTileHandle();
+
+	// GetTileAt returns an invalid handle if the tile is outside of the map
+	return DispatchGridTopology(MapTopology, [this, SourceTile, Direction](auto TopologyTraits)
+	{
+		using TopologyType = decltype(TopologyTraits);
+		return GetAdjacentTileOf<TopologyType>(SourceTile, TopologyType::DirectionNeighbours[static_cast<uint8>(Direction)]);
+	});
+}
+
+TArray<FTBTileHandle> ATBSquareMapGenerator::GetAllAdjacentEmptyTiles(const FTBTileHandle SourceTile) const
+{
+	TArray<FTBTileHandle> AdjacentEmptyTiles;
+	GetAllAdjacentEmptyTiles(SourceTile, AdjacentEmptyTiles);
 	return AdjacentEmptyTiles;
 }
 
-FTileInfo* ATBSquareMapGenerator::GetRandomEmptyTile() const
+TArray<FTBTileHandle> ATBSquareMapGenerator::GetAllAdjacentTiles(const FTBTileHandle SourceTile) const
+{
+	TArray<FTBTileHandle> AdjacentTiles;
+	GetAllAdjacentTiles(SourceTile, AdjacentTiles);
+	return AdjacentTiles;
+}
+
+FTBTileHandle ATBSquareMapGenerator::GetRandomEmptyTile() const
 {
-	FTileInfo* FoundTile = nullptr;
-	if(AllTiles.Num() <= 0) return nullptr;
+	if(Chunks.Num() <= 0 || TotalEmptyTiles <= 0) return FTBTileHandle();
+
+	// pick the n-th empty tile of the map, then find it by walking rows of blocks, blocks and finally tiles.
+	// Full blocks are skipped without touching their tiles and empty unallocated blocks without allocating them.
+	int32 EmptyTileIndex = UKismetMathLibrary::RandomIntegerInRange(0, TotalEmptyTiles-1);
+
+	int ChunkY = 0;
+	while(EmptyTileIndex >= BlockRowEmptyTiles[ChunkY])
+	{
+		EmptyTileIndex -= BlockRowEmptyTiles[ChunkY];
+		ChunkY++;
+	}
+
+	int ChunkX = 0;
+	while(EmptyTileIndex >= BlockSummaries[ChunkY * NumChunksPerSide + ChunkX].NumEmptyTiles)
+	{
+		EmptyTileIndex -= BlockSummaries[ChunkY * NumChunksPerSide + ChunkX].NumEmptyTiles;
+		ChunkX++;
+	}
 
-	TArray<FTileInfo*> UncheckedTiles = AllTiles;
+	const int BlockWidth = FMath::Min(TileChunkSize, SquareMapSize - ChunkX * TileChunkSize);
+	const int BlockHeight = FMath::Min(TileChunkSize, SquareMapSize - ChunkY * TileChunkSize);
+
+	// unallocated chunks without obstacles are completely empty, so the n-th empty tile is the n-th tile
+	const int32 ChunkIndex = ChunkY * NumChunksPerSide + ChunkX;
+	if(!Chunks[ChunkIndex].IsValid() && BlockSummaries[ChunkIndex].NumObstacles <= 0)
+	{
+		return GetTileAt(ChunkX * TileChunkSize + EmptyTileIndex % BlockWidth, ChunkY * TileChunkSize + EmptyTileIndex / BlockWidth);
+	}
 
-	while (UncheckedTiles.Num() > 0)
+	for(int LocalY = 0; LocalY < BlockHeight; LocalY++)
 	{
-		const int RandomIndex = UKismetMathLibrary::RandomIntegerInRange(0, UncheckedTiles.Num()-1);
-		if(UncheckedTiles[RandomIndex]->bIsEmptyTile)
+		for(int LocalX = 0; LocalX < BlockWidth; LocalX++)
 		{
-			FoundTile = UncheckedTiles[RandomIndex];
-			return FoundTile;
+			const int X = ChunkX * TileChunkSize + LocalX;
+			const int Y = ChunkY * TileChunkSize + LocalY;
+			if(IsTileEmptyAt(X, Y) && EmptyTileIndex-- == 0)
+			{
+				return GetTileAt(X, Y);
+			}
 		}
-		UncheckedTiles.RemoveAt(RandomIndex);
 	}
 
-	return nullptr;
+	return FTBTileHandle();
 }
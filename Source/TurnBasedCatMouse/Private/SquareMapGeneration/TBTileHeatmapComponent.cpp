@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SquareMapGeneration/TBTileHeatmapComponent.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/Texture2D.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+UTBTileHeatmapComponent::UTBTileHeatmapComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	HeatmapMode = ETBTileHeatmapMode::Disabled;
+	EmptyTileColor = FColor::Black;
+	TextureParameterName = TEXT("TileStateTexture");
+	MapParameterName = TEXT("TileStateMap");
+	MapSizeParameterName = TEXT("TileStateMapSize");
+	MaxHeatmapSize = 999;
+	HeatmapTexture = nullptr;
+	TileMaterialInstance = nullptr;
+	HeatmapSize = 0;
+}
+
+bool UTBTileHeatmapComponent::InitializeHeatmap(UPrimitiveComponent* MeshComponent, const int32 MapSize, const FVector& FirstTileLocation, const FVector2D& TileSize)
+{
+	HeatmapTexture = nullptr;
+	TexelBuffer.Empty();
+	HeatmapSize = 0;
+
+	if(HeatmapMode == ETBTileHeatmapMode::Disabled || !MeshComponent) return false;
+
+	if(MapSize > MaxHeatmapSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UTBTileHeatmapComponent::InitializeHeatmap -> Map size %d is bigger than MaxHeatmapSize %d, heatmap is disabled!"), MapSize, MaxHeatmapSize);
+		return false;
+	}
+
+	// one texel per tile, sampled without filtering so tiles keep hard edges
+	HeatmapTexture = UTexture2D::CreateTransient(MapSize, MapSize, PF_B8G8R8A8);
+	if(!HeatmapTexture) return false;
+
+	HeatmapTexture->SRGB = false;
+	HeatmapTexture->Filter = TF_Nearest;
+	HeatmapTexture->AddressX = TA_Clamp;
+	HeatmapTexture->AddressY = TA_Clamp;
+	HeatmapTexture->UpdateResource();
+
+	HeatmapSize = MapSize;
+	TexelBuffer.SetNumUninitialized(MapSize * MapSize);
+
+	// reuses the dynamic instance if the material already is one
+	TileMaterialInstance = MeshComponent->CreateAndSetMaterialInstanceDynamic(0);
+	if(TileMaterialInstance)
+	{
+		TileMaterialInstance->SetTextureParameterValue(TextureParameterName, HeatmapTexture);
+		TileMaterialInstance->SetVectorParameterValue(MapParameterName, FLinearColor(FirstTileLocation.X, FirstTileLocation.Y, TileSize.X, TileSize.Y));
+		TileMaterialInstance->SetScalarParameterValue(MapSizeParameterName, MapSize);
+	}
+
+	BeginHeatmapUpdate();
+	FlushHeatmap();
+	return true;
+}
+
+void UTBTileHeatmapComponent::BeginHeatmapUpdate()
+{
+	if(!HeatmapTexture) return;
+
+	const FColor ClearColor = HeatmapMode == ETBTileHeatmapMode::TileColor ? FColor(EmptyTileColor.R, EmptyTileColor.G, EmptyTileColor.B, 0) : FColor(0, 0, 0, 0);
+	for(FColor& Texel : TexelBuffer)
+	{
+		Texel = ClearColor;
+	}
+}
+
+void UTBTileHeatmapComponent::WriteTile(const FIntPoint& Coordinates, const FLinearColor& TileColor, const ETBMammalSpecies Species, const uint8 StarveCounter, const uint8 BreedCounter)
+{
+	if(!HeatmapTexture) return;
+
+	FColor& Texel = TexelBuffer[Coordinates.Y * HeatmapSize + Coordinates.X];
+	if(HeatmapMode == ETBTileHeatmapMode::TileColor)
+	{
+		Texel = TileColor.ToFColor(false);
+		Texel.A = 255;
+	}
+	else
+	{
+		Texel = FColor(static_cast<uint8>(Species) + 1, StarveCounter, BreedCounter, 255);
+	}
+}
+
+void UTBTileHeatmapComponent::FlushHeatmap()
+{
+	if(!HeatmapTexture) return;
+
+	// the render thread reads the data later, so it gets its own copy and frees it when the upload is done
+	const int32 NumBytes = TexelBuffer.Num() * sizeof(FColor);
+	uint8* UploadData = new uint8[NumBytes];
+	FMemory::Memcpy(UploadData, TexelBuffer.GetData(), NumBytes);
+
+	FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(0, 0, 0, 0, HeatmapSize, HeatmapSize);
+	HeatmapTexture->UpdateTextureRegions(0, 1, Region, HeatmapSize * sizeof(FColor), sizeof(FColor), UploadData,
+		[](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+		{
+			delete[] SrcData;
+			delete Regions;
+		});
+}
+
+SIZE_T UTBTileHeatmapComponent::GetAllocatedSize() const
+{
+	return TexelBuffer.GetAllocatedSize() + (HeatmapTexture ? HeatmapTexture->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal) : 0);
+}
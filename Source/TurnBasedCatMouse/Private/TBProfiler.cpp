@@ -0,0 +1,213 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TBProfiler.h"
+#include "Misc/FileHelper.h"
+
+DEFINE_STAT(STAT_TBGeneration);
+DEFINE_STAT(STAT_TBSpawning);
+DEFINE_STAT(STAT_TBRound);
+DEFINE_STAT(STAT_TBBuildFields);
+DEFINE_STAT(STAT_TBMove);
+DEFINE_STAT(STAT_TBEat);
+DEFINE_STAT(STAT_TBBreed);
+DEFINE_STAT(STAT_TBStarve);
+
+FTBProfiler* FTBProfiler::ActiveProfiler = nullptr;
+
+static constexpr int32 TBNumProfileScopes = static_cast<int32>(ETBProfileScope::Num);
+
+static const TCHAR* TBProfileSummaryHeader = TEXT("Scenario,Scope,Calls,Samples,TotalMs,MeanMs,P50Ms,P90Ms,P99Ms,MaxMs");
+
+// Nearest rank percentile of sorted values
+static double GetPercentile(const TArray<double>& SortedValues, const double Percentile)
+{
+	if(SortedValues.Num() <= 0) return 0;
+
+	const int32 Rank = FMath::CeilToInt32(Percentile * SortedValues.Num());
+	return SortedValues[FMath::Clamp(Rank - 1, 0, SortedValues.Num() - 1)];
+}
+
+FTBProfiler::FTBProfiler()
+{
+	FMemory::Memzero(SampleCycles);
+	FMemory::Memzero(SampleCalls);
+	FMemory::Memzero(TotalCalls);
+}
+
+FTBProfiler::~FTBProfiler()
+{
+	if(ActiveProfiler == this)
+	{
+		ActiveProfiler = nullptr;
+	}
+}
+
+void FTBProfiler::Begin()
+{
+	check(IsInGameThread());
+
+	FMemory::Memzero(SampleCycles);
+	FMemory::Memzero(SampleCalls);
+	FMemory::Memzero(TotalCalls);
+	for(TArray<double>& Samples : SamplesMs)
+	{
+		Samples.Reset();
+	}
+	ActiveProfiler = this;
+}
+
+void FTBProfiler::End()
+{
+	EndSample();
+	if(ActiveProfiler == this)
+	{
+		ActiveProfiler = nullptr;
+	}
+}
+
+void FTBProfiler::EndSample()
+{
+	for(int32 ScopeIndex = 0; ScopeIndex < TBNumProfileScopes; ScopeIndex++)
+	{
+		if(SampleCalls[ScopeIndex] <= 0) continue;
+
+		SamplesMs[ScopeIndex].Add(FPlatformTime::ToMilliseconds64(SampleCycles[ScopeIndex]));
+		TotalCalls[ScopeIndex] += SampleCalls[ScopeIndex];
+		SampleCycles[ScopeIndex] = 0;
+		SampleCalls[ScopeIndex] = 0;
+	}
+}
+
+void FTBProfiler::AddTime(const ETBProfileScope Scope, const uint64 Cycles)
+{
+	if(!IsInGameThread()) return;
+
+	SampleCycles[static_cast<int32>(Scope)] += Cycles;
+	SampleCalls[static_cast<int32>(Scope)]++;
+}
+
+const TCHAR* FTBProfiler::GetScopeName(const ETBProfileScope Scope)
+{
+	switch(Scope)
+	{
+	case ETBProfileScope::Generation: return TEXT("Generation");
+	case ETBProfileScope::Spawning: return TEXT("Spawning");
+	case ETBProfileScope::Round: return TEXT("Round");
+	case ETBProfileScope::BuildFields: return TEXT("BuildFields");
+	case ETBProfileScope::Move: return TEXT("Move");
+	case ETBProfileScope::Eat: return TEXT("Eat");
+	case ETBProfileScope::Breed: return TEXT("Breed");
+	case ETBProfileScope::Starve: return TEXT("Starve");
+	default: return TEXT("Unknown");
+	}
+}
+
+void FTBProfiler::GetSummary(const FString& Scenario, TArray<FTBProfileSummaryRow>& OutRows) const
+{
+	for(int32 ScopeIndex = 0; ScopeIndex < TBNumProfileScopes; ScopeIndex++)
+	{
+		if(SamplesMs[ScopeIndex].Num() <= 0) continue;
+
+		TArray<double> SortedSamples = SamplesMs[ScopeIndex];
+		SortedSamples.Sort();
+
+		FTBProfileSummaryRow& Row = OutRows.AddDefaulted_GetRef();
+		Row.Scenario = Scenario;
+		Row.Scope = GetScopeName(static_cast<ETBProfileScope>(ScopeIndex));
+		Row.Calls = TotalCalls[ScopeIndex];
+		Row.Samples = SortedSamples.Num();
+		for(const double SampleMs : SortedSamples)
+		{
+			Row.TotalMs += SampleMs;
+		}
+		Row.MeanMs = Row.TotalMs / Row.Samples;
+		Row.P50Ms = GetPercentile(SortedSamples, 0.5);
+		Row.P90Ms = GetPercentile(SortedSamples, 0.9);
+		Row.P99Ms = GetPercentile(SortedSamples, 0.99);
+		Row.MaxMs = SortedSamples.Last();
+	}
+}
+
+bool FTBProfiler::SaveSummary(const FString& FilePath, const TArray<FTBProfileSummaryRow>& Rows)
+{
+	TArray<FString> Lines;
+	Lines.Reserve(Rows.Num() + 1);
+	Lines.Add(TBProfileSummaryHeader);
+	for(const FTBProfileSummaryRow& Row : Rows)
+	{
+		Lines.Add(FString::Printf(TEXT("%s,%s,%lld,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f"), *Row.Scenario, *Row.Scope, Row.Calls, Row.Samples,
+			Row.TotalMs, Row.MeanMs, Row.P50Ms, Row.P90Ms, Row.P99Ms, Row.MaxMs));
+	}
+
+	if(!FFileHelper::SaveStringArrayToFile(Lines, *FilePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("FTBProfiler::SaveSummary -> Can't write %s!"), *FilePath);
+		return false;
+	}
+	return true;
+}
+
+bool FTBProfiler::LoadSummary(const FString& FilePath, TArray<FTBProfileSummaryRow>& OutRows)
+{
+	TArray<FString> Lines;
+	if(!FFileHelper::LoadFileToStringArray(Lines, *FilePath) || Lines.Num() <= 1) return false;
+
+	if(Lines[0] != TBProfileSummaryHeader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FTBProfiler::LoadSummary -> %s is not a profiling summary!"), *FilePath);
+		return false;
+	}
+
+	for(int32 LineIndex = 1; LineIndex < Lines.Num(); LineIndex++)
+	{
+		TArray<FString> Cells;
+		Lines[LineIndex].ParseIntoArray(Cells, TEXT(","), false);
+		if(Cells.Num() != 10) continue;
+
+		FTBProfileSummaryRow& Row = OutRows.AddDefaulted_GetRef();
+		Row.Scenario = Cells[0];
+		Row.Scope = Cells[1];
+		Row.Calls = FCString::Atoi64(*Cells[2]);
+		Row.Samples = FCString::Atoi(*Cells[3]);
+		Row.TotalMs = FCString::Atod(*Cells[4]);
+		Row.MeanMs = FCString::Atod(*Cells[5]);
+		Row.P50Ms = FCString::Atod(*Cells[6]);
+		Row.P90Ms = FCString::Atod(*Cells[7]);
+		Row.P99Ms = FCString::Atod(*Cells[8]);
+		Row.MaxMs = FCString::Atod(*Cells[9]);
+	}
+	return OutRows.Num() > 0;
+}
+
+int32 FTBProfiler::CompareToBaseline(const TArray<FTBProfileSummaryRow>& Rows, const TArray<FTBProfileSummaryRow>& BaselineRows, const float Threshold)
+{
+	int32 NumRegressions = 0;
+	for(const FTBProfileSummaryRow& Row : Rows)
+	{
+		const FTBProfileSummaryRow* BaselineRow = BaselineRows.FindByPredicate([&Row](const FTBProfileSummaryRow& Other)
+		{
+			return Other.Scenario == Row.Scenario && Other.Scope == Row.Scope;
+		});
+		if(!BaselineRow)
+		{
+			UE_LOG(LogTemp, Display, TEXT("FTBProfiler::CompareToBaseline -> %s %s is not in the baseline"), *Row.Scenario, *Row.Scope);
+			continue;
+		}
+
+		// a scope regresses if its typical or its slow samples got slower
+		const TPair<double, double> Compared[] = { {Row.MeanMs, BaselineRow->MeanMs}, {Row.P90Ms, BaselineRow->P90Ms} };
+		const TCHAR* ComparedNames[] = { TEXT("mean"), TEXT("p90") };
+		for(int32 i = 0; i < UE_ARRAY_COUNT(Compared); i++)
+		{
+			const double CurrentMs = Compared[i].Key;
+			const double BaselineMs = Compared[i].Value;
+			if(BaselineMs < MinComparedMs || CurrentMs <= BaselineMs * (1.0 + Threshold)) continue;
+
+			UE_LOG(LogTemp, Warning, TEXT("FTBProfiler::CompareToBaseline -> %s %s %s regressed from %.3f ms to %.3f ms (+%.1f%%)!"),
+				*Row.Scenario, *Row.Scope, ComparedNames[i], BaselineMs, CurrentMs, (CurrentMs / BaselineMs - 1.0) * 100.0);
+			NumRegressions++;
+		}
+	}
+	return NumRegressions;
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TBRoundArena.h"
+
+FTBRoundArena::FTBRoundArena(const SIZE_T InitialBlockSize)
+	: BlockSize(InitialBlockSize), BlockOffset(0), OverflowBytes(0), LastPeakBytes(0)
+{
+	Block = static_cast<uint8*>(FMemory::Malloc(BlockSize));
+}
+
+FTBRoundArena::~FTBRoundArena()
+{
+	Reset();
+	FMemory::Free(Block);
+}
+
+void* FTBRoundArena::Allocate(const SIZE_T Size, const SIZE_T Alignment)
+{
+	const SIZE_T AlignedOffset = Align(BlockOffset, Alignment);
+	if(AlignedOffset + Size <= BlockSize)
+	{
+		BlockOffset = AlignedOffset + Size;
+		return Block + AlignedOffset;
+	}
+
+	// the block is full, serve the rest of the round from the heap
+	void* Allocation = FMemory::Malloc(Size, Alignment);
+	OverflowAllocations.Add(Allocation);
+	OverflowBytes += Size;
+	return Allocation;
+}
+
+void FTBRoundArena::Reset()
+{
+	LastPeakBytes = GetUsedBytes();
+
+	if(OverflowAllocations.Num() > 0)
+	{
+		for(void* Allocation : OverflowAllocations)
+		{
+			FMemory::Free(Allocation);
+		}
+		OverflowAllocations.Reset();
+		OverflowBytes = 0;
+
+		// grow the block so the next round with the same peak fits
+		BlockSize = FMath::RoundUpToPowerOfTwo64(LastPeakBytes);
+		FMemory::Free(Block);
+		Block = static_cast<uint8*>(FMemory::Malloc(BlockSize));
+	}
+
+	BlockOffset = 0;
+}
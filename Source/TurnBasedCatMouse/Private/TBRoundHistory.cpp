@@ -0,0 +1,265 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TBRoundHistory.h"
+
+FTBRoundHistory::FTBRoundHistory()
+	: MapGenerator(nullptr), CurrentRound(0), CheckpointInterval(1), MaxRewindRounds(0), MaxCheckpoints(0), bIsRoundOpen(false)
+{
+}
+
+FTBRoundHistory::~FTBRoundHistory()
+{
+	Reset();
+}
+
+void FTBRoundHistory::Start(ATBSquareMapGenerator* InMapGenerator, const int32 Round, const int32 InCheckpointInterval, const int32 InMaxRewindRounds, const int32 InMaxCheckpoints)
+{
+	Reset();
+
+	MapGenerator = InMapGenerator;
+	CurrentRound = Round;
+	CheckpointInterval = FMath::Max(InCheckpointInterval, 1);
+	MaxRewindRounds = FMath::Max(InMaxRewindRounds, 0);
+	MaxCheckpoints = FMath::Max(InMaxCheckpoints, 1);
+}
+
+void FTBRoundHistory::Reset()
+{
+	// the journal points into the open delta
+	if(bIsRoundOpen && IsValid(MapGenerator))
+	{
+		MapGenerator->SetTileJournal(nullptr);
+	}
+
+	MapGenerator = nullptr;
+	Pages.Reset();
+	Deltas.Reset();
+	Checkpoints.Reset();
+	CurrentRound = 0;
+	bIsRoundOpen = false;
+}
+
+void FTBRoundHistory::BeginRound(const int32 Round)
+{
+	if(!IsActive()) return;
+
+	ensure(!bIsRoundOpen && Round == CurrentRound + 1);
+	CurrentRound = Round;
+
+	FTBRoundDelta& Delta = Deltas.AddDefaulted_GetRef();
+	Delta.Round = Round;
+	MapGenerator->SetTileJournal(&Delta.TileDeltas);
+	bIsRoundOpen = true;
+}
+
+void FTBRoundHistory::EndRound()
+{
+	if(!IsActive()) return;
+
+	if(bIsRoundOpen)
+	{
+		MapGenerator->SetTileJournal(nullptr);
+		bIsRoundOpen = false;
+	}
+
+	// sharing the pages is the whole copy, they are only duplicated once the live records write to them
+	if(CurrentRound % CheckpointInterval == 0 && (Checkpoints.Num() <= 0 || Checkpoints.Last().Round != CurrentRound))
+	{
+		FTBRoundCheckpoint& Checkpoint = Checkpoints.AddDefaulted_GetRef();
+		Checkpoint.Round = CurrentRound;
+		Checkpoint.Pages = Pages;
+	}
+
+	if(Deltas.Num() > MaxRewindRounds)
+	{
+		Deltas.RemoveAt(0, Deltas.Num() - MaxRewindRounds);
+	}
+	if(Checkpoints.Num() > MaxCheckpoints)
+	{
+		Checkpoints.RemoveAt(0, Checkpoints.Num() - MaxCheckpoints);
+	}
+}
+
+void FTBRoundHistory::RecordMammal(const int32 SlotIndex, const FTBMammalRecord& Record)
+{
+	if(!IsActive() || GetRecord(SlotIndex) == Record) return;
+
+	FTBMammalRecord& LiveRecord = GetWritableRecord(SlotIndex);
+	if(bIsRoundOpen)
+	{
+		Deltas.Last().MammalDeltas.Add(FTBMammalDelta{SlotIndex, LiveRecord});
+	}
+	LiveRecord = Record;
+}
+
+const FTBMammalRecord& FTBRoundHistory::GetRecord(const int32 SlotIndex) const
+{
+	static const FTBMammalRecord FreeSlotRecord;
+
+	const int32 PageIndex = SlotIndex / TBRoundHistoryPageSize;
+	if(!Pages.IsValidIndex(PageIndex)) return FreeSlotRecord;
+
+	return Pages[PageIndex]->Records[SlotIndex % TBRoundHistoryPageSize];
+}
+
+FTBMammalRecord& FTBRoundHistory::GetWritableRecord(const int32 SlotIndex)
+{
+	const int32 PageIndex = SlotIndex / TBRoundHistoryPageSize;
+	while(Pages.Num() <= PageIndex)
+	{
+		Pages.Add(MakeShared<FTBMammalRecordPage>());
+	}
+
+	TSharedPtr<FTBMammalRecordPage>& Page = Pages[PageIndex];
+	if(!Page.IsUnique())
+	{
+		Page = MakeShared<FTBMammalRecordPage>(*Page);
+	}
+	return Page->Records[SlotIndex % TBRoundHistoryPageSize];
+}
+
+int32 FTBRoundHistory::GetOldestDeltaRound() const
+{
+	// the first delta undoes its round, so the round before it is the oldest reachable one
+	return Deltas.Num() > 0 ? Deltas[0].Round - 1 : CurrentRound;
+}
+
+bool FTBRoundHistory::CanRewindTo(const int32 TargetRound) const
+{
+	if(!IsActive() || bIsRoundOpen || TargetRound < 0 || TargetRound >= CurrentRound) return false;
+
+	if(TargetRound >= GetOldestDeltaRound()) return true;
+
+	return Checkpoints.ContainsByPredicate([TargetRound](const FTBRoundCheckpoint& Checkpoint)
+	{
+		return Checkpoint.Round == TargetRound;
+	});
+}
+
+bool FTBRoundHistory::RewindTo(const int32 TargetRound, TArray<int32>& OutChangedSlots)
+{
+	if(!CanRewindTo(TargetRound)) return false;
+
+	TSet<int32> ChangedSlots;
+
+	// checkpoints are in round order, the first one not before the target leaves the fewest deltas to undo
+	const int32 CheckpointIndex = Checkpoints.IndexOfByPredicate([TargetRound](const FTBRoundCheckpoint& Checkpoint)
+	{
+		return Checkpoint.Round >= TargetRound;
+	});
+	int32 RestoredRound = CurrentRound;
+	if(Checkpoints.IsValidIndex(CheckpointIndex) && Checkpoints[CheckpointIndex].Round < CurrentRound)
+	{
+		RestoreCheckpoint(Checkpoints[CheckpointIndex], ChangedSlots);
+		RestoredRound = Checkpoints[CheckpointIndex].Round;
+	}
+
+	while(Deltas.Num() > 0 && Deltas.Last().Round > TargetRound)
+	{
+		// rounds after the checkpoint are already undone by restoring it
+		if(Deltas.Last().Round <= RestoredRound)
+		{
+			UndoDelta(Deltas.Last(), ChangedSlots);
+		}
+		Deltas.Pop(false);
+	}
+
+	// the rounds after the target are a branch that is not played anymore
+	while(Checkpoints.Num() > 0 && Checkpoints.Last().Round > TargetRound)
+	{
+		Checkpoints.Pop(false);
+	}
+
+	CurrentRound = TargetRound;
+	OutChangedSlots = ChangedSlots.Array();
+	return true;
+}
+
+void FTBRoundHistory::RestoreCheckpoint(const FTBRoundCheckpoint& Checkpoint, TSet<int32>& ChangedSlots)
+{
+	static const FTBMammalRecordPage FreePage;
+
+	TArray<TPair<FTBMammalRecord, FTBMammalRecord>, TInlineAllocator<64>> Changes;
+	const int32 NumPages = FMath::Max(Pages.Num(), Checkpoint.Pages.Num());
+	for(int32 PageIndex = 0; PageIndex < NumPages; PageIndex++)
+	{
+		const FTBMammalRecordPage* LivePage = Pages.IsValidIndex(PageIndex) ? Pages[PageIndex].Get() : &FreePage;
+		const FTBMammalRecordPage* CheckpointPage = Checkpoint.Pages.IsValidIndex(PageIndex) ? Checkpoint.Pages[PageIndex].Get() : &FreePage;
+
+		// a page nobody wrote to since the checkpoint is still the same page
+		if(LivePage == CheckpointPage) continue;
+
+		for(int32 i = 0; i < TBRoundHistoryPageSize; i++)
+		{
+			if(LivePage->Records[i] != CheckpointPage->Records[i])
+			{
+				ChangedSlots.Add(PageIndex * TBRoundHistoryPageSize + i);
+				Changes.Emplace(LivePage->Records[i], CheckpointPage->Records[i]);
+			}
+		}
+	}
+
+	// every occupant leaves before any arrives, a tile can change hands between the two states
+	for(const TPair<FTBMammalRecord, FTBMammalRecord>& Change : Changes)
+	{
+		if(Change.Key.IsAlive() && MapGenerator->GetTileOccupant(Change.Key.Tile) == Change.Key.Handle)
+		{
+			MapGenerator->ClearTile(Change.Key.Tile);
+		}
+	}
+	for(const TPair<FTBMammalRecord, FTBMammalRecord>& Change : Changes)
+	{
+		if(Change.Value.IsAlive())
+		{
+			MapGenerator->SetTileOccupant(Change.Value.Tile, Change.Value.Handle, Change.Value.Species);
+		}
+	}
+
+	Pages = Checkpoint.Pages;
+}
+
+void FTBRoundHistory::UndoDelta(const FTBRoundDelta& Delta, TSet<int32>& ChangedSlots)
+{
+	for(int32 i = Delta.TileDeltas.Num() - 1; i >= 0; i--)
+	{
+		MapGenerator->RestoreTile(Delta.TileDeltas[i]);
+	}
+
+	for(int32 i = Delta.MammalDeltas.Num() - 1; i >= 0; i--)
+	{
+		const FTBMammalDelta& MammalDelta = Delta.MammalDeltas[i];
+		GetWritableRecord(MammalDelta.SlotIndex) = MammalDelta.OldRecord;
+		ChangedSlots.Add(MammalDelta.SlotIndex);
+	}
+}
+
+SIZE_T FTBRoundHistory::GetAllocatedSize() const
+{
+	SIZE_T Bytes = Pages.GetAllocatedSize() + Deltas.GetAllocatedSize() + Checkpoints.GetAllocatedSize();
+	for(const FTBRoundDelta& Delta : Deltas)
+	{
+		Bytes += Delta.TileDeltas.GetAllocatedSize() + Delta.MammalDeltas.GetAllocatedSize();
+	}
+
+	TSet<const FTBMammalRecordPage*> CountedPages;
+	auto CountPages = [&Bytes, &CountedPages](const TArray<TSharedPtr<FTBMammalRecordPage>>& PagesToCount)
+	{
+		for(const TSharedPtr<FTBMammalRecordPage>& Page : PagesToCount)
+		{
+			bool bIsAlreadyCounted = false;
+			CountedPages.Add(Page.Get(), &bIsAlreadyCounted);
+			if(!bIsAlreadyCounted)
+			{
+				Bytes += sizeof(FTBMammalRecordPage);
+			}
+		}
+	};
+	CountPages(Pages);
+	for(const FTBRoundCheckpoint& Checkpoint : Checkpoints)
+	{
+		Bytes += Checkpoint.Pages.GetAllocatedSize();
+		CountPages(Checkpoint.Pages);
+	}
+	return Bytes;
+}
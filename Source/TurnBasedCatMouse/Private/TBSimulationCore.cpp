@@ -0,0 +1,414 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TBSimulationCore.h"
+#include "SquareMapGeneration/TBMorton.h"
+#include "Algo/Sort.h"
+
+// Adjacent tiles of one mammal, never more than the topology's neighbour count
+using FTBAdjacentTileArray = TArray<FTBTileHandle, TInlineAllocator<TBMaxGridNeighbours>>;
+
+void FTBRoundResult::Reset()
+{
+	Round = 0;
+	Events.Reset();
+	Mammals.Reset();
+	NumCats = 0;
+	NumMice = 0;
+	CatsBorn = 0;
+	MiceBorn = 0;
+	CatsStarved = 0;
+	MiceStarved = 0;
+	MiceEaten = 0;
+}
+
+bool FTBSimulationCore::Initialize(const ATBSquareMapGenerator* InMap, const FTBSimulationSettings& InSettings, const int32 InRound)
+{
+	Reset();
+
+	if(!InMap || InMap->GetSquareMapSize() > MaxMapSize) return false;
+
+	Map = InMap;
+	Settings = InSettings;
+	CurrentRound = InRound;
+	TileOccupants.Init(INDEX_NONE, Map->GetSquareMapSize() * Map->GetSquareMapSize());
+	return true;
+}
+
+void FTBSimulationCore::Reset()
+{
+	Map = nullptr;
+	CurrentRound = 0;
+	NextId = 1;
+
+	Ids.Reset();
+	Species.Reset();
+	Tiles.Reset();
+	StarveCounters.Reset();
+	BreedCounters.Reset();
+	SavedBreedCounters.Reset();
+	FreeSlots.Reset();
+	TileOccupants.Reset();
+	Cats.Reset();
+	Mice.Reset();
+	MammalsToBreed.Reset();
+	MammalsToStarve.Reset();
+
+	PreyDistanceField.Reset();
+	ThreatInfluenceMap.Reset();
+}
+
+uint32 FTBSimulationCore::AddMammal(const ETBMammalSpecies InSpecies, const FTBTileHandle Tile, const uint8 StarveCounter, const uint8 BreedCounter, const uint8 SavedBreedCounter)
+{
+	check(Map && Map->IsValidTile(Tile) && TileOccupants[Tile.GetIndex()] == INDEX_NONE);
+
+	const int32 Slot = AllocateSlot();
+	Ids[Slot] = NextId++;
+	Species[Slot] = InSpecies;
+	Tiles[Slot] = Tile;
+	StarveCounters[Slot] = StarveCounter;
+	BreedCounters[Slot] = BreedCounter;
+	SavedBreedCounters[Slot] = SavedBreedCounter;
+
+	TileOccupants[Tile.GetIndex()] = Slot;
+	(InSpecies == ETBMammalSpecies::Cat ? Cats : Mice).Add(Slot);
+	return Ids[Slot];
+}
+
+void FTBSimulationCore::SetRandomSeed(const int32 Seed)
+{
+	RandomStream.Initialize(Seed);
+}
+
+int32 FTBSimulationCore::RandomIntegerInRange(const int32 Min, const int32 Max)
+{
+	return bUseGlobalRandom ? FMath::RandRange(Min, Max) : RandomStream.RandRange(Min, Max);
+}
+
+uint32 FTBSimulationCore::GetTileOccupantId(const FTBTileHandle Tile) const
+{
+	const int32 Slot = TileOccupants[Tile.GetIndex()];
+	return Slot != INDEX_NONE ? Ids[Slot] : 0;
+}
+
+SIZE_T FTBSimulationCore::GetAllocatedSize() const
+{
+	return Ids.GetAllocatedSize() + Species.GetAllocatedSize() + Tiles.GetAllocatedSize() + StarveCounters.GetAllocatedSize()
+		+ BreedCounters.GetAllocatedSize() + SavedBreedCounters.GetAllocatedSize() + FreeSlots.GetAllocatedSize() + TileOccupants.GetAllocatedSize()
+		+ Cats.GetAllocatedSize() + Mice.GetAllocatedSize() + MammalsToBreed.GetAllocatedSize() + MammalsToStarve.GetAllocatedSize()
+		+ PreyDistanceField.GetAllocatedSize() + ThreatInfluenceMap.GetAllocatedSize();
+}
+
+int32 FTBSimulationCore::AllocateSlot()
+{
+	if(FreeSlots.Num() > 0)
+	{
+		return FreeSlots.Pop(false);
+	}
+
+	Ids.AddZeroed();
+	Species.AddZeroed();
+	Tiles.AddDefaulted();
+	StarveCounters.AddZeroed();
+	BreedCounters.AddZeroed();
+	SavedBreedCounters.AddZeroed();
+	return Ids.Num() - 1;
+}
+
+void FTBSimulationCore::ReleaseSlot(const int32 Slot)
+{
+	TileOccupants[Tiles[Slot].GetIndex()] = INDEX_NONE;
+	Ids[Slot] = 0;
+	FreeSlots.Add(Slot);
+}
+
+void FTBSimulationCore::SortByZOrder(TArray<int32>& Slots) const
+{
+	TArray<TPair<uint32, int32>> SortKeys;
+	SortKeys.Reserve(Slots.Num());
+	for(const int32 Slot : Slots)
+	{
+		const FIntPoint Coordinates = Map->GetTileCoordinates(Tiles[Slot]);
+		SortKeys.Emplace(FTBMorton::Encode(Coordinates.X, Coordinates.Y), Slot);
+	}
+
+	// one mammal per tile, the keys are unique
+	Algo::SortBy(SortKeys, &TPair<uint32, int32>::Key);
+
+	for(int32 i = 0; i < SortKeys.Num(); i++)
+	{
+		Slots[i] = SortKeys[i].Value;
+	}
+}
+
+void FTBSimulationCore::BuildRoundFields()
+{
+	PreyDistanceField.Reset();
+	if(Settings.bEnableCatHunting)
+	{
+		// like the manager, only species that are eaten are prey
+		TArray<FTBTileHandle> MouseTiles;
+		if(Settings.CatRules.PreyMask & TBSpeciesBit(ETBMammalSpecies::Mouse))
+		{
+			MouseTiles.Reserve(Mice.Num());
+			for(const int32 Slot : Mice)
+			{
+				MouseTiles.Add(Tiles[Slot]);
+			}
+		}
+		// a failed build leaves the field unbuilt for this round only
+		PreyDistanceField.Build(*Map, MouseTiles, Settings.MaxHuntDistance);
+	}
+
+	ThreatInfluenceMap.Reset();
+	if(Settings.bEnableMouseEvasion)
+	{
+		// and only species that eat are a threat
+		TArray<FTBTileHandle> CatTiles;
+		if(Settings.CatRules.PreyMask != 0)
+		{
+			CatTiles.Reserve(Cats.Num());
+			for(const int32 Slot : Cats)
+			{
+				CatTiles.Add(Tiles[Slot]);
+			}
+		}
+		ThreatInfluenceMap.Build(*Map, CatTiles, Settings.ThreatRadius);
+	}
+}
+
+void FTBSimulationCore::StepRound(FTBRoundResult& OutResult)
+{
+	check(Map);
+
+	OutResult.Reset();
+	CurrentRound++;
+	OutResult.Round = CurrentRound;
+
+	if(Settings.bSortByZOrder && (CurrentRound - 1) % FMath::Max(Settings.ZOrderSortInterval, 1) == 0)
+	{
+		SortByZOrder(Cats);
+		SortByZOrder(Mice);
+	}
+
+	BuildRoundFields();
+
+	// cats play first, only the mice array shrinks during the turns
+	for(int32 i = 0; i < Cats.Num(); i++)
+	{
+		ExecuteTurn<ETBMammalSpecies::Cat>(Cats[i], OutResult);
+	}
+	for(int32 i = 0; i < Mice.Num(); i++)
+	{
+		ExecuteTurn<ETBMammalSpecies::Mouse>(Mice[i], OutResult);
+	}
+
+	TryBreedMammals(OutResult);
+	TryStarveMammals(OutResult);
+
+	WriteSnapshot(OutResult);
+}
+
+template<ETBMammalSpecies InSpecies>
+void FTBSimulationCore::ExecuteTurn(const int32 Slot, FTBRoundResult& Result)
+{
+	using FTraits = TTBSpeciesTraits<InSpecies>;
+	const FTBSpeciesRules& Rules = InSpecies == ETBMammalSpecies::Cat ? Settings.CatRules : Settings.MouseRules;
+	const FTBTileHandle CurrentTile = Tiles[Slot];
+
+	// eat a random adjacent prey if there is any, species without prey don't even look
+	FTBTileHandle EatTarget;
+	if constexpr(FTraits::bCanEat)
+	{
+		if(Rules.bCanEat && Rules.PreyMask != 0)
+		{
+			FTBAdjacentTileArray EatableTiles;
+			Map->ForEachAdjacentTile(CurrentTile, [this, &EatableTiles, PreyMask = Rules.PreyMask](const FTBTileHandle Tile)
+			{
+				const int32 Occupant = TileOccupants[Tile.GetIndex()];
+				if(Occupant != INDEX_NONE && (PreyMask & TBSpeciesBit(Species[Occupant])) != 0)
+				{
+					EatableTiles.Add(Tile);
+				}
+			});
+
+			if(EatableTiles.Num() > 0)
+			{
+				EatTarget = EatableTiles[RandomIntegerInRange(0, EatableTiles.Num() - 1)];
+			}
+		}
+	}
+
+	if(EatTarget.IsValid())
+	{
+		const int32 Victim = TileOccupants[EatTarget.GetIndex()];
+		Result.Events.Add({ ETBRoundEventType::Eat, Ids[Slot], Ids[Victim], CurrentTile, EatTarget });
+		Result.MiceEaten++;
+
+		TileOccupants[CurrentTile.GetIndex()] = INDEX_NONE;
+		if(Rules.bCanStarve)
+		{
+			StarveCounters[Slot] = 0;
+		}
+
+		static_assert(FTraits::PreyMask == 0 || FTraits::PreyMask == TBSpeciesBit(ETBMammalSpecies::Mouse), "KillMammal only removes mice");
+		KillMammal(Victim);
+		Tiles[Slot] = EatTarget;
+		TileOccupants[EatTarget.GetIndex()] = Slot;
+	}
+	else
+	{
+		FTBAdjacentTileArray EmptyTiles;
+		Map->ForEachAdjacentTile(CurrentTile, [this, &EmptyTiles](const FTBTileHandle Tile)
+		{
+			if(IsTileEmpty(Tile))
+			{
+				EmptyTiles.Add(Tile);
+			}
+		});
+
+		// blocked mammals stay, but still starve and breed
+		if(EmptyTiles.Num() > 0)
+		{
+			if(Rules.bCanEat && Rules.bCanHunt && PreyDistanceField.IsBuilt())
+			{
+				PreyDistanceField.KeepClosestTiles(CurrentTile, EmptyTiles);
+			}
+			if(!Rules.bCanEat && Rules.bCanEvade && ThreatInfluenceMap.IsBuilt())
+			{
+				ThreatInfluenceMap.KeepLeastInfluencedTiles(EmptyTiles);
+			}
+
+			const FTBTileHandle TargetTile = EmptyTiles[RandomIntegerInRange(0, EmptyTiles.Num() - 1)];
+			Result.Events.Add({ ETBRoundEventType::Move, Ids[Slot], 0, CurrentTile, TargetTile });
+
+			TileOccupants[CurrentTile.GetIndex()] = INDEX_NONE;
+			Tiles[Slot] = TargetTile;
+			TileOccupants[TargetTile.GetIndex()] = Slot;
+		}
+
+		if(Rules.bCanStarve)
+		{
+			// only species that can die of starvation are starved, the counter still runs for the others
+			if(FTraits::bCanStarve && StarveCounters[Slot] >= Rules.StarvationTurnCount)
+			{
+				MammalsToStarve.AddUnique(Slot);
+			}
+			StarveCounters[Slot]++;
+		}
+	}
+
+	if(Rules.bCanBreed)
+	{
+		if(BreedCounters[Slot] >= Rules.BreedTurnCount)
+		{
+			SavedBreedCounters[Slot]++;
+			BreedCounters[Slot] = 0;
+		}
+		else
+		{
+			BreedCounters[Slot]++;
+		}
+
+		if(SavedBreedCounters[Slot] > 0)
+		{
+			MammalsToBreed.AddUnique(Slot);
+		}
+	}
+}
+
+void FTBSimulationCore::KillMammal(const int32 Slot)
+{
+	Mice.Remove(Slot);
+	MammalsToBreed.Remove(Slot);
+	ReleaseSlot(Slot);
+}
+
+void FTBSimulationCore::TryBreedMammals(FTBRoundResult& Result)
+{
+	int32 i = 0;
+	while(i < MammalsToBreed.Num())
+	{
+		const int32 Slot = MammalsToBreed[i];
+		int32 SavedBreedCount = SavedBreedCounters[Slot];
+		if(SavedBreedCount <= 0)
+		{
+			SavedBreedCounters[Slot] = 0;
+			MammalsToBreed.RemoveAt(i);
+			continue;
+		}
+
+		FTBAdjacentTileArray EmptyTiles;
+		Map->ForEachAdjacentTile(Tiles[Slot], [this, &EmptyTiles](const FTBTileHandle Tile)
+		{
+			if(IsTileEmpty(Tile))
+			{
+				EmptyTiles.Add(Tile);
+			}
+		});
+
+		while(EmptyTiles.Num() > 0 && SavedBreedCount > 0)
+		{
+			const int32 RandomIndex = RandomIntegerInRange(0, EmptyTiles.Num() - 1);
+
+			const uint32 ChildId = AddMammal(Species[Slot], EmptyTiles[RandomIndex], 0, 0, 0);
+			Result.Events.Add({ ETBRoundEventType::Birth, ChildId, Ids[Slot], EmptyTiles[RandomIndex], EmptyTiles[RandomIndex] });
+			(Species[Slot] == ETBMammalSpecies::Cat ? Result.CatsBorn : Result.MiceBorn)++;
+
+			// children never share a tile
+			EmptyTiles.RemoveAt(RandomIndex);
+
+			SavedBreedCount--;
+			SavedBreedCounters[Slot] = SavedBreedCount;
+		}
+
+		i++;
+	}
+}
+
+void FTBSimulationCore::TryStarveMammals(FTBRoundResult& Result)
+{
+	for(int32 i = 0; i < MammalsToStarve.Num(); i++)
+	{
+		const int32 Slot = MammalsToStarve[i];
+
+		// the next mammal moves to i and is skipped until the next round, the same as the manager
+		MammalsToStarve.RemoveAt(i);
+
+		Result.Events.Add({ ETBRoundEventType::Starve, Ids[Slot], 0, Tiles[Slot], Tiles[Slot] });
+		if(Species[Slot] == ETBMammalSpecies::Cat)
+		{
+			Cats.Remove(Slot);
+			Result.CatsStarved++;
+		}
+		else
+		{
+			Mice.Remove(Slot);
+			Result.MiceStarved++;
+		}
+
+		MammalsToBreed.Remove(Slot);
+		ReleaseSlot(Slot);
+	}
+}
+
+void FTBSimulationCore::WriteSnapshot(FTBRoundResult& OutResult) const
+{
+	OutResult.Mammals.Reset();
+	OutResult.NumCats = Cats.Num();
+	OutResult.NumMice = Mice.Num();
+
+	for(const TArray<int32>* Slots : {&Cats, &Mice})
+	{
+		for(const int32 Slot : *Slots)
+		{
+			FTBMammalSnapshot& Snapshot = OutResult.Mammals.AddDefaulted_GetRef();
+			Snapshot.Id = Ids[Slot];
+			Snapshot.Species = Species[Slot];
+			Snapshot.Tile = Tiles[Slot];
+			Snapshot.StarveCounter = StarveCounters[Slot];
+			Snapshot.BreedCounter = BreedCounters[Slot];
+			Snapshot.SavedBreedCounter = SavedBreedCounters[Slot];
+		}
+	}
+}
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TBSimulationThread.h"
+#include "HAL/Event.h"
+#include "HAL/RunnableThread.h"
+
+FTBSimulationThread::FTBSimulationThread(FTBSimulationCore&& InCore, const int32 InMaxQueuedResults)
+	: Core(MoveTemp(InCore))
+	, bIsRunning(false)
+	, NumStepsLeft(0)
+	, WakeEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	, ResultEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	, Thread(nullptr)
+	, MaxQueuedResults(FMath::Max(InMaxQueuedResults, 1))
+	, NumQueuedResults(0)
+	, bIsFinished(0)
+	, bIsStopRequested(0)
+	, bIsRunningRequested(false)
+{
+	Thread = FRunnableThread::Create(this, TEXT("TBSimulationThread"), 0, TPri_Normal);
+}
+
+FTBSimulationThread::~FTBSimulationThread()
+{
+	if(Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	FPlatformProcess::ReturnSynchEventToPool(ResultEvent);
+}
+
+void FTBSimulationThread::StartRounds()
+{
+	bIsRunningRequested = true;
+	EnqueueCommand({ ETBSimulationCommandType::Start });
+}
+
+void FTBSimulationThread::PauseRounds()
+{
+	bIsRunningRequested = false;
+	EnqueueCommand({ ETBSimulationCommandType::Pause });
+}
+
+void FTBSimulationThread::StepRounds(const int32 NumRounds)
+{
+	if(NumRounds <= 0) return;
+
+	EnqueueCommand({ ETBSimulationCommandType::Step, NumRounds });
+}
+
+void FTBSimulationThread::SetSettings(const FTBSimulationSettings& Settings)
+{
+	EnqueueCommand({ ETBSimulationCommandType::SetSettings, 0, Settings });
+}
+
+void FTBSimulationThread::EnqueueCommand(FTBSimulationCommand&& Command)
+{
+	Commands.Enqueue(MoveTemp(Command));
+	WakeEvent->Trigger();
+}
+
+FTBRoundResult* FTBSimulationThread::DequeueResult()
+{
+	FTBRoundResult* Result = nullptr;
+	if(!Results.Dequeue(Result)) return nullptr;
+
+	// there is room for another result now
+	FPlatformAtomics::InterlockedDecrement(&NumQueuedResults);
+	WakeEvent->Trigger();
+	return Result;
+}
+
+void FTBSimulationThread::RecycleResult(FTBRoundResult* Result)
+{
+	if(Result)
+	{
+		RecycledResults.Enqueue(Result);
+	}
+}
+
+void FTBSimulationThread::WaitForResult(const uint32 WaitTimeMs) const
+{
+	ResultEvent->Wait(WaitTimeMs);
+}
+
+uint32 FTBSimulationThread::Run()
+{
+	while(!FPlatformAtomics::AtomicRead(&bIsStopRequested))
+	{
+		FTBSimulationCommand Command;
+		while(Commands.Dequeue(Command))
+		{
+			switch(Command.Type)
+			{
+			case ETBSimulationCommandType::Start:
+				bIsRunning = true;
+				break;
+			case ETBSimulationCommandType::Pause:
+				bIsRunning = false;
+				NumStepsLeft = 0;
+				break;
+			case ETBSimulationCommandType::Step:
+				NumStepsLeft += Command.NumRounds;
+				break;
+			case ETBSimulationCommandType::SetSettings:
+				Core.SetSettings(Command.Settings);
+				break;
+			}
+		}
+
+		if(Core.GetNumCats() <= 0 || Core.GetNumMice() <= 0)
+		{
+			FPlatformAtomics::InterlockedExchange(&bIsFinished, 1);
+			ResultEvent->Trigger();
+		}
+		else if((bIsRunning || NumStepsLeft > 0) && FPlatformAtomics::AtomicRead(&NumQueuedResults) < MaxQueuedResults)
+		{
+			// results are reused, the pool only grows until it covers the queue
+			FTBRoundResult* Result = nullptr;
+			if(!RecycledResults.Dequeue(Result))
+			{
+				Result = AllocatedResults.Add_GetRef(MakeUnique<FTBRoundResult>()).Get();
+			}
+
+			// a step counts from the moment it came, running rounds consume it too
+			Core.StepRound(*Result);
+			NumStepsLeft = FMath::Max(NumStepsLeft - 1, 0);
+
+			Results.Enqueue(Result);
+			FPlatformAtomics::InterlockedIncrement(&NumQueuedResults);
+			ResultEvent->Trigger();
+			continue;
+		}
+
+		// nothing to do until a command comes or a result is taken
+		WakeEvent->Wait();
+	}
+
+	return 0;
+}
+
+void FTBSimulationThread::Stop()
+{
+	FPlatformAtomics::InterlockedExchange(&bIsStopRequested, 1);
+	WakeEvent->Trigger();
+}
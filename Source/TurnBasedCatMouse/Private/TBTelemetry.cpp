@@ -0,0 +1,492 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TBTelemetry.h"
+#include "HAL/Event.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+
+static FAutoConsoleCommand ReadTelemetryCommand(
+	TEXT("TB.ReadTelemetry"),
+	TEXT("Logs a summary of a telemetry file and optionally converts it to CSV. Usage: TB.ReadTelemetry <File> [CsvFile]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if(Args.Num() <= 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TB.ReadTelemetry -> Usage: TB.ReadTelemetry <File> [CsvFile]"));
+			return;
+		}
+		FTBTelemetryReader::Summarize(Args[0], Args.Num() > 1 ? Args[1] : FString());
+	}));
+
+// Small deltas of either sign become small unsigned values, so they take a single varint byte
+static FORCEINLINE uint64 ZigZagEncode(const int64 Value) { return (static_cast<uint64>(Value) << 1) ^ static_cast<uint64>(Value >> 63); }
+static FORCEINLINE int64 ZigZagDecode(const uint64 Value) { return static_cast<int64>(Value >> 1) ^ -static_cast<int64>(Value & 1); }
+
+static void WriteVarint(TArray<uint8>& Buffer, uint64 Value)
+{
+	while(Value >= 0x80)
+	{
+		Buffer.Add(static_cast<uint8>(Value) | 0x80);
+		Value >>= 7;
+	}
+	Buffer.Add(static_cast<uint8>(Value));
+}
+
+static bool ReadVarint(const TArray<uint8>& Buffer, int32& Offset, uint64& OutValue)
+{
+	OutValue = 0;
+	for(int32 Shift = 0; Shift < 64 && Offset < Buffer.Num(); Shift += 7)
+	{
+		const uint8 Byte = Buffer[Offset++];
+		OutValue |= static_cast<uint64>(Byte & 0x7F) << Shift;
+		if((Byte & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+void FTBTelemetryBlock::AddRound(const FTBTelemetryRecord& Record)
+{
+	int32 Column = 0;
+	for(const int64 Value : {Record.Round, Record.AliveCats, Record.AliveMice, Record.CatsBorn, Record.MiceBorn, Record.CatsStarved, Record.MiceStarved, Record.MiceEaten})
+	{
+		IntColumns[Column++].Add(Value);
+	}
+	for(const uint32 Value : Record.CatDensity)
+	{
+		IntColumns[Column++].Add(Value);
+	}
+	for(const uint32 Value : Record.MouseDensity)
+	{
+		IntColumns[Column++].Add(Value);
+	}
+	check(Column == TBTelemetryNumIntColumns);
+
+	Column = 0;
+	for(const float Value : {Record.RoundMs, Record.BuildFieldsMs, Record.TurnsMs, Record.BreedMs, Record.StarveMs, Record.GarbageCollectionMs})
+	{
+		FloatColumns[Column++].Add(Value);
+	}
+	check(Column == TBTelemetryNumFloatColumns);
+
+	NumRounds++;
+}
+
+void FTBTelemetryBlock::GetRound(const int32 RowIndex, FTBTelemetryRecord& OutRecord) const
+{
+	int32 Column = 0;
+	for(int32* Value : {&OutRecord.Round, &OutRecord.AliveCats, &OutRecord.AliveMice, &OutRecord.CatsBorn, &OutRecord.MiceBorn, &OutRecord.CatsStarved, &OutRecord.MiceStarved, &OutRecord.MiceEaten})
+	{
+		*Value = static_cast<int32>(IntColumns[Column++][RowIndex]);
+	}
+	for(uint32& Value : OutRecord.CatDensity)
+	{
+		Value = static_cast<uint32>(IntColumns[Column++][RowIndex]);
+	}
+	for(uint32& Value : OutRecord.MouseDensity)
+	{
+		Value = static_cast<uint32>(IntColumns[Column++][RowIndex]);
+	}
+
+	Column = 0;
+	for(float* Value : {&OutRecord.RoundMs, &OutRecord.BuildFieldsMs, &OutRecord.TurnsMs, &OutRecord.BreedMs, &OutRecord.StarveMs, &OutRecord.GarbageCollectionMs})
+	{
+		*Value = FloatColumns[Column++][RowIndex];
+	}
+}
+
+void FTBTelemetryBlock::Reset()
+{
+	NumRounds = 0;
+	for(TArray<int64>& Column : IntColumns)
+	{
+		Column.Reset();
+	}
+	for(TArray<float>& Column : FloatColumns)
+	{
+		Column.Reset();
+	}
+}
+
+void FTBTelemetryBlock::Reserve(const int32 NumRoundsToReserve)
+{
+	for(TArray<int64>& Column : IntColumns)
+	{
+		Column.Reserve(NumRoundsToReserve);
+	}
+	for(TArray<float>& Column : FloatColumns)
+	{
+		Column.Reserve(NumRoundsToReserve);
+	}
+}
+
+void FTBTelemetryBlock::GetColumnNames(TArray<FString>& OutIntColumnNames, TArray<FString>& OutFloatColumnNames)
+{
+	OutIntColumnNames = { TEXT("Round"), TEXT("AliveCats"), TEXT("AliveMice"), TEXT("CatsBorn"), TEXT("MiceBorn"), TEXT("CatsStarved"), TEXT("MiceStarved"), TEXT("MiceEaten") };
+	for(int32 Bin = 0; Bin < TBTelemetryDensityBins; Bin++)
+	{
+		OutIntColumnNames.Add(FString::Printf(TEXT("CatDensity%02d"), Bin));
+	}
+	for(int32 Bin = 0; Bin < TBTelemetryDensityBins; Bin++)
+	{
+		OutIntColumnNames.Add(FString::Printf(TEXT("MouseDensity%02d"), Bin));
+	}
+	OutFloatColumnNames = { TEXT("RoundMs"), TEXT("BuildFieldsMs"), TEXT("TurnsMs"), TEXT("BreedMs"), TEXT("StarveMs"), TEXT("GarbageCollectionMs") };
+}
+
+FTBTelemetryWriter::FTBTelemetryWriter(const FString& InFilePath, const int32 InRoundsPerBlock, const int32 InMaxBlocks)
+	: FilePath(InFilePath)
+	, CurrentBlock(nullptr)
+	, WakeEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	, Thread(nullptr)
+	, RoundsPerBlock(FMath::Max(InRoundsPerBlock, 1))
+	, MaxBlocks(FMath::Max(InMaxBlocks, 2))
+	, NumDroppedRounds(0)
+	, bIsStopRequested(0)
+{
+	FileWriter.Reset(IFileManager::Get().CreateFileWriter(*FilePath));
+	if(!FileWriter)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FTBTelemetryWriter::FTBTelemetryWriter -> Can't create %s, telemetry is not recorded!"), *FilePath);
+		return;
+	}
+
+	// the header names the columns, so the reader doesn't depend on the record struct of this build
+	uint32 Magic = FileMagic;
+	uint32 Version = FileVersion;
+	TArray<FString> IntColumnNames;
+	TArray<FString> FloatColumnNames;
+	FTBTelemetryBlock::GetColumnNames(IntColumnNames, FloatColumnNames);
+	*FileWriter << Magic << Version << IntColumnNames << FloatColumnNames;
+
+	Thread = FRunnableThread::Create(this, TEXT("TBTelemetryWriter"), 0, TPri_BelowNormal);
+}
+
+FTBTelemetryWriter::~FTBTelemetryWriter()
+{
+	if(Thread)
+	{
+		// the last block is queued before the stop request, and the thread drains the queue once more after it reads the request
+		Flush();
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if(FileWriter)
+	{
+		FileWriter->Close();
+	}
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+
+	if(NumDroppedRounds > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTBTelemetryWriter::~FTBTelemetryWriter -> %lld rounds were dropped from %s, the writer could not keep up"), NumDroppedRounds, *FilePath);
+	}
+}
+
+void FTBTelemetryWriter::AddRound(const FTBTelemetryRecord& Record)
+{
+	if(!IsOpen()) return;
+
+	if(!CurrentBlock)
+	{
+		CurrentBlock = AcquireBlock();
+		if(!CurrentBlock)
+		{
+			if(NumDroppedRounds++ == 0)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("FTBTelemetryWriter::AddRound -> Writer is %d blocks behind, dropping rounds!"), MaxBlocks);
+			}
+			return;
+		}
+	}
+
+	CurrentBlock->AddRound(Record);
+	if(CurrentBlock->NumRounds >= RoundsPerBlock)
+	{
+		Flush();
+	}
+}
+
+void FTBTelemetryWriter::Flush()
+{
+	if(!CurrentBlock || CurrentBlock->NumRounds <= 0) return;
+
+	FullBlocks.Enqueue(CurrentBlock);
+	CurrentBlock = nullptr;
+	WakeEvent->Trigger();
+}
+
+FTBTelemetryBlock* FTBTelemetryWriter::AcquireBlock()
+{
+	FTBTelemetryBlock* Block = nullptr;
+	if(RecycledBlocks.Dequeue(Block))
+	{
+		return Block;
+	}
+	if(AllocatedBlocks.Num() >= MaxBlocks)
+	{
+		return nullptr;
+	}
+
+	// columns are reserved once, a recycled block never reallocates
+	Block = AllocatedBlocks.Add_GetRef(MakeUnique<FTBTelemetryBlock>()).Get();
+	Block->Reserve(RoundsPerBlock);
+	return Block;
+}
+
+uint32 FTBTelemetryWriter::Run()
+{
+	while(true)
+	{
+		// the flag is read before draining, so every block queued before the stop request is written
+		const bool bStopRequested = FPlatformAtomics::AtomicRead(&bIsStopRequested) != 0;
+
+		FTBTelemetryBlock* Block = nullptr;
+		while(FullBlocks.Dequeue(Block))
+		{
+			WriteBlock(*Block);
+			Block->Reset();
+			RecycledBlocks.Enqueue(Block);
+		}
+
+		if(bStopRequested) break;
+
+		// nothing to write until the game thread hands over a block
+		WakeEvent->Wait();
+	}
+
+	return 0;
+}
+
+void FTBTelemetryWriter::Stop()
+{
+	FPlatformAtomics::InterlockedExchange(&bIsStopRequested, 1);
+	WakeEvent->Trigger();
+}
+
+void FTBTelemetryWriter::WriteBlock(const FTBTelemetryBlock& Block)
+{
+	// columns are encoded into one buffer and written with a single call
+	EncodeBuffer.Reset();
+	for(const TArray<int64>& Column : Block.IntColumns)
+	{
+		int64 Previous = 0;
+		for(const int64 Value : Column)
+		{
+			WriteVarint(EncodeBuffer, ZigZagEncode(Value - Previous));
+			Previous = Value;
+		}
+	}
+	for(const TArray<float>& Column : Block.FloatColumns)
+	{
+		const int32 Offset = EncodeBuffer.AddUninitialized(Column.Num() * sizeof(float));
+		FMemory::Memcpy(&EncodeBuffer[Offset], Column.GetData(), Column.Num() * sizeof(float));
+	}
+
+	uint32 Magic = BlockMagic;
+	int32 NumRounds = Block.NumRounds;
+	int32 PayloadBytes = EncodeBuffer.Num();
+	*FileWriter << Magic << NumRounds << PayloadBytes;
+	FileWriter->Serialize(EncodeBuffer.GetData(), EncodeBuffer.Num());
+
+	// a crash loses at most the blocks that were not handed over yet
+	FileWriter->Flush();
+}
+
+bool FTBTelemetryReader::Open(const FString& FilePath)
+{
+	FileReader.Reset(IFileManager::Get().CreateFileReader(*FilePath));
+	if(!FileReader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FTBTelemetryReader::Open -> Can't open %s!"), *FilePath);
+		return false;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	*FileReader << Magic << Version;
+	if(Magic != FTBTelemetryWriter::FileMagic || Version != FTBTelemetryWriter::FileVersion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FTBTelemetryReader::Open -> %s is not a telemetry file of version %u!"), *FilePath, FTBTelemetryWriter::FileVersion);
+		FileReader.Reset();
+		return false;
+	}
+
+	*FileReader << IntColumnNames << FloatColumnNames;
+	if(FileReader->IsError() || IntColumnNames.Num() != TBTelemetryNumIntColumns || FloatColumnNames.Num() != TBTelemetryNumFloatColumns)
+	{
+		UE_LOG(LogTemp, Error, TEXT("FTBTelemetryReader::Open -> %s has %d integer and %d float columns, expected %d and %d!"), *FilePath,
+			IntColumnNames.Num(), FloatColumnNames.Num(), TBTelemetryNumIntColumns, TBTelemetryNumFloatColumns);
+		FileReader.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool FTBTelemetryReader::ReadNextBlock(FTBTelemetryBlock& OutBlock)
+{
+	OutBlock.Reset();
+	if(!FileReader || FileReader->AtEnd()) return false;
+
+	uint32 Magic = 0;
+	int32 NumRounds = 0;
+	int32 PayloadBytes = 0;
+	*FileReader << Magic << NumRounds << PayloadBytes;
+	if(FileReader->IsError() || Magic != FTBTelemetryWriter::BlockMagic || NumRounds <= 0 || PayloadBytes < 0
+		|| PayloadBytes > FileReader->TotalSize() - FileReader->Tell())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTBTelemetryReader::ReadNextBlock -> Truncated or broken block at offset %lld, stopping there"), FileReader->Tell());
+		return false;
+	}
+
+	DecodeBuffer.SetNumUninitialized(PayloadBytes, false);
+	FileReader->Serialize(DecodeBuffer.GetData(), PayloadBytes);
+
+	OutBlock.Reserve(NumRounds);
+	int32 Offset = 0;
+	for(TArray<int64>& Column : OutBlock.IntColumns)
+	{
+		int64 Previous = 0;
+		for(int32 Row = 0; Row < NumRounds; Row++)
+		{
+			uint64 Encoded;
+			if(!ReadVarint(DecodeBuffer, Offset, Encoded)) return false;
+
+			Previous += ZigZagDecode(Encoded);
+			Column.Add(Previous);
+		}
+	}
+	for(TArray<float>& Column : OutBlock.FloatColumns)
+	{
+		if(Offset + NumRounds * static_cast<int32>(sizeof(float)) > DecodeBuffer.Num()) return false;
+
+		Column.SetNumUninitialized(NumRounds);
+		FMemory::Memcpy(Column.GetData(), &DecodeBuffer[Offset], NumRounds * sizeof(float));
+		Offset += NumRounds * sizeof(float);
+	}
+
+	OutBlock.NumRounds = NumRounds;
+	return true;
+}
+
+bool FTBTelemetryReader::Summarize(const FString& FilePath, const FString& CsvFilePath)
+{
+	FTBTelemetryReader Reader;
+	if(!Reader.Open(FilePath)) return false;
+
+	TUniquePtr<FArchive> CsvWriter;
+	if(!CsvFilePath.IsEmpty())
+	{
+		CsvWriter.Reset(IFileManager::Get().CreateFileWriter(*CsvFilePath));
+		if(!CsvWriter)
+		{
+			UE_LOG(LogTemp, Error, TEXT("FTBTelemetryReader::Summarize -> Can't create %s!"), *CsvFilePath);
+			return false;
+		}
+	}
+
+	// CSV text is built per block and written in one call
+	FString CsvText;
+	const auto WriteCsvText = [&CsvWriter, &CsvText]()
+	{
+		const FTCHARToUTF8 Utf8(*CsvText);
+		CsvWriter->Serialize(const_cast<void*>(static_cast<const void*>(Utf8.Get())), Utf8.Length());
+		CsvText.Reset();
+	};
+	if(CsvWriter)
+	{
+		CsvText = FString::Join(Reader.GetIntColumnNames(), TEXT(",")) + TEXT(",") + FString::Join(Reader.GetFloatColumnNames(), TEXT(",")) + TEXT("\n");
+		WriteCsvText();
+	}
+
+	int64 NumRounds = 0;
+	int64 NumMissingRounds = 0;
+	FTBTelemetryRecord First;
+	FTBTelemetryRecord Last;
+	int32 MinCats = MAX_int32;
+	int32 MaxCats = 0;
+	int32 MinMice = MAX_int32;
+	int32 MaxMice = 0;
+	double RoundMsSum = 0;
+	double TurnsMsSum = 0;
+	double BreedMsSum = 0;
+	double StarveMsSum = 0;
+	double GarbageCollectionMsSum = 0;
+	float MaxRoundMs = 0;
+	float MaxGarbageCollectionMs = 0;
+
+	FTBTelemetryBlock Block;
+	FTBTelemetryRecord Record;
+	while(Reader.ReadNextBlock(Block))
+	{
+		for(int32 Row = 0; Row < Block.NumRounds; Row++)
+		{
+			Block.GetRound(Row, Record);
+			if(NumRounds == 0)
+			{
+				First = Record;
+			}
+			else if(Record.Round > Last.Round + 1)
+			{
+				// dropped by a writer that fell behind
+				NumMissingRounds += Record.Round - Last.Round - 1;
+			}
+			Last = Record;
+			NumRounds++;
+
+			MinCats = FMath::Min(MinCats, Record.AliveCats);
+			MaxCats = FMath::Max(MaxCats, Record.AliveCats);
+			MinMice = FMath::Min(MinMice, Record.AliveMice);
+			MaxMice = FMath::Max(MaxMice, Record.AliveMice);
+			RoundMsSum += Record.RoundMs;
+			TurnsMsSum += Record.TurnsMs;
+			BreedMsSum += Record.BreedMs;
+			StarveMsSum += Record.StarveMs;
+			MaxRoundMs = FMath::Max(MaxRoundMs, Record.RoundMs);
+			GarbageCollectionMsSum += Record.GarbageCollectionMs;
+			MaxGarbageCollectionMs = FMath::Max(MaxGarbageCollectionMs, Record.GarbageCollectionMs);
+
+			if(CsvWriter)
+			{
+				for(const TArray<int64>& Column : Block.IntColumns)
+				{
+					CsvText.Appendf(TEXT("%lld,"), Column[Row]);
+				}
+				for(int32 Column = 0; Column < TBTelemetryNumFloatColumns; Column++)
+				{
+					CsvText.Appendf(Column + 1 < TBTelemetryNumFloatColumns ? TEXT("%.4f,") : TEXT("%.4f\n"), Block.FloatColumns[Column][Row]);
+				}
+			}
+		}
+
+		if(CsvWriter)
+		{
+			WriteCsvText();
+		}
+	}
+
+	if(CsvWriter)
+	{
+		CsvWriter->Close();
+	}
+
+	if(NumRounds <= 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("FTBTelemetryReader::Summarize -> %s has no rounds"), *FilePath);
+		return true;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("FTBTelemetryReader::Summarize -> %s: %lld rounds (%d to %d, %lld missing)"),
+		*FilePath, NumRounds, First.Round, Last.Round, NumMissingRounds);
+	UE_LOG(LogTemp, Display, TEXT("FTBTelemetryReader::Summarize -> Cats %d to %d, %d..%d. Mice %d to %d, %d..%d"),
+		First.AliveCats, Last.AliveCats, MinCats, MaxCats, First.AliveMice, Last.AliveMice, MinMice, MaxMice);
+	UE_LOG(LogTemp, Display, TEXT("FTBTelemetryReader::Summarize -> Average round %.3f ms (max %.3f ms): turns %.3f ms, breed %.3f ms, starve %.3f ms"),
+		RoundMsSum / NumRounds, MaxRoundMs, TurnsMsSum / NumRounds, BreedMsSum / NumRounds, StarveMsSum / NumRounds);
+	UE_LOG(LogTemp, Display, TEXT("FTBTelemetryReader::Summarize -> Average garbage collection %.3f ms per round (max %.3f ms)"),
+		GarbageCollectionMsSum / NumRounds, MaxGarbageCollectionMs);
+	return true;
+}
@@ -4,14 +4,90 @@
 #include "TBTurnedBasedManager.h"
 #include "SquareMapGeneration/TBSquareMapGenerator.h"
 #include "Mammals/TBMammalBase.h"
+#include "Mammals/TBMammalCluster.h"
+#include "Mammals/TBSpeciesTraits.h"
+#include "SquareMapGeneration/TBMorton.h"
+#include "SquareMapGeneration/TBDebugOverlayComponent.h"
+#include "SquareMapGeneration/TBTileHeatmapComponent.h"
+#include "Algo/Sort.h"
 #include "Async/Async.h"
+#include "EngineUtils.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include "UObject/UObjectGlobals.h"
+#include "TBProfiler.h"
+#include "TBStats.h"
+
+DEFINE_STAT(STAT_TBTileChunkMemory);
+DEFINE_STAT(STAT_TBBlockSummaryMemory);
+DEFINE_STAT(STAT_TBTileMeshMemory);
+DEFINE_STAT(STAT_TBTileHeatmapMemory);
+DEFINE_STAT(STAT_TBMammalActorMemory);
+DEFINE_STAT(STAT_TBMammalBookkeepingMemory);
+DEFINE_STAT(STAT_TBRoundArenaMemory);
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkMammalOrderingCommand(
+	TEXT("TB.BenchmarkMammalOrdering"),
+	TEXT("Runs headless rounds with spawn order and Z-order mammal processing and logs the round times. Usage: TB.BenchmarkMammalOrdering [Rounds] [Seed]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int Rounds = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		const int Seed = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0;
+		for(TActorIterator<ATBTurnedBasedManager> It(World); It; ++It)
+		{
+			It->BenchmarkMammalOrdering(Rounds, Seed);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs RewindRoundsCommand(
+	TEXT("TB.RewindRounds"),
+	TEXT("Steps the game back using the round history and reseeds the random sequence if a seed is given. Usage: TB.RewindRounds [Rounds] [Seed]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int Rounds = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1;
+		const int Seed = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : -1;
+		for(TActorIterator<ATBTurnedBasedManager> It(World); It; ++It)
+		{
+			It->RewindRounds(Rounds, Seed);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs ProfileCommand(
+	TEXT("TB.Profile"),
+	TEXT("Plays the profiling scenarios, writes the per scope timings and compares them with the baseline. Usage: TB.Profile [BaselinePath] [Threshold] [CaptureTrace]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const FString BaselinePath = Args.Num() > 0 ? Args[0] : FString();
+		const float Threshold = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 0.1f;
+		const bool bCaptureTrace = Args.Num() > 2 && FCString::ToBool(*Args[2]);
+		for(TActorIterator<ATBTurnedBasedManager> It(World); It; ++It)
+		{
+			It->RunProfilingScenarios(BaselinePath, Threshold, bCaptureTrace);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs MemoryReportCommand(
+	TEXT("TB.MemoryReport"),
+	TEXT("Logs the memory used by the map and the mammals by subsystem"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		for(TActorIterator<ATBTurnedBasedManager> It(World); It; ++It)
+		{
+			It->LogMemoryReport();
+		}
+	}));
 
 // Sets default values
 ATBTurnedBasedManager::ATBTurnedBasedManager()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = false;
+ 	// Tick only drives the movement system, it is enabled only while there are active moves
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
 	NumberOfCatsToSpawn = 3;
 	NumberOfMiceToSpawn= 50;
@@ -19,6 +95,63 @@ ATBTurnedBasedManager::ATBTurnedBasedManager()
 	bAutoStartNextRound = true;
 	StartNextRoundTime = 1;
 	CurrentRound = 0;
+	MammalProcessingOrder = ETBMammalProcessingOrder::SpawnOrder;
+	ZOrderSortInterval = 10;
+	bInstantMoves = false;
+	bIsDispatchingTurns = false;
+	bHasPendingTurn = false;
+	RoundStatsHistorySize = 256;
+	RoundStatsHistoryHead = 0;
+	MammalMemoryBudgetMB = 256;
+	EstimatedBytesPerMammal = 0;
+	bIsOverMammalMemoryBudget = false;
+	bHasWarnedFieldMapSize = false;
+	PipelineBookkeepingBytes = 0;
+	NumSteppedSimulationRounds = 0;
+	bIsWaitingForSimulatedRound = false;
+	bEnableCatHunting = false;
+	MaxHuntDistance = 64;
+	bEnableMouseEvasion = false;
+	ThreatRadius = 3;
+	bPipelineRounds = false;
+	bUseSimulationThread = false;
+	MaxQueuedSimulatedRounds = 4;
+	bIsPipelineActive = false;
+	bIsPresentingRound = false;
+	CurrentTurnSpecies = 0;
+	NextTurnIndex = 0;
+	FMemory::Memzero(SpeciesPreyMasks);
+	PreySpeciesMask = 0;
+	PredatorSpeciesMask = 0;
+	bExportTelemetry = false;
+	TelemetryRoundsPerBlock = 4096;
+	RoundStartCycles = 0;
+	TurnsStartCycles = 0;
+	bEnableRoundHistory = false;
+	RoundHistoryCheckpointInterval = 16;
+	MaxRewindRounds = 256;
+	MaxRoundHistoryCheckpoints = 32;
+	ProfilingRegressionThreshold = 0.1f;
+	MapSizeOverride = 0;
+	MaxPooledMammals = 4096;
+	bClusterMammalActors = true;
+	MammalPools.SetNum(TBMaxSpecies);
+	GarbageCollectionCycles = 0;
+	GarbageCollectionStartCycles = 0;
+
+	// populations grow with the map, so the per mammal scopes are measured at several scales
+	auto AddProfilingScenario = [this](const TCHAR* Name, const int32 MapSize, const int32 NumCats, const int32 NumMice, const int32 Rounds)
+	{
+		FTBProfilingScenario& Scenario = ProfilingScenarios.AddDefaulted_GetRef();
+		Scenario.Name = Name;
+		Scenario.MapSize = MapSize;
+		Scenario.NumCats = NumCats;
+		Scenario.NumMice = NumMice;
+		Scenario.Rounds = Rounds;
+	};
+	AddProfilingScenario(TEXT("Small"), 64, 8, 256, 200);
+	AddProfilingScenario(TEXT("Medium"), 256, 32, 4096, 200);
+	AddProfilingScenario(TEXT("Large"), 512, 128, 16384, 100);
 
 }
 
@@ -28,14 +161,374 @@ void ATBTurnedBasedManager::BeginPlay()
 {
 	Super::BeginPlay();
 
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &ATBTurnedBasedManager::OnPreGarbageCollect);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &ATBTurnedBasedManager::OnPostGarbageCollect);
+
+	// scripted profiling runs play the scenarios and quit, the exit code tells if a scope regressed
+	if(FParse::Param(FCommandLine::Get(), TEXT("TBProfile")))
+	{
+		FString BaselinePath;
+		FParse::Value(FCommandLine::Get(), TEXT("TBProfileBaseline="), BaselinePath);
+		float Threshold = ProfilingRegressionThreshold;
+		FParse::Value(FCommandLine::Get(), TEXT("TBProfileThreshold="), Threshold);
+
+		const bool bPassed = RunProfilingScenarios(BaselinePath, Threshold, FParse::Param(FCommandLine::Get(), TEXT("TBProfileTrace")));
+		FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+		return;
+	}
+
 	StartTurnBasedGame();
 }
 
+void ATBTurnedBasedManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// the worker reads the map, it has to finish before the map goes away
+	StopRoundPipeline();
+	StopTelemetry();
+	RoundHistory.Reset();
+
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void ATBTurnedBasedManager::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	MovementSystem.Tick(DeltaTime);
+
+	// nothing left to interpolate, stop ticking until the next move is requested
+	if(!MovementSystem.HasActiveMoves())
+	{
+		SetActorTickEnabled(false);
+
+		// a presented round is over once every move arrived
+		if(bIsPresentingRound)
+		{
+			bIsPresentingRound = false;
+			OnRoundFinished();
+		}
+	}
+}
+
+void ATBTurnedBasedManager::RequestMammalMove(ATBMammalBase* Mammal, const FVector& TargetLocation)
+{
+	if(bInstantMoves)
+	{
+		MovementSystem.FinishMoveInstantly(Mammal, TargetLocation);
+		return;
+	}
+
+	MovementSystem.AddMove(Mammal, TargetLocation, Mammal->MoveInterpSpeed);
+	SetActorTickEnabled(true);
+}
+
+void ATBTurnedBasedManager::SortMammalsByZOrder(TArray<ATBMammalBase*>& Mammals) const
+{
+	TArray<TPair<uint32, ATBMammalBase*>> SortKeys;
+	SortKeys.Reserve(Mammals.Num());
+	for(ATBMammalBase* Mammal : Mammals)
+	{
+		const FIntPoint Coordinates = SquareMapGeneratorRef->GetTileCoordinates(Mammal->GetCurrentTile());
+		SortKeys.Emplace(FTBMorton::Encode(Coordinates.X, Coordinates.Y), Mammal);
+	}
+
+	// each tile holds one mammal, so the keys are unique and the order is deterministic
+	Algo::SortBy(SortKeys, &TPair<uint32, ATBMammalBase*>::Key);
+
+	for(int i = 0; i < SortKeys.Num(); i++)
+	{
+		Mammals[i] = SortKeys[i].Value;
+	}
+}
+
+void ATBTurnedBasedManager::ResetTurnBasedGame()
+{
+	GetWorldTimerManager().ClearTimer(TimerHandle_StartNextRound);
+	StopRoundPipeline();
+	StopTelemetry();
+	RoundHistory.Reset();
+	MovementSystem.Reset();
+	RoundArena.Reset();
+
+	ForEachMammal([](ATBMammalBase* Mammal)
+	{
+		Mammal->Destroy();
+	});
+
+	// the next game can have other species and classes
+	for(FTBMammalPool& Pool : MammalPools)
+	{
+		for(ATBMammalBase* Mammal : Pool.Mammals)
+		{
+			if(Mammal)
+			{
+				Mammal->Destroy();
+			}
+		}
+		Pool.Mammals.Reset();
+	}
+
+	// the destroyed actors dissolve the cluster at the next collection, the next game starts its own
+	MammalCluster = nullptr;
+
+	Cats.Reset();
+	Mice.Reset();
+	for(TArray<ATBMammalBase*>& Mammals : OtherSpeciesMammals)
+	{
+		Mammals.Reset();
+	}
+	AllMammalsToBreed.Reset();
+	MammalsToStarve.Reset();
+	MammalSlots.Reset();
+	FreeMammalSlots.Reset();
+
+	if(SquareMapGeneratorRef)
+	{
+		SquareMapGeneratorRef->Destroy();
+		SquareMapGeneratorRef = nullptr;
+	}
+
+	CurrentRound = 0;
+	bIsRoundOngoing = false;
+	CurrentTurnSpecies = 0;
+	NextTurnIndex = 0;
+	bHasWarnedFieldMapSize = false;
+
+	// the next game builds its own food web
+	FMemory::Memzero(SpeciesPreyMasks);
+	PreySpeciesMask = 0;
+	PredatorSpeciesMask = 0;
+
+	CurrentRoundStats = FTBRoundStats();
+	RoundStatsHistory.Reset();
+	RoundStatsHistoryHead = 0;
+}
+
+void ATBTurnedBasedManager::BenchmarkMammalOrdering(const int Rounds, const int Seed)
+{
+	// rounds have to run synchronously to be timed
+	const ETBMammalProcessingOrder SavedProcessingOrder = MammalProcessingOrder;
+	const bool bSavedInstantMoves = bInstantMoves;
+	const bool bSavedAutoStartNextRound = bAutoStartNextRound;
+	const bool bSavedUseSimulationThread = bUseSimulationThread;
+	bInstantMoves = true;
+	bAutoStartNextRound = false;
+	bUseSimulationThread = false;
+
+	for(const ETBMammalProcessingOrder ProcessingOrder : {ETBMammalProcessingOrder::SpawnOrder, ETBMammalProcessingOrder::ZOrder})
+	{
+		// same seed and same starting board for both orderings
+		MammalProcessingOrder = ProcessingOrder;
+		ResetTurnBasedGame();
+		FMath::RandInit(Seed);
+		StartTurnBasedGame();
+
+		int PlayedRounds = 0;
+		const double StartTime = FPlatformTime::Seconds();
+		while(PlayedRounds < Rounds && Cats.Num() > 0 && Mice.Num() > 0)
+		{
+			StartNextRound();
+			PlayedRounds++;
+		}
+		const double TotalMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::BenchmarkMammalOrdering -> %s: %d rounds in %.2f ms, %.3f ms per round, %d cats and %d mice left"),
+			*UEnum::GetValueAsString(ProcessingOrder), PlayedRounds, TotalMs, PlayedRounds > 0 ? TotalMs / PlayedRounds : 0.0, Cats.Num(), Mice.Num());
+	}
+
+	// restore the settings and start a normal game again
+	MammalProcessingOrder = SavedProcessingOrder;
+	bInstantMoves = bSavedInstantMoves;
+	bAutoStartNextRound = bSavedAutoStartNextRound;
+	bUseSimulationThread = bSavedUseSimulationThread;
+	ResetTurnBasedGame();
+	StartTurnBasedGame();
+}
+
+bool ATBTurnedBasedManager::RunProfilingScenarios(const FString& BaselinePath, const float RegressionThreshold, const bool bCaptureTrace)
+{
+	// rounds have to run synchronously to be timed, and files or histories would only add noise
+	const bool bSavedUseSimulationThread = bUseSimulationThread;
+	const int SavedNumberOfCatsToSpawn = NumberOfCatsToSpawn;
+	const int SavedNumberOfMiceToSpawn = NumberOfMiceToSpawn;
+	const TArray<FTBSpeciesDefinition> SavedSpeciesTable = SpeciesTable;
+	const bool bSavedInstantMoves = bInstantMoves;
+	const bool bSavedAutoStartNextRound = bAutoStartNextRound;
+	const bool bSavedExportTelemetry = bExportTelemetry;
+	const bool bSavedEnableRoundHistory = bEnableRoundHistory;
+	bInstantMoves = true;
+	bAutoStartNextRound = false;
+	bUseSimulationThread = false;
+	bExportTelemetry = false;
+	bEnableRoundHistory = false;
+
+	const FString ProfilingDirectory = FPaths::ProjectSavedDir() / TEXT("Profiling");
+	const FString Timestamp = FDateTime::Now().ToString();
+	if(bCaptureTrace)
+	{
+		const FString TracePath = ProfilingDirectory / FString::Printf(TEXT("TBProfile_%s.utrace"), *Timestamp);
+		GEngine->Exec(GetWorld(), *FString::Printf(TEXT("Trace.File \"%s\" cpu,bookmark"), *TracePath));
+		UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::RunProfilingScenarios -> Capturing trace to %s"), *TracePath);
+	}
+
+	FTBProfiler Profiler;
+	TArray<FTBProfileSummaryRow> Rows;
+	for(const FTBProfilingScenario& Scenario : ProfilingScenarios)
+	{
+		TRACE_BOOKMARK(TEXT("TB Scenario %s"), *Scenario.Name);
+
+		NumberOfCatsToSpawn = Scenario.NumCats;
+		NumberOfMiceToSpawn = Scenario.NumMice;
+		if(SpeciesTable.Num() >= 2)
+		{
+			SpeciesTable[0].NumberToSpawn = Scenario.NumCats;
+			SpeciesTable[1].NumberToSpawn = Scenario.NumMice;
+		}
+		MapSizeOverride = Scenario.MapSize;
+		ResetTurnBasedGame();
+		FMath::RandInit(Scenario.Seed);
+
+		// generation and spawning are the first sample, every round is one more
+		Profiler.Begin();
+		StartTurnBasedGame();
+		Profiler.EndSample();
+
+		int PlayedRounds = 0;
+		while(PlayedRounds < Scenario.Rounds && Cats.Num() > 0 && Mice.Num() > 0)
+		{
+			StartNextRound();
+			Profiler.EndSample();
+			PlayedRounds++;
+		}
+		Profiler.End();
+
+		const int32 FirstRow = Rows.Num();
+		Profiler.GetSummary(Scenario.Name, Rows);
+
+		UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::RunProfilingScenarios -> %s: map %dx%d, %d rounds, %d cats and %d mice left"),
+			*Scenario.Name, Scenario.MapSize, Scenario.MapSize, PlayedRounds, Cats.Num(), Mice.Num());
+		for(int32 RowIndex = FirstRow; RowIndex < Rows.Num(); RowIndex++)
+		{
+			const FTBProfileSummaryRow& Row = Rows[RowIndex];
+			UE_LOG(LogTemp, Display, TEXT("    %-12s %8lld calls, total %10.2f ms, p50 %8.3f ms, p90 %8.3f ms, p99 %8.3f ms"),
+				*Row.Scope, Row.Calls, Row.TotalMs, Row.P50Ms, Row.P90Ms, Row.P99Ms);
+		}
+	}
+
+	if(bCaptureTrace)
+	{
+		GEngine->Exec(GetWorld(), TEXT("Trace.Stop"));
+	}
+
+	// restore the settings before anything can fail
+	NumberOfCatsToSpawn = SavedNumberOfCatsToSpawn;
+	NumberOfMiceToSpawn = SavedNumberOfMiceToSpawn;
+	SpeciesTable = SavedSpeciesTable;
+	bInstantMoves = bSavedInstantMoves;
+	bAutoStartNextRound = bSavedAutoStartNextRound;
+	bExportTelemetry = bSavedExportTelemetry;
+	bEnableRoundHistory = bSavedEnableRoundHistory;
+	bUseSimulationThread = bSavedUseSimulationThread;
+	MapSizeOverride = 0;
+
+	const FString SummaryPath = ProfilingDirectory / FString::Printf(TEXT("TBProfile_%s.csv"), *Timestamp);
+	if(FTBProfiler::SaveSummary(SummaryPath, Rows))
+	{
+		UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::RunProfilingScenarios -> Summary written to %s"), *SummaryPath);
+	}
+
+	// the first run on a machine becomes its baseline
+	const FString UsedBaselinePath = BaselinePath.IsEmpty() ? ProfilingDirectory / TEXT("TBProfileBaseline.csv") : BaselinePath;
+	TArray<FTBProfileSummaryRow> BaselineRows;
+	int32 NumRegressions = 0;
+	if(FTBProfiler::LoadSummary(UsedBaselinePath, BaselineRows))
+	{
+		NumRegressions = FTBProfiler::CompareToBaseline(Rows, BaselineRows, RegressionThreshold);
+		UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::RunProfilingScenarios -> %s, %d regressions above %.0f%% against %s"),
+			NumRegressions > 0 ? TEXT("Failed") : TEXT("Passed"), NumRegressions, RegressionThreshold * 100.0f, *UsedBaselinePath);
+	}
+	else if(FTBProfiler::SaveSummary(UsedBaselinePath, Rows))
+	{
+		UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::RunProfilingScenarios -> No baseline found, this run is the baseline at %s"), *UsedBaselinePath);
+	}
+
+	ResetTurnBasedGame();
+	StartTurnBasedGame();
+
+	return NumRegressions == 0;
+}
+
+bool ATBTurnedBasedManager::MatchesSimulationCore(const FTBSimulationCore& Core, const FTBRoundResult& Result, FString& OutDivergence) const
+{
+	if(Core.GetNumCats() != Cats.Num() || Core.GetNumMice() != Mice.Num())
+	{
+		OutDivergence = FString::Printf(TEXT("population is %d cats and %d mice, the core has %d cats and %d mice"), Cats.Num(), Mice.Num(), Core.GetNumCats(), Core.GetNumMice());
+		return false;
+	}
+
+	// the round stats are only compared after a round, the snapshot before the first one has none
+	if(Result.Round > 0 && (CurrentRoundStats.CatsBorn != Result.CatsBorn || CurrentRoundStats.MiceBorn != Result.MiceBorn
+		|| CurrentRoundStats.CatsStarved != Result.CatsStarved || CurrentRoundStats.MiceStarved != Result.MiceStarved || CurrentRoundStats.MiceEaten != Result.MiceEaten))
+	{
+		OutDivergence = FString::Printf(TEXT("round stats born %d/%d, starved %d/%d, eaten %d, the core has born %d/%d, starved %d/%d, eaten %d"),
+			CurrentRoundStats.CatsBorn, CurrentRoundStats.MiceBorn, CurrentRoundStats.CatsStarved, CurrentRoundStats.MiceStarved, CurrentRoundStats.MiceEaten,
+			Result.CatsBorn, Result.MiceBorn, Result.CatsStarved, Result.MiceStarved, Result.MiceEaten);
+		return false;
+	}
+
+	// same turn order on both sides, so the n-th actor is the n-th snapshot
+	TMap<const ATBMammalBase*, int32> ActorIndices;
+	TMap<uint32, int32> CoreIndices;
+	ActorIndices.Reserve(Result.Mammals.Num());
+	CoreIndices.Reserve(Result.Mammals.Num());
+	int32 Index = 0;
+	for(const TArray<ATBMammalBase*>* Mammals : {&Cats, &Mice})
+	{
+		for(const ATBMammalBase* Mammal : *Mammals)
+		{
+			const FTBMammalSnapshot& Snapshot = Result.Mammals[Index];
+			if(Mammal->Species != Snapshot.Species || Mammal->GetCurrentTile() != Snapshot.Tile || Mammal->GetStarveCounter() != Snapshot.StarveCounter
+				|| Mammal->GetBreedCounter() != Snapshot.BreedCounter || Mammal->GetSavedBreedCounter() != Snapshot.SavedBreedCounter)
+			{
+				const FIntPoint ActorCoordinates = SquareMapGeneratorRef->GetTileCoordinates(Mammal->GetCurrentTile());
+				const FIntPoint CoreCoordinates = SquareMapGeneratorRef->GetTileCoordinates(Snapshot.Tile);
+				OutDivergence = FString::Printf(TEXT("mammal %d (%s) is on %s with counters %d/%d/%d, the core's is a %s on %s with counters %d/%d/%d"), Index,
+					Mammal->Species == ETBMammalSpecies::Cat ? TEXT("cat") : TEXT("mouse"), *ActorCoordinates.ToString(), Mammal->GetStarveCounter(), Mammal->GetBreedCounter(), Mammal->GetSavedBreedCounter(),
+					Snapshot.Species == ETBMammalSpecies::Cat ? TEXT("cat") : TEXT("mouse"), *CoreCoordinates.ToString(), Snapshot.StarveCounter, Snapshot.BreedCounter, Snapshot.SavedBreedCounter);
+				return false;
+			}
+			ActorIndices.Add(Mammal, Index);
+			CoreIndices.Add(Snapshot.Id, Index);
+			Index++;
+		}
+	}
+
+	// the boards must agree on every tile, not only on the tiles of the living mammals
+	const int32 MapSize = SquareMapGeneratorRef->GetSquareMapSize();
+	for(int32 Y = 0; Y < MapSize; Y++)
+	{
+		for(int32 X = 0; X < MapSize; X++)
+		{
+			const FTBTileHandle Tile = SquareMapGeneratorRef->GetTileAt(X, Y);
+			const ATBMammalBase* Occupant = ResolveMammal(SquareMapGeneratorRef->GetTileOccupant(Tile));
+			const uint32 CoreOccupantId = Core.GetTileOccupantId(Tile);
+			const int32* ActorIndex = Occupant ? ActorIndices.Find(Occupant) : nullptr;
+			const int32* CoreIndex = CoreOccupantId != 0 ? CoreIndices.Find(CoreOccupantId) : nullptr;
+			if((ActorIndex ? *ActorIndex : INDEX_NONE) != (CoreIndex ? *CoreIndex : INDEX_NONE)
+				|| (Occupant && !ActorIndex) || (CoreOccupantId != 0 && !CoreIndex))
+			{
+				OutDivergence = FString::Printf(TEXT("tile (%d, %d) holds mammal %d, the core's holds mammal %d"), X, Y,
+					ActorIndex ? *ActorIndex : INDEX_NONE, CoreIndex ? *CoreIndex : INDEX_NONE);
+				return false;
+			}
+		}
+	}
+
+	return true;
 }
 
 void ATBTurnedBasedManager::StartTurnBasedGame()
@@ -46,6 +539,14 @@ void ATBTurnedBasedManager::StartTurnBasedGame()
 
 	// spawn map generator
 	SquareMapGeneratorRef = GetWorld()->SpawnActor<ATBSquareMapGenerator>(SquareMapGenClass, GetActorLocation(), FRotator::ZeroRotator, Params);
+	if(MapSizeOverride > 0)
+	{
+		SquareMapGeneratorRef->SquareMapSize = MapSizeOverride;
+	}
+	if(GridTopologyOverride.IsSet())
+	{
+		SquareMapGeneratorRef->GridTopology = GridTopologyOverride.GetValue();
+	}
 
 	// generate the map
 	SquareMapGeneratorRef->GenerateSquareMap();
@@ -53,6 +554,22 @@ void ATBTurnedBasedManager::StartTurnBasedGame()
 	// spawn mammals
 	InitSpawnMammals();
 
+	// the starting population is round 0 of the telemetry
+	StartTelemetry();
+
+	// the first round is simulated during the start delay
+	bIsPipelineActive = bPipelineRounds && !bInstantMoves;
+	if(bIsPipelineActive)
+	{
+		StartRoundPipeline();
+	}
+
+	// the simulation core runs ahead of the actors, so only actor games keep a history. Round 0 is recorded by OnRoundFinished.
+	if(bEnableRoundHistory && !bIsPipelineActive)
+	{
+		RoundHistory.Start(SquareMapGeneratorRef, 0, RoundHistoryCheckpointInterval, MaxRewindRounds, MaxRoundHistoryCheckpoints);
+	}
+
 	
 	OnRoundFinished();
 
@@ -68,149 +585,502 @@ void ATBTurnedBasedManager::StartTurnBasedGame()
 }
 
 
-ATBMammalBase* ATBTurnedBasedManager::SpawnMammal(TSubclassOf<ATBMammalBase> MammalClass, FTileInfo* TargetTile) const
+ATBMammalBase* ATBTurnedBasedManager::SpawnMammal(const ETBMammalSpecies Species, const FTBTileHandle TargetTile)
 {
-	if(!MammalClass || !TargetTile->bIsEmptyTile) return nullptr;
+	if(!SquareMapGeneratorRef->IsTileEmpty(TargetTile)) return nullptr;
+
+	ATBMammalBase* MammalRef = SpawnMammalActor(Species, TargetTile);
+	if(!MammalRef) return nullptr;
+
+	MammalRef->Handle = AllocateMammalHandle(MammalRef);
 
+	// update the tile
+	SquareMapGeneratorRef->SetTileOccupant(TargetTile, MammalRef->Handle, MammalRef->Species);
 	
-	FActorSpawnParameters Params;
-	Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return MammalRef;
+}
+
+ATBMammalBase* ATBTurnedBasedManager::SpawnMammalActor(const ETBMammalSpecies Species, const FTBTileHandle TargetTile)
+{
+	const TSubclassOf<ATBMammalBase> MammalClass = ActiveSpecies[static_cast<int32>(Species)].MammalClass;
+	if(!MammalClass) return nullptr;
+
+	const FVector TileLocation = SquareMapGeneratorRef->GetTileWorldLocation(TargetTile);
+
+	// a pooled actor of the species is reused before a new one is spawned
+	TArray<TObjectPtr<ATBMammalBase>>& Pool = MammalPools[static_cast<int32>(Species)].Mammals;
+	ATBMammalBase* MammalRef = nullptr;
+	while(!MammalRef && Pool.Num() > 0)
+	{
+		MammalRef = Pool.Pop(false);
+	}
+
+	if(MammalRef)
+	{
+		MammalRef->SetActorHiddenInGame(false);
+		MammalRef->SetActorEnableCollision(true);
+	}
+	else
+	{
+		FActorSpawnParameters Params;
+		Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		// Spawn the mammal at the tile's location
+		MammalRef = GetWorld()->SpawnActor<ATBMammalBase>(MammalClass, TileLocation, FRotator::ZeroRotator, Params);
 
-	// Spawn the mammal at the tile's location
-	ATBMammalBase* MammalRef = GetWorld()->SpawnActor<ATBMammalBase>(MammalClass, TargetTile->WordLocation, FRotator::ZeroRotator, Params);
+		// the map and the manager it refers to are kept by the level, so the cluster doesn't have to follow them
+		if(ShouldClusterMammalActors())
+		{
+			if(!MammalCluster)
+			{
+				MammalCluster = NewObject<UTBMammalCluster>(this);
+			}
+			MammalCluster->AddMammal(MammalRef);
+		}
+	}
 
 	// Calculate mammal bounds and adjust its position to snap it to the tile
-	MammalRef->SetActorLocation(TargetTile->WordLocation + FVector(0,0,SquareMapGeneratorRef->GetTileHalfExtents().Z));
+	MammalRef->SetActorLocation(TileLocation + FVector(0,0,SquareMapGeneratorRef->GetTileHalfExtents().Z));
 
-	// update the tile
-	TargetTile->bIsEmptyTile = false;
-	TargetTile->MammalRef = MammalRef;
-	//SquareMapGeneratorRef->UpdateTileAt(TargetTile, TargetTile.Pos2D.X, TargetTile.Pos2D.Y);
+	MammalRef->Species = Species;
+	MammalRef->PreyMask = SpeciesPreyMasks[static_cast<int32>(Species)];
 
 	// update mammal tile 
 	MammalRef->SetCurrentTile(TargetTile);
-	
-	
+
 	return MammalRef;
 }
 
-void ATBTurnedBasedManager::InitSpawnMammals()
+void ATBTurnedBasedManager::AddSpawnedMammal(ATBMammalBase* Mammal)
 {
-	//spawn cats
-	for(int i= 0 ; i < NumberOfCatsToSpawn; i++)
+	// starving follows the class and the species traits like in the simulation core, even for a species without prey. Only prey can be killed.
+	const uint8 SpeciesBit = TBSpeciesBit(Mammal->Species);
+	if(Mammal->bCanStarve && TBCanSpeciesStarve(Mammal->Species))
 	{
-		
-		if(FTileInfo* TileResult = SquareMapGeneratorRef->GetRandomEmptyTile())
-		{
-			ATBMammalBase* SpawnedCat = SpawnMammal(CatClass, TileResult);
-			SpawnedCat->OnStarved.AddDynamic(this, &ATBTurnedBasedManager::OnStarved);
-			SpawnedCat->OnBred.AddDynamic(this, &ATBTurnedBasedManager::OnBred);
-			SpawnedCat->MapGeneratorRef = SquareMapGeneratorRef;
-			SpawnedCat->UpdateDebugWidget(SquareMapGeneratorRef->ShowDebug);
-			Cats.Add(SpawnedCat);
-		}
-		else
+		Mammal->OnStarved.AddDynamic(this, &ATBTurnedBasedManager::OnStarved);
+	}
+	if(PreySpeciesMask & SpeciesBit)
+	{
+		Mammal->OnKilled.AddDynamic(this, &ATBTurnedBasedManager::OnKillRequested);
+	}
+	Mammal->OnBred.AddDynamic(this, &ATBTurnedBasedManager::OnBred);
+	Mammal->MapGeneratorRef = SquareMapGeneratorRef;
+	Mammal->TurnBasedManagerRef = this;
+	Mammal->UpdateDebugWidget(SquareMapGeneratorRef->ShowDebug && SquareMapGeneratorRef->bUsePerMammalDebugWidgets);
+	GetMammalsOfSpecies(Mammal->Species).Add(Mammal);
+}
+
+void ATBTurnedBasedManager::BuildSpeciesTable()
+{
+	ActiveSpecies = SpeciesTable;
+	if(ActiveSpecies.Num() <= 0)
+	{
+		// the original two species game, each class eats the species of its EatableMammalClass
+		const TSubclassOf<ATBMammalBase> Classes[] = { CatClass, MouseClass };
+		const int32 SpawnCounts[] = { NumberOfCatsToSpawn, NumberOfMiceToSpawn };
+		for(int32 SpeciesIndex = 0; SpeciesIndex < 2; SpeciesIndex++)
 		{
-			break; // if cant find any empty tile exit the loop
+			FTBSpeciesDefinition& Definition = ActiveSpecies.AddDefaulted_GetRef();
+			Definition.MammalClass = Classes[SpeciesIndex];
+			Definition.NumberToSpawn = SpawnCounts[SpeciesIndex];
+
+			const ATBMammalBase* Defaults = Classes[SpeciesIndex] ? Classes[SpeciesIndex].GetDefaultObject() : nullptr;
+			if(!Defaults || !Defaults->EatableMammalClass) continue;
+
+			for(int32 PreyIndex = 0; PreyIndex < 2; PreyIndex++)
+			{
+				if(Defaults->EatableMammalClass == Classes[PreyIndex])
+				{
+					Definition.PreySpecies.Add(PreyIndex);
+					break;
+				}
+			}
 		}
-		
 	}
-	
-	//spawn mice
-	for(int i= 0 ; i < NumberOfMiceToSpawn; i++)
+
+	if(ActiveSpecies.Num() > TBMaxSpecies)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::BuildSpeciesTable -> Species table has %d rows, only the first %d are played!"), ActiveSpecies.Num(), TBMaxSpecies);
+		ActiveSpecies.SetNum(TBMaxSpecies);
+	}
+
+	FMemory::Memzero(SpeciesPreyMasks);
+	PreySpeciesMask = 0;
+	PredatorSpeciesMask = 0;
+	for(int32 SpeciesIndex = 0; SpeciesIndex < ActiveSpecies.Num(); SpeciesIndex++)
 	{
-		if(FTileInfo* TileResult = SquareMapGeneratorRef->GetRandomEmptyTile())
+		for(const int32 PreyIndex : ActiveSpecies[SpeciesIndex].PreySpecies)
 		{
-			ATBMammalBase* SpawnedMouse = SpawnMammal(MouseClass, TileResult);
-			SpawnedMouse->OnKilled.AddDynamic(this, &ATBTurnedBasedManager::OnKillRequested);
-			SpawnedMouse->OnBred.AddDynamic(this, &ATBTurnedBasedManager::OnBred);
-			SpawnedMouse->MapGeneratorRef = SquareMapGeneratorRef;
-			SpawnedMouse->UpdateDebugWidget(SquareMapGeneratorRef->ShowDebug);
-			Mice.Add(SpawnedMouse);
+			if(!ActiveSpecies.IsValidIndex(PreyIndex))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::BuildSpeciesTable -> Species %d eats species %d, which is not in the table!"), SpeciesIndex, PreyIndex);
+				continue;
+			}
+			SpeciesPreyMasks[SpeciesIndex] |= TBSpeciesBit(static_cast<ETBMammalSpecies>(PreyIndex));
 		}
-		else
+
+		if(SpeciesPreyMasks[SpeciesIndex] != 0)
 		{
-			break; // if cant find any empty tile exit the loop
+			PredatorSpeciesMask |= TBSpeciesBit(static_cast<ETBMammalSpecies>(SpeciesIndex));
+			PreySpeciesMask |= SpeciesPreyMasks[SpeciesIndex];
 		}
 	}
+}
 
+bool ATBTurnedBasedManager::IsBuiltInFoodWeb() const
+{
+	// a cat without prey isn't a threat to the mice of the actor rules, so the masks have to match exactly
+	return GetNumSpecies() == 2
+		&& SpeciesPreyMasks[0] == TBGetSpeciesPreyMask(ETBMammalSpecies::Cat)
+		&& SpeciesPreyMasks[1] == TBGetSpeciesPreyMask(ETBMammalSpecies::Mouse);
 }
 
-void ATBTurnedBasedManager::StartNextRound()
+int32 ATBTurnedBasedManager::GetNumMammals() const
 {
-	if(bIsRoundOngoing) return;
-	
-	if(Cats.Num() <= 0)
+	int32 NumMammals = 0;
+	for(int32 SpeciesIndex = 0; SpeciesIndex < GetNumSpecies(); SpeciesIndex++)
 	{
-		OnCatsWin();
-		return;
+		NumMammals += GetMammalsOfSpecies(static_cast<ETBMammalSpecies>(SpeciesIndex)).Num();
 	}
+	return NumMammals;
+}
 
-	if(Mice.Num() <= 0)
+void ATBTurnedBasedManager::DestroyMammal(ATBMammalBase* Mammal)
+{
+	SquareMapGeneratorRef->ClearTile(Mammal->GetCurrentTile());
+	MovementSystem.RemoveMove(Mammal);
+	ReleaseMammalHandle(Mammal->Handle);
+	ReleaseMammalActor(Mammal);
+}
+
+void ATBTurnedBasedManager::ReleaseMammalActor(ATBMammalBase* Mammal)
+{
+	TArray<TObjectPtr<ATBMammalBase>>& Pool = MammalPools[static_cast<int32>(Mammal->Species)].Mammals;
+	if(Pool.Num() >= MaxPooledMammals)
 	{
-		OnMiceWin();
+		// a destroyed actor dissolves the cluster at the next collection, OnRoundFinished creates it again
+		if(MammalCluster)
+		{
+			MammalCluster->RemoveMammal(Mammal);
+		}
+		Mammal->Destroy();
 		return;
 	}
-	
-	CurrentRound++;
-	
-	bIsRoundOngoing = true;
-	CurrentCatIndex = 0;
-	CurrentMouseIndex = 0;
 
-	
-	// start the round by selecting first cat in the list
-	Cats[CurrentCatIndex]->OnTurnFinished.AddDynamic(this, &ATBTurnedBasedManager::OnTurnFinished);
-	Cats[CurrentCatIndex]->ExecuteTurn();
+	Mammal->ResetForPool();
+	Mammal->SetActorHiddenInGame(true);
+	Mammal->SetActorEnableCollision(false);
+	Mammal->UpdateDebugWidget(false);
+	Pool.Add(Mammal);
 }
 
-void ATBTurnedBasedManager::OnTurnFinished(ATBMammalBase* PlayedMammal, bool bWasSuccessful)
+int32 ATBTurnedBasedManager::GetNumPooledMammals() const
 {
-	PlayedMammal->OnTurnFinished.Clear();
-	
-	// move next cat
-	if(CurrentCatIndex + 1 < Cats.Num())
-	{
-		CurrentCatIndex++;
-		Cats[CurrentCatIndex]->OnTurnFinished.AddDynamic(this, &ATBTurnedBasedManager::OnTurnFinished);
-		Cats[CurrentCatIndex]->ExecuteTurn();
-		return;
-	}
-	
-	// then mice move
-	if(CurrentMouseIndex < Mice.Num())
+	int32 NumPooledMammals = 0;
+	for(const FTBMammalPool& Pool : MammalPools)
 	{
-		CurrentMouseIndex++;
-		Mice[CurrentMouseIndex-1]->OnTurnFinished.AddDynamic(this, &ATBTurnedBasedManager::OnTurnFinished);
-		Mice[CurrentMouseIndex-1]->ExecuteTurn();
-		return;
+		NumPooledMammals += Pool.Mammals.Num();
 	}
-
-	//after all of the mammals moved, try breeding
-	TryBreedMammals();
-	
-	TryStarveMammals();
-	
-	// round finished
-	OnRoundFinished();
-	
+	return NumPooledMammals;
 }
 
-void ATBTurnedBasedManager::OnKillRequested(ATBMammalBase* KilledMammal)
+bool ATBTurnedBasedManager::ShouldClusterMammalActors() const
 {
-	KilledMammal->OnTurnFinished.Clear();
-	KilledMammal->OnKilled.Clear();
-	
-	Mice.Remove(KilledMammal);
-	AllMammalsToBreed.Remove(KilledMammal); // remove it from breeding list
-
-	//KilledMammal->GetCurrentTile()->ClearTile();
-	FTileInfo* Tile = KilledMammal->GetCurrentTile();
-	Tile->bIsEmptyTile = true;
-	Tile->MammalRef = nullptr;
-	//SquareMapGeneratorRef->ClearTile(TilePos.X,TilePos.Y);
-
-	KilledMammal->Destroy();
+	// the engine only builds clusters for cooked data
+	return bClusterMammalActors && FPlatformProperties::RequiresCookedData() && !SquareMapGeneratorRef->bUsePerMammalDebugWidgets;
+}
+
+void ATBTurnedBasedManager::OnPreGarbageCollect()
+{
+	GarbageCollectionStartCycles = FPlatformTime::Cycles64();
+}
+
+void ATBTurnedBasedManager::OnPostGarbageCollect()
+{
+	if(GarbageCollectionStartCycles == 0) return;
+
+	GarbageCollectionCycles += FPlatformTime::Cycles64() - GarbageCollectionStartCycles;
+	GarbageCollectionStartCycles = 0;
+}
+
+FTBMammalHandle ATBTurnedBasedManager::AllocateMammalHandle(ATBMammalBase* Mammal)
+{
+	int32 SlotIndex;
+	if(FreeMammalSlots.Num() > 0)
+	{
+		SlotIndex = FreeMammalSlots.Pop(false);
+	}
+	else
+	{
+		check(MammalSlots.Num() <= static_cast<int32>(FTBMammalHandle::MaxIndex));
+		SlotIndex = MammalSlots.AddDefaulted();
+	}
+
+	FTBMammalSlot& Slot = MammalSlots[SlotIndex];
+	Slot.Mammal = Mammal;
+	return FTBMammalHandle::Make(SlotIndex, Slot.Generation);
+}
+
+void ATBTurnedBasedManager::ReleaseMammalHandle(const FTBMammalHandle Handle)
+{
+	if(!ResolveMammal(Handle)) return;
+
+	// bump the generation so existing copies of the handle stop resolving
+	FTBMammalSlot& Slot = MammalSlots[Handle.GetIndex()];
+	Slot.Mammal = nullptr;
+	Slot.Generation = FTBMammalHandle::GetNextGeneration(Slot.Generation);
+	FreeMammalSlots.Add(Handle.GetIndex());
+
+	// deaths are recorded when they happen, living mammals at the end of the round
+	if(RoundHistory.IsRoundOpen())
+	{
+		RoundHistory.RecordMammal(Handle.GetIndex(), FTBMammalRecord());
+	}
+}
+
+void ATBTurnedBasedManager::InitSpawnMammals()
+{
+	TB_PROFILE_SCOPE(Spawning);
+
+	BuildSpeciesTable();
+
+	// the budget is checked before anything spawns, from the class defaults of the species
+	int32 NumMammalsToSpawn = 0;
+	SIZE_T EstimatedBytes = 0;
+	for(const FTBSpeciesDefinition& Definition : ActiveSpecies)
+	{
+		NumMammalsToSpawn += Definition.NumberToSpawn;
+		EstimatedBytes += Definition.NumberToSpawn * EstimateMammalClassMemory(Definition.MammalClass);
+	}
+	EstimatedBytesPerMammal = NumMammalsToSpawn > 0 ? EstimatedBytes / NumMammalsToSpawn : 0;
+
+	bIsOverMammalMemoryBudget = false;
+	CheckMammalMemoryBudget(NumMammalsToSpawn);
+
+	// species spawn in table order
+	for(int32 SpeciesIndex = 0; SpeciesIndex < GetNumSpecies(); SpeciesIndex++)
+	{
+		for(int i= 0 ; i < ActiveSpecies[SpeciesIndex].NumberToSpawn; i++)
+		{
+			const FTBTileHandle TileResult = SquareMapGeneratorRef->GetRandomEmptyTile();
+			ATBMammalBase* SpawnedMammal = TileResult.IsValid() ? SpawnMammal(static_cast<ETBMammalSpecies>(SpeciesIndex), TileResult) : nullptr;
+			if(!SpawnedMammal)
+			{
+				break; // if cant find any empty tile exit the loop
+			}
+			AddSpawnedMammal(SpawnedMammal);
+		}
+	}
+}
+
+void ATBTurnedBasedManager::StartNextRound()
+{
+	if(bIsRoundOngoing) return;
+
+	TB_PROFILE_SCOPE(Round);
+
+	// the game is over, write what is left of its telemetry
+	if(TelemetryWriter && (Cats.Num() <= 0 || Mice.Num() <= 0))
+	{
+		TelemetryWriter->Flush();
+	}
+	
+	if(Cats.Num() <= 0)
+	{
+		OnCatsWin();
+		return;
+	}
+
+	if(Mice.Num() <= 0)
+	{
+		OnMiceWin();
+		return;
+	}
+
+	// rounds of the simulation thread are presented once they are queued, the game thread never waits for them
+	FTBRoundResult* SimulatedResult = nullptr;
+	if(bIsPipelineActive && SimulationThread)
+	{
+		SimulatedResult = SimulationThread->DequeueResult();
+
+		// the last round is queued before the thread finishes, so look once more
+		if(!SimulatedResult && SimulationThread->IsFinished())
+		{
+			SimulatedResult = SimulationThread->DequeueResult();
+			if(!SimulatedResult)
+			{
+				UE_LOG(LogTemp, Error, TEXT("ATBTurnedBasedManager::StartNextRound -> Simulation thread has no round %d!"), CurrentRound + 1);
+				bIsWaitingForSimulatedRound = false;
+				return;
+			}
+		}
+
+		bIsWaitingForSimulatedRound = !SimulatedResult;
+		if(!SimulatedResult)
+		{
+			// not simulated yet, look again next frame. A paused thread presents nothing until it is resumed or stepped.
+			if(SimulationThread->IsRunning() || NumSteppedSimulationRounds > 0)
+			{
+				TimerHandle_StartNextRound = GetWorldTimerManager().SetTimerForNextTick(this, &ATBTurnedBasedManager::StartNextRound);
+			}
+			return;
+		}
+
+		NumSteppedSimulationRounds = FMath::Max(NumSteppedSimulationRounds - 1, 0);
+	}
+	
+	CurrentRound++;
+	
+	bIsRoundOngoing = true;
+	CurrentTurnSpecies = 0;
+	NextTurnIndex = 0;
+	RoundStartCycles = FPlatformTime::Cycles64();
+	TurnsStartCycles = RoundStartCycles;
+
+	// births and deaths are counted per round, populations stay until the round finishes
+	CurrentRoundStats.Round = CurrentRound;
+	CurrentRoundStats.bIsRoundOngoing = true;
+	CurrentRoundStats.CatsBorn = 0;
+	CurrentRoundStats.MiceBorn = 0;
+	CurrentRoundStats.CatsStarved = 0;
+	CurrentRoundStats.MiceStarved = 0;
+	CurrentRoundStats.MiceEaten = 0;
+	CurrentRoundStats.RoundMs = 0;
+	CurrentRoundStats.BuildFieldsMs = 0;
+	CurrentRoundStats.TurnsMs = 0;
+	CurrentRoundStats.BreedMs = 0;
+	CurrentRoundStats.StarveMs = 0;
+	OnRoundStatsUpdated.Broadcast(CurrentRoundStats);
+
+	if(SimulatedResult)
+	{
+		ensure(SimulatedResult->Round == CurrentRound);
+
+		PresentRoundResult(*SimulatedResult);
+		SimulationThread->RecycleResult(SimulatedResult);
+		return;
+	}
+
+	if(bIsPipelineActive)
+	{
+		// the round was simulated while the previous one was animated, this only waits if the worker is slower than the animation
+		if(PendingRoundTask.IsValid())
+		{
+			PendingRoundTask.Wait();
+		}
+		Swap(FrontRoundResult, BackRoundResult);
+		ensure(FrontRoundResult.Round == CurrentRound);
+
+		LaunchNextSimulatedRound();
+		PresentRoundResult(FrontRoundResult);
+		return;
+	}
+
+	// the tile changes of the round are journaled from here until the round finishes
+	RoundHistory.BeginRound(CurrentRound);
+
+	// reorder along the Z-order curve at a fixed round interval, so the turn order only depends on the board state
+	if(MammalProcessingOrder == ETBMammalProcessingOrder::ZOrder && (CurrentRound - 1) % FMath::Max(ZOrderSortInterval, 1) == 0)
+	{
+		for(int32 SpeciesIndex = 0; SpeciesIndex < GetNumSpecies(); SpeciesIndex++)
+		{
+			SortMammalsByZOrder(GetMammalsOfSpecies(static_cast<ETBMammalSpecies>(SpeciesIndex)));
+		}
+	}
+
+	// fields are built from the board at the start of the round and read by the mammals during their turns
+	BuildRoundFields();
+	TurnsStartCycles = FPlatformTime::Cycles64();
+	CurrentRoundStats.BuildFieldsMs = FPlatformTime::ToMilliseconds64(TurnsStartCycles - RoundStartCycles);
+
+	// start the round by selecting first cat in the list
+	DispatchTurns();
+}
+
+void ATBTurnedBasedManager::OnTurnFinished(ATBMammalBase* PlayedMammal, bool bWasSuccessful)
+{
+	PlayedMammal->OnTurnFinished.Clear();
+
+	// the turn finished inside ExecuteTurn (blocked mammal or instant move), let the running loop start the next turn instead of recursing
+	if(bIsDispatchingTurns)
+	{
+		bHasPendingTurn = true;
+		return;
+	}
+
+	DispatchTurns();
+}
+
+void ATBTurnedBasedManager::DispatchTurns()
+{
+	bIsDispatchingTurns = true;
+	do
+	{
+		bHasPendingTurn = false;
+		ExecuteNextTurn();
+	}
+	while(bHasPendingTurn);
+	bIsDispatchingTurns = false;
+}
+
+void ATBTurnedBasedManager::ExecuteNextTurn()
+{
+	// move the next mammal of the current species, then the species after it
+	while(CurrentTurnSpecies < GetNumSpecies())
+	{
+		const TArray<ATBMammalBase*>& Mammals = GetMammalsOfSpecies(static_cast<ETBMammalSpecies>(CurrentTurnSpecies));
+		if(NextTurnIndex < Mammals.Num())
+		{
+			ATBMammalBase* Mammal = Mammals[NextTurnIndex++];
+			Mammal->OnTurnFinished.AddDynamic(this, &ATBTurnedBasedManager::OnTurnFinished);
+			Mammal->ExecuteTurn();
+			return;
+		}
+
+		CurrentTurnSpecies++;
+		NextTurnIndex = 0;
+	}
+
+	const uint64 BreedStartCycles = FPlatformTime::Cycles64();
+	CurrentRoundStats.TurnsMs = FPlatformTime::ToMilliseconds64(BreedStartCycles - TurnsStartCycles);
+
+	//after all of the mammals moved, try breeding
+	TryBreedMammals();
+	const uint64 StarveStartCycles = FPlatformTime::Cycles64();
+	CurrentRoundStats.BreedMs = FPlatformTime::ToMilliseconds64(StarveStartCycles - BreedStartCycles);
+	
+	TryStarveMammals();
+	CurrentRoundStats.StarveMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StarveStartCycles);
+	
+	// round finished
+	OnRoundFinished();
+	
+}
+
+void ATBTurnedBasedManager::OnKillRequested(ATBMammalBase* KilledMammal)
+{
+	KilledMammal->OnTurnFinished.Clear();
+	KilledMammal->OnKilled.Clear();
+	
+	// a mammal that already played this round shifts the turn order of its species
+	TArray<ATBMammalBase*>& Mammals = GetMammalsOfSpecies(KilledMammal->Species);
+	const int32 KilledIndex = Mammals.Find(KilledMammal);
+	if(KilledIndex != INDEX_NONE)
+	{
+		if(static_cast<int32>(KilledMammal->Species) == CurrentTurnSpecies && KilledIndex < NextTurnIndex)
+		{
+			NextTurnIndex--;
+		}
+		Mammals.RemoveAt(KilledIndex);
+	}
+	AllMammalsToBreed.Remove(KilledMammal); // remove it from breeding list
+	MammalsToStarve.Remove(KilledMammal); // its actor can be reused by a birth before the starving
+	if(KilledMammal->Species == ETBMammalSpecies::Mouse)
+	{
+		CurrentRoundStats.MiceEaten++;
+	}
+
+	DestroyMammal(KilledMammal);
 }
 
 void ATBTurnedBasedManager::OnStarved(ATBMammalBase* StarvedMammal)
@@ -231,6 +1101,46 @@ void ATBTurnedBasedManager::OnRoundFinished()
 {
 	bIsRoundOngoing = false;
 	GetWorldTimerManager().ClearTimer(TimerHandle_StartNextRound);
+
+	// free the chunks mammals left during the round
+	SquareMapGeneratorRef->ReleaseEmptyChunks();
+
+	// actors over the pool size were destroyed since the cluster was built
+	if(MammalCluster)
+	{
+		MammalCluster->RebuildIfDissolved();
+	}
+
+	// nothing allocated during the round is used anymore
+	RoundArena.Reset();
+	PreyDistanceField.Reset();
+	ThreatInfluenceMap.Reset();
+	CurrentRoundStats.RoundArenaPeakBytes = static_cast<int64>(RoundArena.GetLastPeakBytes());
+
+	// round 0 is the starting population, it has no timings
+	if(CurrentRound > 0)
+	{
+		CurrentRoundStats.RoundMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - RoundStartCycles);
+		if(bIsPipelineActive)
+		{
+			CurrentRoundStats.TurnsMs = CurrentRoundStats.RoundMs;
+		}
+	}
+
+	// collections run between frames, so they are charged to the round that finishes next
+	CurrentRoundStats.GarbageCollectionMs = FPlatformTime::ToMilliseconds64(GarbageCollectionCycles);
+	GarbageCollectionCycles = 0;
+
+	UE_LOG(LogTemp, Verbose, TEXT("ATBTurnedBasedManager::OnRoundFinished -> Round arena peak %llu bytes, block %llu bytes"),
+		static_cast<uint64>(RoundArena.GetLastPeakBytes()), static_cast<uint64>(RoundArena.GetBlockSize()));
+
+	RecordRoundHistory();
+	PublishFinishedRoundStats();
+	RecordTelemetry();
+
+	CheckMammalMemoryBudget(GetNumMammals());
+	UpdateMemoryStats();
+	UpdateBoardViews();
 	
 	if(bAutoStartNextRound)
 	{
@@ -238,9 +1148,42 @@ void ATBTurnedBasedManager::OnRoundFinished()
 	}
 }
 
+void ATBTurnedBasedManager::UpdateBoardViews()
+{
+	// rewrite the whole board into the heatmap and upload it once
+	UTBTileHeatmapComponent* TileHeatmap = SquareMapGeneratorRef->TileHeatmapComponent;
+	if(TileHeatmap->IsHeatmapActive())
+	{
+		TileHeatmap->BeginHeatmapUpdate();
+		ForEachMammal([this, TileHeatmap](const ATBMammalBase* Mammal)
+		{
+			TileHeatmap->WriteTile(SquareMapGeneratorRef->GetTileCoordinates(Mammal->GetCurrentTile()), Mammal->CurrentTileColor,
+				Mammal->Species, Mammal->GetStarveCounter(), Mammal->GetBreedCounter());
+		});
+		TileHeatmap->FlushHeatmap();
+	}
+
+	// counters only change between rounds, so the overlay is fed once per round instead of every mammal updating its own widget
+	if(SquareMapGeneratorRef->ShowDebug && !SquareMapGeneratorRef->bUsePerMammalDebugWidgets)
+	{
+		UTBDebugOverlayComponent* DebugOverlay = SquareMapGeneratorRef->DebugOverlayComponent;
+		DebugOverlay->ResetMammalCounters();
+		ForEachMammal([DebugOverlay](const ATBMammalBase* Mammal)
+		{
+			FTBMammalDebugCounters Counters;
+			Counters.StarveCounter = Mammal->GetStarveCounter();
+			Counters.BreedCounter = Mammal->GetBreedCounter();
+			Counters.SavedBreedCounter = Mammal->GetSavedBreedCounter();
+			DebugOverlay->SetMammalCounters(Mammal->Handle, Counters);
+		});
+	}
+}
+
 
 void ATBTurnedBasedManager::TryBreedMammals()
 {
+	TB_PROFILE_SCOPE(Breed);
+
 	int i = 0;
 	while(i < AllMammalsToBreed.Num())
 	{
@@ -259,8 +1202,8 @@ void ATBTurnedBasedManager::TryBreedMammals()
 			continue;
 		}
 		
-		const FTileInfo* MammalTile = MammalToBreed->GetCurrentTile();
-		if(!MammalTile)
+		const FTBTileHandle MammalTile = MammalToBreed->GetCurrentTile();
+		if(!MammalTile.IsValid())
 		{
 			MammalToBreed->SetSavedBreedCounter(0);
 			AllMammalsToBreed.RemoveAt(i);
@@ -268,7 +1211,8 @@ void ATBTurnedBasedManager::TryBreedMammals()
 		}
 		
 		// try find empty tiles to spawn 
-		TArray<FTileInfo*> EmptyTiles = SquareMapGeneratorRef->GetAllAdjacentEmptyTiles(MammalTile);
+		TTBArenaArray<FTBTileHandle> EmptyTiles = RoundArena.AllocateArray<FTBTileHandle>(ATBSquareMapGenerator::MaxAdjacentTiles);
+		SquareMapGeneratorRef->GetAllAdjacentEmptyTiles(MammalTile, EmptyTiles);
 
 		//if there is empty tile to spawn and still remaining breeds
 		while (EmptyTiles.Num() > 0 && SavedBreedCount > 0)
@@ -277,23 +1221,18 @@ void ATBTurnedBasedManager::TryBreedMammals()
 			const int RandomIndex = UKismetMathLibrary::RandomIntegerInRange(0, EmptyTiles.Num()-1);
 
 			//spawn the mammal on the empty tile
-			ATBMammalBase* SpawnedMammal = SpawnMammal(MammalToBreed->GetClass(), EmptyTiles[RandomIndex]);
+			ATBMammalBase* SpawnedMammal = SpawnMammal(MammalToBreed->Species, EmptyTiles[RandomIndex]);
 
 			// bind events
-			if(MammalToBreed->GetClass() == MouseClass)
+			AddSpawnedMammal(SpawnedMammal);
+			if(SpawnedMammal->Species == ETBMammalSpecies::Cat)
 			{
-				SpawnedMammal->OnKilled.AddDynamic(this, &ATBTurnedBasedManager::OnKillRequested);
-				SpawnedMammal->OnBred.AddDynamic(this, &ATBTurnedBasedManager::OnBred);
-				Mice.Add(SpawnedMammal);
+				CurrentRoundStats.CatsBorn++;
 			}
-			else if(MammalToBreed->GetClass() == CatClass)
+			else if(SpawnedMammal->Species == ETBMammalSpecies::Mouse)
 			{
-				SpawnedMammal->OnStarved.AddDynamic(this, &ATBTurnedBasedManager::OnStarved);
-				SpawnedMammal->OnBred.AddDynamic(this, &ATBTurnedBasedManager::OnBred);
-				Cats.Add(SpawnedMammal);
+				CurrentRoundStats.MiceBorn++;
 			}
-			SpawnedMammal->MapGeneratorRef = SquareMapGeneratorRef;
-			SpawnedMammal->UpdateDebugWidget(SquareMapGeneratorRef->ShowDebug);
 			
 			// remove the tile that we spawned on
 			EmptyTiles.RemoveAt(RandomIndex);
@@ -311,6 +1250,8 @@ void ATBTurnedBasedManager::TryBreedMammals()
 
 void ATBTurnedBasedManager::TryStarveMammals()
 {
+	TB_PROFILE_SCOPE(Starve);
+
 	for(int i = 0; i< MammalsToStarve.Num(); i++)
 	{
 		ATBMammalBase* MammalToStarve = MammalsToStarve[i];
@@ -323,24 +1264,678 @@ void ATBTurnedBasedManager::TryStarveMammals()
 			continue;
 		}
 		
-		//remove the mammal from cats or mice
-		if(MammalToStarve->GetClass() == CatClass)
+		//remove the mammal from its species
+		GetMammalsOfSpecies(MammalToStarve->Species).Remove(MammalToStarve);
+		if(MammalToStarve->Species == ETBMammalSpecies::Cat)
 		{
-			Cats.Remove(MammalToStarve);
+			CurrentRoundStats.CatsStarved++;
 		}
-		else if(MammalToStarve->GetClass() == MouseClass)
+		else if(MammalToStarve->Species == ETBMammalSpecies::Mouse)
 		{
-			Mice.Remove(MammalToStarve);
+			CurrentRoundStats.MiceStarved++;
 		}
 		
 		// also remove it from breeding list, if possible
 		AllMammalsToBreed.Remove(MammalToStarve);
 
 		// destroy the mammal and clear the tile
-		FTileInfo* Tile = MammalToStarve->GetCurrentTile();
-		Tile->bIsEmptyTile = true;
-		Tile->MammalRef = nullptr;
-		MammalToStarve->Destroy();
+		DestroyMammal(MammalToStarve);
+	}
+}
+
+void ATBTurnedBasedManager::PublishFinishedRoundStats()
+{
+	CurrentRoundStats.Round = CurrentRound;
+	CurrentRoundStats.bIsRoundOngoing = false;
+	CurrentRoundStats.AliveCats = Cats.Num();
+	CurrentRoundStats.AliveMice = Mice.Num();
+	CurrentRoundStats.AliveMammalsBySpecies.SetNum(GetNumSpecies());
+	for(int32 SpeciesIndex = 0; SpeciesIndex < GetNumSpecies(); SpeciesIndex++)
+	{
+		CurrentRoundStats.AliveMammalsBySpecies[SpeciesIndex] = GetMammalsOfSpecies(static_cast<ETBMammalSpecies>(SpeciesIndex)).Num();
+	}
+
+	int32 CatStarveSum = 0;
+	int32 CatBreedSum = 0;
+	for(const ATBMammalBase* Cat : Cats)
+	{
+		CatStarveSum += Cat->GetStarveCounter();
+		CatBreedSum += Cat->GetBreedCounter();
+	}
+	int32 MouseBreedSum = 0;
+	for(const ATBMammalBase* Mouse : Mice)
+	{
+		MouseBreedSum += Mouse->GetBreedCounter();
+	}
+	CurrentRoundStats.AverageCatStarveCounter = Cats.Num() > 0 ? static_cast<float>(CatStarveSum) / Cats.Num() : 0;
+	CurrentRoundStats.AverageCatBreedCounter = Cats.Num() > 0 ? static_cast<float>(CatBreedSum) / Cats.Num() : 0;
+	CurrentRoundStats.AverageMouseBreedCounter = Mice.Num() > 0 ? static_cast<float>(MouseBreedSum) / Mice.Num() : 0;
+
+	// overwrite the oldest entry once the history is full
+	const int32 HistorySize = FMath::Max(RoundStatsHistorySize, 1);
+	if(RoundStatsHistory.Num() < HistorySize)
+	{
+		RoundStatsHistory.Add(CurrentRoundStats);
+	}
+	else
+	{
+		RoundStatsHistory[RoundStatsHistoryHead] = CurrentRoundStats;
+		RoundStatsHistoryHead = (RoundStatsHistoryHead + 1) % RoundStatsHistory.Num();
+	}
+
+	OnRoundStatsUpdated.Broadcast(CurrentRoundStats);
+}
+
+void ATBTurnedBasedManager::StartTelemetry()
+{
+	TelemetryWriter.Reset();
+	if(!bExportTelemetry) return;
+
+	// a new file per game, named after the time it started
+	const FString Directory = TelemetryDirectory.IsEmpty() ? FPaths::ProjectSavedDir() / TEXT("Telemetry") : TelemetryDirectory;
+	const FString FilePath = FPaths::CreateTempFilename(*Directory, *FString::Printf(TEXT("TBTelemetry_%s_"), *FDateTime::Now().ToString()), TEXT(".tbtelemetry"));
+
+	// 8 blocks in flight let the writer fall behind by a few disk stalls before rounds are dropped
+	TelemetryWriter = MakeUnique<FTBTelemetryWriter>(FilePath, TelemetryRoundsPerBlock, 8);
+	if(!TelemetryWriter->IsOpen())
+	{
+		TelemetryWriter.Reset();
+		return;
 	}
+	UE_LOG(LogTemp, Log, TEXT("ATBTurnedBasedManager::StartTelemetry -> Writing telemetry to %s"), *FilePath);
+}
+
+void ATBTurnedBasedManager::StopTelemetry()
+{
+	// joins the writer thread once the file is complete
+	TelemetryWriter.Reset();
 }
 
+void ATBTurnedBasedManager::RecordTelemetry()
+{
+	if(!TelemetryWriter || !SquareMapGeneratorRef) return;
+
+	FTBTelemetryRecord Record;
+	Record.Round = CurrentRoundStats.Round;
+	Record.AliveCats = CurrentRoundStats.AliveCats;
+	Record.AliveMice = CurrentRoundStats.AliveMice;
+	Record.CatsBorn = CurrentRoundStats.CatsBorn;
+	Record.MiceBorn = CurrentRoundStats.MiceBorn;
+	Record.CatsStarved = CurrentRoundStats.CatsStarved;
+	Record.MiceStarved = CurrentRoundStats.MiceStarved;
+	Record.MiceEaten = CurrentRoundStats.MiceEaten;
+	Record.RoundMs = CurrentRoundStats.RoundMs;
+	Record.BuildFieldsMs = CurrentRoundStats.BuildFieldsMs;
+	Record.TurnsMs = CurrentRoundStats.TurnsMs;
+	Record.BreedMs = CurrentRoundStats.BreedMs;
+	Record.StarveMs = CurrentRoundStats.StarveMs;
+	Record.GarbageCollectionMs = CurrentRoundStats.GarbageCollectionMs;
+	SquareMapGeneratorRef->GetBlockDensityHistogram(ETBMammalSpecies::Cat, MakeArrayView(Record.CatDensity));
+	SquareMapGeneratorRef->GetBlockDensityHistogram(ETBMammalSpecies::Mouse, MakeArrayView(Record.MouseDensity));
+
+	TelemetryWriter->AddRound(Record);
+}
+
+void ATBTurnedBasedManager::RecordRoundHistory()
+{
+	if(!RoundHistory.IsActive()) return;
+
+	// unchanged records are skipped by the history, so only what the round changed is kept
+	ForEachMammal([this](const ATBMammalBase* Mammal)
+	{
+		FTBMammalRecord Record;
+		Record.Handle = Mammal->Handle;
+		Record.Tile = Mammal->GetCurrentTile();
+		Record.Species = Mammal->Species;
+		Record.StarveCounter = Mammal->GetStarveCounter();
+		Record.BreedCounter = Mammal->GetBreedCounter();
+		Record.SavedBreedCounter = Mammal->GetSavedBreedCounter();
+		RoundHistory.RecordMammal(Mammal->Handle.GetIndex(), Record);
+	});
+	RoundHistory.EndRound();
+}
+
+bool ATBTurnedBasedManager::RewindRounds(const int Rounds, const int Seed)
+{
+	if(!RoundHistory.IsActive())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::RewindRounds -> The game has no round history, set bEnableRoundHistory before it starts!"));
+		return false;
+	}
+
+	if(bIsRoundOngoing)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::RewindRounds -> Can't rewind while round %d is ongoing!"), CurrentRound);
+		return false;
+	}
+
+	const int TargetRound = CurrentRound - Rounds;
+	if(Rounds <= 0 || !RoundHistory.CanRewindTo(TargetRound))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::RewindRounds -> Round %d is not in the history, rounds %d to %d and the checkpoints can be restored!"),
+			TargetRound, RoundHistory.GetOldestDeltaRound(), CurrentRound - 1);
+		return false;
+	}
+
+	GetWorldTimerManager().ClearTimer(TimerHandle_StartNextRound);
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	TArray<int32> ChangedSlots;
+	RoundHistory.RewindTo(TargetRound, ChangedSlots);
+	ApplyMammalRecords(ChangedSlots);
+	CurrentRound = TargetRound;
+	UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::RewindRounds -> Rewound to round %d, %d mammals changed in %.3f ms"),
+		CurrentRound, ChangedSlots.Num(), FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+
+	if(Seed >= 0)
+	{
+		FMath::RandInit(Seed);
+	}
+
+	// the stats of the later rounds belong to the branch that was left, the target round keeps its own
+	TArray<FTBRoundStats> KeptRoundStats;
+	GetRoundStatsHistory(KeptRoundStats);
+	if(const FTBRoundStats* TargetRoundStats = KeptRoundStats.FindByPredicate([TargetRound](const FTBRoundStats& Stats) { return Stats.Round == TargetRound; }))
+	{
+		CurrentRoundStats = *TargetRoundStats;
+	}
+	else
+	{
+		CurrentRoundStats = FTBRoundStats();
+	}
+	KeptRoundStats.RemoveAll([TargetRound](const FTBRoundStats& Stats) { return Stats.Round >= TargetRound; });
+	RoundStatsHistory = MoveTemp(KeptRoundStats);
+	RoundStatsHistoryHead = 0;
+
+	SquareMapGeneratorRef->ReleaseEmptyChunks();
+	// the target round is already in the telemetry file, the file keeps the rounds of every branch as they were played
+	PublishFinishedRoundStats();
+	UpdateMemoryStats();
+	UpdateBoardViews();
+
+	if(bAutoStartNextRound)
+	{
+		GetWorldTimerManager().SetTimer(TimerHandle_StartNextRound, this, &ATBTurnedBasedManager::StartNextRound, StartNextRoundTime, false);
+	}
+	return true;
+}
+
+void ATBTurnedBasedManager::ApplyMammalRecords(const TArray<int32>& SlotIndices)
+{
+	TSet<ATBMammalBase*> RemovedMammals;
+	TArray<ATBMammalBase*> BreedingMammals;
+	for(const int32 SlotIndex : SlotIndices)
+	{
+		// slots are never removed during a game, so every recorded slot still exists
+		if(!ensure(MammalSlots.IsValidIndex(SlotIndex))) continue;
+
+		const FTBMammalRecord& Record = RoundHistory.GetRecord(SlotIndex);
+		FTBMammalSlot& Slot = MammalSlots[SlotIndex];
+		ATBMammalBase* Mammal = Slot.Mammal;
+		const bool bWasFree = Mammal == nullptr;
+
+		// the actor of another mammal can't be reused, its handle is in the records of other rounds. It is pooled once it left the lists.
+		if(Mammal && (!Record.IsAlive() || Mammal->Handle != Record.Handle || Mammal->Species != Record.Species))
+		{
+			RemovedMammals.Add(Mammal);
+			Slot.Mammal = Mammal = nullptr;
+
+			if(!Record.IsAlive())
+			{
+				Slot.Generation = FTBMammalHandle::GetNextGeneration(Slot.Generation);
+				FreeMammalSlots.Add(SlotIndex);
+			}
+		}
+
+		if(!Record.IsAlive()) continue;
+
+		if(!Mammal)
+		{
+			Mammal = SpawnMammalActor(Record.Species, Record.Tile);
+			if(!Mammal) continue;
+
+			if(bWasFree)
+			{
+				FreeMammalSlots.RemoveSingleSwap(SlotIndex);
+			}
+
+			// the grid already holds the recorded handle, so the slot takes back its generation
+			Slot.Mammal = Mammal;
+			Slot.Generation = Record.Handle.GetGeneration();
+			Mammal->Handle = Record.Handle;
+			AddSpawnedMammal(Mammal);
+		}
+
+		Mammal->SetCurrentTile(Record.Tile);
+		Mammal->SetActorLocation(SquareMapGeneratorRef->GetTileWorldLocation(Record.Tile) + FVector(0, 0, SquareMapGeneratorRef->GetTileHalfExtents().Z));
+		Mammal->SetCounters(Record.StarveCounter, Record.BreedCounter, Record.SavedBreedCounter);
+		if(Record.SavedBreedCounter > 0)
+		{
+			BreedingMammals.Add(Mammal);
+		}
+	}
+
+	// one pass over the lists instead of a search per removed mammal
+	if(RemovedMammals.Num() > 0)
+	{
+		auto IsRemoved = [&RemovedMammals](const ATBMammalBase* Mammal) { return RemovedMammals.Contains(Mammal); };
+		for(int32 SpeciesIndex = 0; SpeciesIndex < GetNumSpecies(); SpeciesIndex++)
+		{
+			GetMammalsOfSpecies(static_cast<ETBMammalSpecies>(SpeciesIndex)).RemoveAll(IsRemoved);
+		}
+		AllMammalsToBreed.RemoveAll(IsRemoved);
+
+		for(ATBMammalBase* Mammal : RemovedMammals)
+		{
+			ReleaseMammalActor(Mammal);
+		}
+	}
+
+	// saved breeds carry over to the next round's breeding
+	for(ATBMammalBase* Mammal : BreedingMammals)
+	{
+		AllMammalsToBreed.AddUnique(Mammal);
+	}
+}
+
+void ATBTurnedBasedManager::GetRoundStatsHistory(TArray<FTBRoundStats>& OutRoundStats) const
+{
+	OutRoundStats.Reset(RoundStatsHistory.Num());
+	for(int32 i = 0; i < RoundStatsHistory.Num(); i++)
+	{
+		OutRoundStats.Add(RoundStatsHistory[(RoundStatsHistoryHead + i) % RoundStatsHistory.Num()]);
+	}
+}
+
+SIZE_T ATBTurnedBasedManager::EstimateMammalClassMemory(const TSubclassOf<ATBMammalBase> MammalClass)
+{
+	if(!MammalClass) return 0;
+
+	// the class default holds the native components, components added in the blueprint are not counted
+	SIZE_T Bytes = MammalClass->GetStructureSize();
+	TArray<UObject*> Subobjects;
+	MammalClass->GetDefaultObject()->GetDefaultSubobjects(Subobjects);
+	for(const UObject* Subobject : Subobjects)
+	{
+		Bytes += Subobject->GetClass()->GetStructureSize();
+	}
+	return Bytes;
+}
+
+void ATBTurnedBasedManager::CheckMammalMemoryBudget(const int32 NumMammals)
+{
+	const SIZE_T EstimatedBytes = static_cast<SIZE_T>(FMath::Max(NumMammals, 0)) * EstimatedBytesPerMammal;
+	const SIZE_T BudgetBytes = static_cast<SIZE_T>(FMath::Max(MammalMemoryBudgetMB, 0.f) * 1024.0 * 1024.0);
+	if(EstimatedBytes <= BudgetBytes)
+	{
+		bIsOverMammalMemoryBudget = false;
+		return;
+	}
+
+	if(!bIsOverMammalMemoryBudget)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::CheckMammalMemoryBudget -> %d mammals are estimated at %.1f MB, over the budget of %.1f MB!"),
+			NumMammals, EstimatedBytes / (1024.0 * 1024.0), MammalMemoryBudgetMB);
+		bIsOverMammalMemoryBudget = true;
+	}
+}
+
+SIZE_T ATBTurnedBasedManager::GetMammalBookkeepingBytes() const
+{
+	SIZE_T OtherSpeciesBytes = ActiveSpecies.GetAllocatedSize();
+	for(const TArray<ATBMammalBase*>& Mammals : OtherSpeciesMammals)
+	{
+		OtherSpeciesBytes += Mammals.GetAllocatedSize();
+	}
+
+	return Cats.GetAllocatedSize() + Mice.GetAllocatedSize() + OtherSpeciesBytes + AllMammalsToBreed.GetAllocatedSize() + MammalsToStarve.GetAllocatedSize()
+		+ MammalSlots.GetAllocatedSize() + FreeMammalSlots.GetAllocatedSize() + MovementSystem.GetAllocatedSize() + PreyDistanceField.GetAllocatedSize()
+		+ ThreatInfluenceMap.GetAllocatedSize() + PipelineBookkeepingBytes + SimulatedMammals.GetAllocatedSize();
+}
+
+void ATBTurnedBasedManager::UpdateMemoryStats() const
+{
+#if STATS
+	// measuring the mesh components is not free, skip it unless someone is looking at the stats
+	if(!FThreadStats::IsCollectingData()) return;
+
+	const FTBMapMemoryStats MapStats = SquareMapGeneratorRef->GetMemoryStats();
+	SET_MEMORY_STAT(STAT_TBTileChunkMemory, MapStats.TileChunkBytes);
+	SET_MEMORY_STAT(STAT_TBBlockSummaryMemory, MapStats.BlockSummaryBytes);
+	SET_MEMORY_STAT(STAT_TBTileMeshMemory, MapStats.TileMeshBytes);
+	SET_MEMORY_STAT(STAT_TBTileHeatmapMemory, MapStats.HeatmapBytes);
+	SET_MEMORY_STAT(STAT_TBMammalActorMemory, GetNumMammals() * EstimatedBytesPerMammal);
+	SET_MEMORY_STAT(STAT_TBMammalBookkeepingMemory, GetMammalBookkeepingBytes());
+	SET_MEMORY_STAT(STAT_TBRoundArenaMemory, RoundArena.GetLastPeakBytes());
+#endif
+}
+
+void ATBTurnedBasedManager::LogMemoryReport() const
+{
+	if(!SquareMapGeneratorRef)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::LogMemoryReport -> There is no map!"));
+		return;
+	}
+
+	const double ToKB = 1.0 / 1024.0;
+	const FTBMapMemoryStats MapStats = SquareMapGeneratorRef->GetMemoryStats();
+	const int32 NumMammals = GetNumMammals();
+	const int32 NumPooledMammals = GetNumPooledMammals();
+	const SIZE_T MammalActorBytes = (NumMammals + NumPooledMammals) * EstimatedBytesPerMammal;
+	const SIZE_T BookkeepingBytes = GetMammalBookkeepingBytes();
+	const SIZE_T RoundHistoryBytes = RoundHistory.GetAllocatedSize();
+
+	UE_LOG(LogTemp, Display, TEXT("ATBTurnedBasedManager::LogMemoryReport -> Map %dx%d, %d allocated chunks"),
+		SquareMapGeneratorRef->GetSquareMapSize(), SquareMapGeneratorRef->GetSquareMapSize(), MapStats.NumAllocatedChunks);
+	UE_LOG(LogTemp, Display, TEXT("    Tile chunks:        %10.1f KB (%.2f bytes per tile)"), MapStats.TileChunkBytes * ToKB, MapStats.NumTiles > 0 ? static_cast<double>(MapStats.TileChunkBytes) / MapStats.NumTiles : 0.0);
+	UE_LOG(LogTemp, Display, TEXT("    Block summaries:    %10.1f KB"), MapStats.BlockSummaryBytes * ToKB);
+	UE_LOG(LogTemp, Display, TEXT("    Tile meshes:        %10.1f KB (%.2f bytes per tile)"), MapStats.TileMeshBytes * ToKB, MapStats.NumTiles > 0 ? static_cast<double>(MapStats.TileMeshBytes) / MapStats.NumTiles : 0.0);
+	UE_LOG(LogTemp, Display, TEXT("    Tile heatmap:       %10.1f KB"), MapStats.HeatmapBytes * ToKB);
+	UE_LOG(LogTemp, Display, TEXT("    Mammal actors:      %10.1f KB (%d mammals, %d pooled, ~%llu bytes per mammal)"), MammalActorBytes * ToKB, NumMammals, NumPooledMammals, static_cast<uint64>(EstimatedBytesPerMammal));
+	UE_LOG(LogTemp, Display, TEXT("    Mammal bookkeeping: %10.1f KB (%.2f bytes per mammal)"), BookkeepingBytes * ToKB, NumMammals > 0 ? static_cast<double>(BookkeepingBytes) / NumMammals : 0.0);
+	UE_LOG(LogTemp, Display, TEXT("    Round arena:        %10.1f KB (last round peak %.1f KB)"), RoundArena.GetBlockSize() * ToKB, RoundArena.GetLastPeakBytes() * ToKB);
+	UE_LOG(LogTemp, Display, TEXT("    Round history:      %10.1f KB (%d checkpoints, back to round %d)"), RoundHistoryBytes * ToKB, RoundHistory.GetNumCheckpoints(), RoundHistory.GetOldestDeltaRound());
+	UE_LOG(LogTemp, Display, TEXT("    Total:              %10.1f KB"), (MapStats.GetTotalBytes() + MammalActorBytes + BookkeepingBytes + RoundHistoryBytes) * ToKB);
+}
+
+void ATBTurnedBasedManager::BuildRoundFields()
+{
+	TB_PROFILE_SCOPE(BuildFields);
+
+	PreyDistanceField.Reset();
+	if(bEnableCatHunting)
+	{
+		// one field for every species that is eaten, predators with different prey share it. The sources come from the
+		// species masks of the chunks with mammals, empty chunks and the actors are never touched.
+		TArray<FTBTileHandle> PreyTiles;
+		SquareMapGeneratorRef->GetSpeciesTiles(PreySpeciesMask, PreyTiles);
+
+		// a failed build leaves the field unbuilt, so predators move randomly this round only
+		if(!PreyDistanceField.Build(*SquareMapGeneratorRef, PreyTiles, MaxHuntDistance) && !bHasWarnedFieldMapSize)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::BuildRoundFields -> Map is bigger than %d, cats can't hunt!"), FTBDistanceField::MaxMapSize);
+			bHasWarnedFieldMapSize = true;
+		}
+	}
+
+	ThreatInfluenceMap.Reset();
+	if(bEnableMouseEvasion)
+	{
+		// every predator is a threat, whatever it eats
+		TArray<FTBTileHandle> PredatorTiles;
+		SquareMapGeneratorRef->GetSpeciesTiles(PredatorSpeciesMask, PredatorTiles);
+
+		if(!ThreatInfluenceMap.Build(*SquareMapGeneratorRef, PredatorTiles, ThreatRadius) && !bHasWarnedFieldMapSize)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::BuildRoundFields -> Map is bigger than %d, mice can't evade!"), FTBInfluenceMap::MaxMapSize);
+			bHasWarnedFieldMapSize = true;
+		}
+	}
+}
+
+bool ATBTurnedBasedManager::MakeSimulationSettings(FTBSimulationSettings& OutSettings) const
+{
+	// the core only plays the cat and mouse species of the traits
+	if(!IsBuiltInFoodWeb()) return false;
+
+	const ATBMammalBase* CatDefaults = ActiveSpecies[0].MammalClass ? ActiveSpecies[0].MammalClass.GetDefaultObject() : nullptr;
+	const ATBMammalBase* MouseDefaults = ActiveSpecies[1].MammalClass ? ActiveSpecies[1].MammalClass.GetDefaultObject() : nullptr;
+	if(!CatDefaults || !MouseDefaults) return false;
+
+	auto MakeSpeciesRules = [this](const ATBMammalBase* Defaults, const ETBMammalSpecies Species)
+	{
+		FTBSpeciesRules Rules;
+		Rules.StarvationTurnCount = Defaults->StarvationTurnCount;
+		Rules.BreedTurnCount = Defaults->BreedTurnCount;
+		Rules.bCanEat = Defaults->bCanEat;
+		Rules.bCanStarve = Defaults->bCanStarve;
+		Rules.bCanBreed = Defaults->bCanBreed;
+		Rules.bCanHunt = Defaults->bCanHunt;
+		Rules.bCanEvade = Defaults->bCanEvade;
+		Rules.PreyMask = SpeciesPreyMasks[static_cast<int32>(Species)];
+		return Rules;
+	};
+
+	OutSettings.CatRules = MakeSpeciesRules(CatDefaults, ETBMammalSpecies::Cat);
+	OutSettings.MouseRules = MakeSpeciesRules(MouseDefaults, ETBMammalSpecies::Mouse);
+	OutSettings.bSortByZOrder = MammalProcessingOrder == ETBMammalProcessingOrder::ZOrder;
+	OutSettings.ZOrderSortInterval = ZOrderSortInterval;
+	OutSettings.bEnableCatHunting = bEnableCatHunting;
+	OutSettings.MaxHuntDistance = MaxHuntDistance;
+	OutSettings.bEnableMouseEvasion = bEnableMouseEvasion;
+	OutSettings.ThreatRadius = ThreatRadius;
+	return true;
+}
+
+void ATBTurnedBasedManager::StartRoundPipeline()
+{
+	FTBSimulationSettings Settings;
+	if(!MakeSimulationSettings(Settings))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::StartRoundPipeline -> The simulation core only plays cats eating mice, rounds are not pipelined!"));
+		bIsPipelineActive = false;
+		return;
+	}
+
+	if(!SimulationCore.Initialize(SquareMapGeneratorRef, Settings, CurrentRound))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::StartRoundPipeline -> Map is bigger than %d, rounds are not pipelined!"), FTBSimulationCore::MaxMapSize);
+		bIsPipelineActive = false;
+		return;
+	}
+
+	// the worker can't use the global random state, its stream is seeded from it so seeded games stay deterministic
+	SimulationCore.SetRandomSeed(FMath::Rand());
+
+	SimulatedMammals.Reset();
+	for(const TArray<ATBMammalBase*>* Mammals : {&Cats, &Mice})
+	{
+		for(ATBMammalBase* Mammal : *Mammals)
+		{
+			const uint32 Id = SimulationCore.AddMammal(Mammal->Species, Mammal->GetCurrentTile(), Mammal->GetStarveCounter(), Mammal->GetBreedCounter(), Mammal->GetSavedBreedCounter());
+			SimulatedMammals.Add(Id, Mammal);
+		}
+	}
+
+	if(bUseSimulationThread)
+	{
+		// the thread owns the core from now on
+		SimulationThread = MakeUnique<FTBSimulationThread>(MoveTemp(SimulationCore), MaxQueuedSimulatedRounds);
+		SimulationCore.Reset();
+		if(bAutoStartNextRound)
+		{
+			SimulationThread->StartRounds();
+		}
+		return;
+	}
+
+	LaunchNextSimulatedRound();
+}
+
+void ATBTurnedBasedManager::StopRoundPipeline()
+{
+	// joins the thread
+	SimulationThread.Reset();
+
+	if(PendingRoundTask.IsValid())
+	{
+		PendingRoundTask.Wait();
+		PendingRoundTask = UE::Tasks::FTask();
+	}
+
+	SimulationCore.Reset();
+	FrontRoundResult.Reset();
+	BackRoundResult.Reset();
+	SimulatedMammals.Reset();
+	PipelineBookkeepingBytes = 0;
+	NumSteppedSimulationRounds = 0;
+	bIsWaitingForSimulatedRound = false;
+	bIsPipelineActive = false;
+	bIsPresentingRound = false;
+}
+
+void ATBTurnedBasedManager::LaunchNextSimulatedRound()
+{
+	// StartNextRound stops at the same condition, so a started round always has its result
+	if(SimulationCore.GetNumCats() <= 0 || SimulationCore.GetNumMice() <= 0) return;
+
+	// the previous task is joined, so the worker's buffers can be measured before it writes them again
+	PipelineBookkeepingBytes = SimulationCore.GetAllocatedSize() + FrontRoundResult.GetAllocatedSize() + BackRoundResult.GetAllocatedSize();
+
+	PendingRoundTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]
+	{
+		SimulationCore.StepRound(BackRoundResult);
+	});
+}
+
+void ATBTurnedBasedManager::PresentRoundResult(const FTBRoundResult& Result)
+{
+	// moves the actor and its tile to the new tile and animates it there
+	auto MoveMammal = [this](ATBMammalBase* Mammal, const FTBTileHandle TargetTile)
+	{
+		SquareMapGeneratorRef->ClearTile(Mammal->GetCurrentTile());
+		Mammal->SetCurrentTile(TargetTile);
+		SquareMapGeneratorRef->SetTileOccupant(TargetTile, Mammal->Handle, Mammal->Species);
+
+		FVector TargetLocation = SquareMapGeneratorRef->GetTileWorldLocation(TargetTile);
+		TargetLocation.Z = Mammal->GetActorLocation().Z;
+		MovementSystem.AddMove(Mammal, TargetLocation, Mammal->MoveInterpSpeed, false);
+	};
+
+	// events are replayed in simulation order, so the map goes through the same states as the core
+	for(const FTBRoundEvent& Event : Result.Events)
+	{
+		ATBMammalBase* Mammal = SimulatedMammals.FindRef(Event.MammalId);
+		switch(Event.Type)
+		{
+		case ETBRoundEventType::Move:
+			if(Mammal)
+			{
+				MoveMammal(Mammal, Event.Tile);
+			}
+			break;
+		case ETBRoundEventType::Eat:
+			if(ATBMammalBase* Victim = SimulatedMammals.FindRef(Event.OtherMammalId))
+			{
+				Mice.Remove(Victim);
+				SimulatedMammals.Remove(Event.OtherMammalId);
+				DestroyMammal(Victim);
+			}
+			if(Mammal)
+			{
+				MoveMammal(Mammal, Event.Tile);
+			}
+			break;
+		case ETBRoundEventType::Birth:
+			if(const ATBMammalBase* Parent = SimulatedMammals.FindRef(Event.OtherMammalId))
+			{
+				ATBMammalBase* Child = SpawnMammal(Parent->Species, Event.Tile);
+				if(Child)
+				{
+					Child->MapGeneratorRef = SquareMapGeneratorRef;
+					Child->TurnBasedManagerRef = this;
+					Child->UpdateDebugWidget(SquareMapGeneratorRef->ShowDebug && SquareMapGeneratorRef->bUsePerMammalDebugWidgets);
+					SimulatedMammals.Add(Event.MammalId, Child);
+				}
+			}
+			break;
+		case ETBRoundEventType::Starve:
+			if(Mammal)
+			{
+				(Mammal->Species == ETBMammalSpecies::Cat ? Cats : Mice).Remove(Mammal);
+				SimulatedMammals.Remove(Event.MammalId);
+				DestroyMammal(Mammal);
+			}
+			break;
+		}
+	}
+
+	CurrentRoundStats.CatsBorn = Result.CatsBorn;
+	CurrentRoundStats.MiceBorn = Result.MiceBorn;
+	CurrentRoundStats.CatsStarved = Result.CatsStarved;
+	CurrentRoundStats.MiceStarved = Result.MiceStarved;
+	CurrentRoundStats.MiceEaten = Result.MiceEaten;
+
+	// the snapshot has the counters and the turn order of the core
+	Cats.Reset();
+	Mice.Reset();
+	for(const FTBMammalSnapshot& Snapshot : Result.Mammals)
+	{
+		if(ATBMammalBase* Mammal = SimulatedMammals.FindRef(Snapshot.Id))
+		{
+			Mammal->SetCounters(Snapshot.StarveCounter, Snapshot.BreedCounter, Snapshot.SavedBreedCounter);
+			(Snapshot.Species == ETBMammalSpecies::Cat ? Cats : Mice).Add(Mammal);
+		}
+	}
+
+	if(!MovementSystem.HasActiveMoves())
+	{
+		OnRoundFinished();
+		return;
+	}
+
+	bIsPresentingRound = true;
+	SetActorTickEnabled(true);
+}
+
+void ATBTurnedBasedManager::ResumeSimulation()
+{
+	if(!SimulationThread)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::ResumeSimulation -> There is no simulation thread!"));
+		return;
+	}
+	SimulationThread->StartRounds();
+	PollSimulatedRound();
+}
+
+void ATBTurnedBasedManager::PauseSimulation()
+{
+	if(!SimulationThread)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::PauseSimulation -> There is no simulation thread!"));
+		return;
+	}
+	SimulationThread->PauseRounds();
+	NumSteppedSimulationRounds = 0;
+}
+
+void ATBTurnedBasedManager::StepSimulation(const int Rounds)
+{
+	if(!SimulationThread)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATBTurnedBasedManager::StepSimulation -> There is no simulation thread!"));
+		return;
+	}
+	SimulationThread->StepRounds(Rounds);
+	NumSteppedSimulationRounds += FMath::Max(Rounds, 0);
+	PollSimulatedRound();
+}
+
+void ATBTurnedBasedManager::PollSimulatedRound()
+{
+	if(bIsWaitingForSimulatedRound)
+	{
+		TimerHandle_StartNextRound = GetWorldTimerManager().SetTimerForNextTick(this, &ATBTurnedBasedManager::StartNextRound);
+	}
+}
+
+void ATBTurnedBasedManager::ApplySimulationSettings()
+{
+	FTBSimulationSettings Settings;
+	if(!bIsPipelineActive || !MakeSimulationSettings(Settings)) return;
+
+	if(SimulationThread)
+	{
+		SimulationThread->SetSettings(Settings);
+		return;
+	}
+
+	// the worker owns the core while it runs
+	if(PendingRoundTask.IsValid())
+	{
+		PendingRoundTask.Wait();
+	}
+	SimulationCore.SetSettings(Settings);
+}
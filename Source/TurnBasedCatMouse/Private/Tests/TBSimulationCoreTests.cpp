@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TBTurnedBasedManager.h"
+#include "TBSimulationCore.h"
+#include "Mammals/TBMammalBase.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "TBTestActors.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static TAutoConsoleVariable<int32> CVarTBSimulationCoreTestConfigurations(
+	TEXT("TB.Tests.SimulationCoreConfigurations"),
+	2000,
+	TEXT("Number of randomized games TurnBasedCatMouse.SimulationCore.MatchesActorRules plays"));
+
+static TAutoConsoleVariable<int32> CVarTBSimulationCoreTestRounds(
+	TEXT("TB.Tests.SimulationCoreRounds"),
+	100,
+	TEXT("Max rounds of each game of TurnBasedCatMouse.SimulationCore.MatchesActorRules"));
+
+static TAutoConsoleVariable<int32> CVarTBSimulationCoreTestSeed(
+	TEXT("TB.Tests.SimulationCoreSeed"),
+	0,
+	TEXT("Seed of the configurations of TurnBasedCatMouse.SimulationCore.MatchesActorRules"));
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTBSimulationCoreMatchesActorsTest, "TurnBasedCatMouse.SimulationCore.MatchesActorRules",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * Plays randomized games with the actor rules and with FTBSimulationCore side by side, under the same random sequence,
+ * and checks after every round that both have the same population, counters, board and round stats.
+ * Map size, topology, spawn counts, starve and breed counts, processing order, hunting and evasion are randomized per game.
+ * Stops at the first divergence. The number of games, their rounds and the seed come from the TB.Tests.SimulationCore* variables.
+ */
+bool FTBSimulationCoreMatchesActorsTest::RunTest(const FString& Parameters)
+{
+	const int32 NumConfigurations = FMath::Max(CVarTBSimulationCoreTestConfigurations.GetValueOnGameThread(), 1);
+	const int32 MaxRounds = FMath::Max(CVarTBSimulationCoreTestRounds.GetValueOnGameThread(), 1);
+
+	// the games get their own world, nothing of a running game is touched
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+
+	// native test classes, the games don't depend on the game content
+	ATBTurnedBasedManager* Manager = World->SpawnActor<ATBTurnedBasedManager>();
+	Manager->SquareMapGenClass = ATBTestMapGenerator::StaticClass();
+	Manager->CatClass = ATBTestCat::StaticClass();
+	Manager->MouseClass = ATBTestMouse::StaticClass();
+	ATBMammalBase* CatDefaults = GetMutableDefault<ATBTestCat>();
+	ATBMammalBase* MouseDefaults = GetMutableDefault<ATBTestMouse>();
+
+	// the actor rounds have to run synchronously, and the rounds are never pipelined with instant moves
+	Manager->bInstantMoves = true;
+	Manager->bAutoStartNextRound = false;
+	Manager->bPipelineRounds = false;
+	Manager->bUseSimulationThread = false;
+	Manager->bExportTelemetry = false;
+	Manager->bEnableRoundHistory = false;
+
+	FRandomStream ConfigStream(CVarTBSimulationCoreTestSeed.GetValueOnGameThread());
+	FTBSimulationCore Core;
+	FTBRoundResult Result;
+	int32 VerifiedConfigurations = 0;
+	int32 VerifiedRounds = 0;
+	bool bAllMatched = true;
+
+	for(int32 Configuration = 0; Configuration < NumConfigurations && bAllMatched; Configuration++)
+	{
+		Manager->ResetTurnBasedGame();
+		FMath::RandInit(ConfigStream.RandRange(0, MAX_int32 - 1));
+
+		const int32 MapSize = ConfigStream.RandRange(2, 48);
+		const int32 NumTiles = MapSize * MapSize;
+		Manager->MapSizeOverride = MapSize;
+		Manager->GridTopologyOverride = static_cast<ETBGridTopology>(ConfigStream.RandRange(0, static_cast<int32>(ETBGridTopology::Num) - 1));
+		Manager->NumberOfCatsToSpawn = ConfigStream.RandRange(1, FMath::Max(NumTiles / 16, 1));
+		Manager->NumberOfMiceToSpawn = ConfigStream.RandRange(1, FMath::Max(NumTiles / 4, 1));
+		Manager->MammalProcessingOrder = ConfigStream.RandRange(0, 1) == 0 ? ETBMammalProcessingOrder::SpawnOrder : ETBMammalProcessingOrder::ZOrder;
+		Manager->ZOrderSortInterval = ConfigStream.RandRange(1, 10);
+		Manager->bEnableCatHunting = ConfigStream.RandRange(0, 1) == 1;
+		Manager->MaxHuntDistance = ConfigStream.RandRange(1, 64);
+		Manager->bEnableMouseEvasion = ConfigStream.RandRange(0, 1) == 1;
+		Manager->ThreatRadius = ConfigStream.RandRange(1, 8);
+		CatDefaults->StarvationTurnCount = ConfigStream.RandRange(1, 6);
+		CatDefaults->BreedTurnCount = ConfigStream.RandRange(1, 12);
+		MouseDefaults->BreedTurnCount = ConfigStream.RandRange(1, 6);
+		Manager->StartTurnBasedGame();
+
+		FTBSimulationSettings Settings;
+		if(!Manager->MakeSimulationSettings(Settings) || !Core.Initialize(Manager->SquareMapGeneratorRef, Settings, Manager->CurrentRound))
+		{
+			AddError(TEXT("The simulation core can't play the game of the test classes, nothing verified"));
+			bAllMatched = false;
+			break;
+		}
+
+		// both sides draw from the global random state, it is reseeded before each side plays the round
+		Core.SetUseGlobalRandom(true);
+		for(const TArray<ATBMammalBase*>* Mammals : {&Manager->Cats, &Manager->Mice})
+		{
+			for(const ATBMammalBase* Mammal : *Mammals)
+			{
+				Core.AddMammal(Mammal->Species, Mammal->GetCurrentTile(), Mammal->GetStarveCounter(), Mammal->GetBreedCounter(), Mammal->GetSavedBreedCounter());
+			}
+		}
+
+		FString Divergence;
+		Result.Reset();
+		Core.WriteSnapshot(Result);
+		if(!Manager->MatchesSimulationCore(Core, Result, Divergence))
+		{
+			AddError(FString::Printf(TEXT("Configuration %d diverged before round 1: %s"), Configuration, *Divergence));
+			bAllMatched = false;
+			break;
+		}
+
+		for(int32 Round = 0; Round < MaxRounds && Manager->Cats.Num() > 0 && Manager->Mice.Num() > 0; Round++)
+		{
+			const int32 RoundSeed = ConfigStream.RandRange(0, MAX_int32 - 1);
+			FMath::RandInit(RoundSeed);
+			Manager->StartNextRound();
+			FMath::RandInit(RoundSeed);
+			Core.StepRound(Result);
+			VerifiedRounds++;
+
+			if(!Manager->MatchesSimulationCore(Core, Result, Divergence))
+			{
+				AddError(FString::Printf(TEXT("Configuration %d (%dx%d %s map, %d cats, %d mice, cat starve %d breed %d, mouse breed %d, %s, sort interval %d, hunting %d/%d, evasion %d/%d, round seed %d) diverged in round %d: %s"),
+					Configuration, MapSize, MapSize, *UEnum::GetValueAsString(Manager->GridTopologyOverride.GetValue()), Manager->NumberOfCatsToSpawn, Manager->NumberOfMiceToSpawn,
+					CatDefaults->StarvationTurnCount, CatDefaults->BreedTurnCount, MouseDefaults->BreedTurnCount,
+					*UEnum::GetValueAsString(Manager->MammalProcessingOrder), Manager->ZOrderSortInterval, Manager->bEnableCatHunting, Manager->MaxHuntDistance,
+					Manager->bEnableMouseEvasion, Manager->ThreatRadius, RoundSeed, Manager->CurrentRound, *Divergence));
+				bAllMatched = false;
+				break;
+			}
+		}
+
+		if(bAllMatched)
+		{
+			VerifiedConfigurations++;
+		}
+	}
+	Core.Reset();
+
+	AddInfo(FString::Printf(TEXT("%d configurations and %d rounds matched"), VerifiedConfigurations, VerifiedRounds));
+
+	Manager->ResetTurnBasedGame();
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	return bAllMatched;
+}
+
+#endif
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Mammals/TBMammalBase.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "Engine/StaticMesh.h"
+#include "UObject/ConstructorHelpers.h"
+#include "TBTestActors.generated.h"
+
+// Actors the automation tests play with, so the tests don't depend on the game content
+
+// Map generator with the engine cube as tile and obstacle mesh
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class ATBTestMapGenerator : public ATBSquareMapGenerator
+{
+	GENERATED_BODY()
+public:
+	ATBTestMapGenerator()
+	{
+		static ConstructorHelpers::FObjectFinder<UStaticMesh> CubeMesh(TEXT("/Engine/BasicShapes/Cube.Cube"));
+		InstancedStaticMeshComponent->SetStaticMesh(CubeMesh.Object);
+		ObstacleMeshComponent->SetStaticMesh(CubeMesh.Object);
+	}
+};
+
+// Mouse of the tests, breeds and never starves
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class ATBTestMouse : public ATBMammalBase
+{
+	GENERATED_BODY()
+public:
+	ATBTestMouse()
+	{
+		StarvationTurnCount = 3;
+		BreedTurnCount = 3;
+		bCanEat = false;
+		bCanStarve = false;
+		bCanBreed = true;
+	}
+};
+
+// Cat of the tests, eats ATBTestMouse, breeds and starves
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class ATBTestCat : public ATBMammalBase
+{
+	GENERATED_BODY()
+public:
+	ATBTestCat()
+	{
+		EatableMammalClass = ATBTestMouse::StaticClass();
+		StarvationTurnCount = 3;
+		BreedTurnCount = 8;
+		bCanEat = true;
+		bCanStarve = true;
+		bCanBreed = true;
+	}
+};
@@ -5,9 +5,11 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "TBRoundArena.h"
 #include "TBMammalBase.generated.h"
 
 class ATBSquareMapGenerator;
+class ATBTurnedBasedManager;
 enum class EDirectionType : uint8;
 
 
@@ -31,6 +33,7 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Mammals")
 	UStaticMeshComponent* MammalMesh;
 	
+	// Class this mammal eats when the manager builds its species table from CatClass and MouseClass, a species table replaces it
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Mammals")
 	TSubclassOf<ATBMammalBase> EatableMammalClass;
 
@@ -55,9 +58,30 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Mammals")
 	FLinearColor CurrentTileColor;
 
+	// If true and the manager's prey distance field is built, moves step towards the nearest prey instead of a random tile
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Mammals")
+	bool bCanHunt;
+
+	// If true and the manager's threat influence map is built, mammals that can't eat move to the least threatened tile
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Mammals")
+	bool bCanEvade;
+
 public:
 	UPROPERTY(BlueprintReadOnly)
 	ATBSquareMapGenerator* MapGeneratorRef;
+
+	// Manager that owns this mammal, moves are interpolated by its movement system
+	UPROPERTY(BlueprintReadOnly)
+	ATBTurnedBasedManager* TurnBasedManagerRef;
+
+	// Set by the manager on spawn
+	ETBMammalSpecies Species;
+
+	// Species bits of the mammals this one eats, its row of the manager's predator-prey matrix. Set by the manager on spawn.
+	uint8 PreyMask;
+
+	// Handle of this mammal in the manager's slot array, set by the manager on spawn
+	FTBMammalHandle Handle;
 	
 
 protected:
@@ -65,12 +89,9 @@ protected:
 	virtual void BeginPlay() override;
 
 public:
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	void SetCurrentTile(const FTBTileHandle TargetTile);
 	
-	void SetCurrentTile(FTileInfo* TargetTile);
-	
-	FTileInfo* GetCurrentTile();
+	FTBTileHandle GetCurrentTile() const;
 
 	void ExecuteTurn();
 
@@ -84,6 +105,12 @@ public:
 	uint8 GetSavedBreedCounter() const { return SavedBreedCounter; } FORCEINLINE
 	
 	void SetSavedBreedCounter(const uint8 NewSavedBreed) {SavedBreedCounter = NewSavedBreed;}
+
+	// Overwrites the rule counters, used when the rules run in the manager's simulation core instead of the actor
+	void SetCounters(const uint8 NewStarveCounter, const uint8 NewBreedCounter, const uint8 NewSavedBreedCounter);
+
+	// Clears the tile, the counters and the events, called when the manager keeps the actor in its pool for a later spawn
+	void ResetForPool();
 public:
 	// Events
 	FOnStarvedSignature OnStarved;
@@ -97,35 +124,39 @@ public:
 private:
 
 	// Current tile of the mammal
-	FTileInfo* CurrentTile;
+	FTBTileHandle CurrentTile;
 	
 	// Eat target for this round
-	FTileInfo* EatTarget;
+	FTBTileHandle EatTarget;
 	
 	uint8 StarveCounter;
 	uint8 BreedCounter;
 	uint8 SavedBreedCounter;
-	FVector CurrentMoveTargetPosition;
-	bool bMoveStarted;
 	
 private:
+	// Movement system calls OnMoveFinished after the interpolation ends
+	friend struct FTBMammalMovementSystem;
+
 	/* If possible, starts movement logic that moves mammal 1 unit in a random direction (North, South, East, or West).
-	 * Movement will happen in Tick(). Which calls OnMoveFinished after movement ends.
+	 * Movement is interpolated by the manager's movement system. Which calls OnMoveFinished after movement ends.
 	 */
 	void StartRandomMove();
+
 	
 	/**
 	 * @brief Starts eat logic by moving to target mammal on TargetTile.
-	 * Movement will happen in Tick(). Which calls OnMoveFinished after movement ends.
+	 * Movement is interpolated by the manager's movement system. Which calls OnMoveFinished after movement ends.
 	 * @param EatTargetTile Target tile to eat
 	 */
-	void StartEat(const FTileInfo* EatTargetTile);
+	void StartEat(const FTBTileHandle EatTargetTile);
 
+	// Hands the move to the manager's movement system
+	void StartMoveTo(const FVector& TargetPosition);
 	
 	void OnMoveFinished(const bool bWasSuccessful);
 
-	// if there are any "EatableMammalClass" within 1 unit return the tile, otherwise nullptr
-	FTileInfo* GetRandomEatTarget() const;
+	// if there are any "EatableMammalClass" within 1 unit return the tile, otherwise an invalid handle
+	FTBTileHandle GetRandomEatTarget() const;
 	
 	void TryBreed();
 	void TryStarve();
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "TBMammalCluster.generated.h"
+
+class ATBMammalBase;
+
+/**
+ * Root of the garbage collection cluster of the manager's mammal actors. Reachability analysis checks the cluster
+ * as a single object instead of walking every actor and its components. Created and filled by ATBTurnedBasedManager.
+ * An actor of the cluster can't be destroyed on its own, destroying one dissolves the cluster at the next collection
+ * and the manager creates it again with RebuildIfDissolved.
+ */
+UCLASS(Transient)
+class TURNBASEDCATMOUSE_API UTBMammalCluster : public UObject
+{
+	GENERATED_BODY()
+public:
+	// Live and pooled actors of the cluster
+	UPROPERTY()
+	TArray<TObjectPtr<ATBMammalBase>> Mammals;
+
+	virtual bool CanBeClusterRoot() const override { return true; }
+
+	/**
+	 * @brief Adds the actor to the cluster, the cluster is created again if a collection dissolved it.
+	 * @param Mammal A newly spawned mammal actor that isn't in a cluster yet.
+	 */
+	void AddMammal(ATBMammalBase* Mammal);
+
+	// Takes the actor out of Mammals before it is destroyed, the cluster keeps it until the next collection dissolves it
+	void RemoveMammal(ATBMammalBase* Mammal);
+
+	// Creates the cluster again from Mammals if a collection dissolved it
+	void RebuildIfDissolved();
+};
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ATBMammalBase;
+
+/**
+ * Interpolates the movement of all mammals from a single place. Owned and ticked by ATBTurnedBasedManager.
+ * Only mammals with an active move are stored here, so idle mammals cost nothing per frame.
+ */
+struct TURNBASEDCATMOUSE_API FTBMammalMovementSystem
+{
+public:
+	/**
+	 * @brief Starts interpolating the given mammal towards TargetLocation.
+	 * ATBMammalBase::OnMoveFinished is called once the mammal reaches the target.
+	 * @param Mammal The mammal to move.
+	 * @param TargetLocation The world location to move to.
+	 * @param InterpSpeed Interpolation speed, see FMath::VInterpTo.
+	 * @param bNotifyMammal If false the move is only visual and OnMoveFinished is not called.
+	 */
+	void AddMove(ATBMammalBase* Mammal, const FVector& TargetLocation, const float InterpSpeed, const bool bNotifyMammal = true);
+
+	// Teleports the mammal to TargetLocation and finishes its move right away
+	void FinishMoveInstantly(ATBMammalBase* Mammal, const FVector& TargetLocation);
+
+	// Drops the active move of the given mammal without finishing it. Used when a mammal is destroyed.
+	void RemoveMove(const ATBMammalBase* Mammal);
+
+	// Updates all active moves, pushes the new locations and finishes the moves that reached their targets.
+	void Tick(const float DeltaTime);
+
+	// Drops all active moves and the per tick scratch arrays
+	void Reset();
+
+	FORCEINLINE bool HasActiveMoves() const { return Mammals.Num() > 0; }
+
+	FORCEINLINE int32 GetNumActiveMoves() const { return Mammals.Num(); }
+
+	FORCEINLINE SIZE_T GetAllocatedSize() const
+	{
+		return Mammals.GetAllocatedSize() + CurrentLocations.GetAllocatedSize() + TargetLocations.GetAllocatedSize() + InterpSpeeds.GetAllocatedSize()
+			+ NotifyMammals.GetAllocatedSize() + MoveIndices.GetAllocatedSize() + FinishedFlags.GetAllocatedSize() + FinishedMammals.GetAllocatedSize();
+	}
+
+private:
+	// Active moves are kept as parallel arrays so the interpolation loop only touches plain vectors
+	TArray<ATBMammalBase*> Mammals;
+	TArray<FVector> CurrentLocations;
+	TArray<FVector> TargetLocations;
+	TArray<float> InterpSpeeds;
+	TArray<bool> NotifyMammals;
+
+	// Index of the active move of each moving mammal, so restarting or removing a move doesn't search the arrays
+	TMap<const ATBMammalBase*, int32> MoveIndices;
+
+	// Reused every tick to avoid allocations
+	TArray<bool> FinishedFlags;
+	TArray<ATBMammalBase*> FinishedMammals;
+
+	// Moves are interpolated with ParallelFor only above this count, small batches are faster on a single thread.
+	// Only presented pipeline rounds move every mammal at once, actor turns are serialized and keep a single move active.
+	static constexpr int32 ParallelMoveThreshold = 512;
+};
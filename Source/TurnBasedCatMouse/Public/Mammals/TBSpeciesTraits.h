@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+
+/**
+ * What the built in cat and mouse species can be, known at compile time. Per species code is instantiated for each trait struct,
+ * so the turn loops don't look up classes or branch on the species of every mammal.
+ * Only the simulation core is written against these traits. The manager plays any species table from data, it only checks
+ * that a table fits the traits before handing it to the core and starves the species the traits starve. Species beyond cat and mouse have no traits.
+ * The mammal classes still tune the rules inside these limits: bCanEat, bCanStarve and bCanBreed can only turn a trait off.
+ */
+template<ETBMammalSpecies InSpecies>
+struct TTBSpeciesTraits;
+
+template<>
+struct TTBSpeciesTraits<ETBMammalSpecies::Cat>
+{
+	static constexpr ETBMammalSpecies Species = ETBMammalSpecies::Cat;
+
+	// Species bits of the mammals it may eat
+	static constexpr uint8 PreyMask = TBSpeciesBit(ETBMammalSpecies::Mouse);
+	static constexpr bool bCanEat = PreyMask != 0;
+
+	// Dies when its starve counter runs out, the manager listens to its OnStarved
+	static constexpr bool bCanStarve = true;
+	static constexpr bool bCanBreed = true;
+
+	// The manager listens to its OnKilled
+	static constexpr bool bCanBeEaten = false;
+};
+
+template<>
+struct TTBSpeciesTraits<ETBMammalSpecies::Mouse>
+{
+	static constexpr ETBMammalSpecies Species = ETBMammalSpecies::Mouse;
+
+	static constexpr uint8 PreyMask = 0;
+	static constexpr bool bCanEat = PreyMask != 0;
+
+	// The starve counter may still count, but a mouse never dies of it
+	static constexpr bool bCanStarve = false;
+	static constexpr bool bCanBreed = true;
+
+	static constexpr bool bCanBeEaten = true;
+};
+
+// True for the species that have traits
+constexpr bool TBIsBuiltInSpecies(const ETBMammalSpecies Species)
+{
+	return Species == ETBMammalSpecies::Cat || Species == ETBMammalSpecies::Mouse;
+}
+
+/**
+ * @brief Calls Functor with the trait struct of the species, e.g. Functor(TTBSpeciesTraits<ETBMammalSpecies::Cat>()).
+ * The only runtime branch on the species, everything inside the functor is specialized. The species must be built in.
+ */
+template<typename FunctorType>
+FORCEINLINE decltype(auto) TBVisitSpeciesTraits(const ETBMammalSpecies Species, FunctorType&& Functor)
+{
+	checkSlow(TBIsBuiltInSpecies(Species));
+	if(Species == ETBMammalSpecies::Cat)
+	{
+		return Functor(TTBSpeciesTraits<ETBMammalSpecies::Cat>());
+	}
+	return Functor(TTBSpeciesTraits<ETBMammalSpecies::Mouse>());
+}
+
+// PreyMask of the species' traits, 0 for a species without traits
+FORCEINLINE uint8 TBGetSpeciesPreyMask(const ETBMammalSpecies Species)
+{
+	if(!TBIsBuiltInSpecies(Species)) return 0;
+
+	return TBVisitSpeciesTraits(Species, [](auto Traits) { return decltype(Traits)::PreyMask; });
+}
+
+// bCanStarve of the species' traits, true for a species without traits so its classes decide alone
+FORCEINLINE bool TBCanSpeciesStarve(const ETBMammalSpecies Species)
+{
+	if(!TBIsBuiltInSpecies(Species)) return true;
+
+	return TBVisitSpeciesTraits(Species, [](auto Traits) { return decltype(Traits)::bCanStarve; });
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "SquareMapGeneration/TBGridTopology.h"
+#include "TBBakedMapAsset.generated.h"
+
+/**
+ * A map precomputed in the editor by ATBSquareMapGenerator::BakeMap: the walkability grid, the tile and obstacle instance
+ * locations and the border wall placements. GenerateSquareMap copies it instead of generating the terrain and the instances,
+ * as long as the generator's settings still match the ones it was baked with.
+ * Locations are relative to the first tile (0,0), so the generator can be placed anywhere.
+ */
+UCLASS(BlueprintType)
+class TURNBASEDCATMOUSE_API UTBBakedMapAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// Settings of the generator the map was baked with, SquareMapSize is the clamped one
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	int32 SquareMapSize = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	bool bUseSparseGrid = false;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	bool bUseMortonTileLayout = false;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	ETBGridTopology GridTopology = ETBGridTopology::Square4;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	float ObstacleDensity = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	float TerrainNoiseScale = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	int32 TerrainSeed = 0;
+
+	// Half extents of the tile mesh, a different mesh moves every tile
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Settings")
+	FVector TileHalfExtents = FVector::ZeroVector;
+
+	// Terrain thresholds and noise offset, streamed chunks still read the terrain of their obstacles
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Terrain")
+	float WaterThreshold = -1;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Terrain")
+	float RockThreshold = 1;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Terrain")
+	FVector2D TerrainNoiseOffset = FVector2D::ZeroVector;
+
+	// Middle of the map above the tiles, relative to the first tile
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Walls")
+	FVector SquareMapMiddle = FVector::ZeroVector;
+
+	// Location of each border wall relative to the first tile, the scale multiplies the wall's own scale
+	UPROPERTY(VisibleAnywhere, Category = "Baked Map|Walls")
+	TArray<FTransform> BorderWallPlacements;
+
+	// The arrays below can hold millions of elements, they are not properties and are bulk serialized
+
+	// ATBSquareMapGenerator::BlockWalkableMasks, empty if the map has no obstacles
+	TArray<uint64> BlockWalkableMasks;
+
+	// Number of obstacles of each block, same indices as the chunks
+	TArray<int32> BlockNumObstacles;
+
+	// Tile instance locations in instance order (Y * SquareMapSize + X). Empty for sparse maps, their tiles are streamed.
+	TArray<FVector> TileInstanceLocations;
+
+	// Obstacle instance locations with their terrain type as float. Empty for sparse maps.
+	TArray<FVector> ObstacleInstanceLocations;
+	TArray<float> ObstacleTerrainValues;
+
+	//~ Begin UObject Interface
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+	//~ End UObject Interface
+
+	// Memory of the bulk arrays
+	SIZE_T GetAllocatedSize() const;
+
+	// False if the asset was saved by a newer version of the game and its arrays could not be read
+	FORCEINLINE bool HasValidBakedData() const { return bHasValidBakedData; }
+
+private:
+	bool bHasValidBakedData = true;
+};
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "TBHandles.h"
+#include "TBDebugOverlayComponent.generated.h"
+
+class ATBSquareMapGenerator;
+class UCanvas;
+class APlayerController;
+
+// Counters shown by the debug overlay for a single mammal
+struct FTBMammalDebugCounters
+{
+	uint8 StarveCounter = 0;
+	uint8 BreedCounter = 0;
+	uint8 SavedBreedCounter = 0;
+};
+
+/**
+ * Draws the starve and breed counters of the mammals around the camera focus and under the cursor, when the owning
+ * map generator's ShowDebug is set. Counters are read from a flat buffer indexed by mammal handle that the manager
+ * fills once per round, so the cost depends on the number of visible tiles instead of the population.
+ */
+UCLASS(ClassGroup=(TurnBased))
+class TURNBASEDCATMOUSE_API UTBDebugOverlayComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTBDebugOverlayComponent();
+
+	// Counters are drawn for the tiles within this many tiles of the tile the camera looks at
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Debug Overlay", meta = (ClampMin=0))
+	int DebugTileRadius;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Debug Overlay")
+	FColor CatTextColor;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Debug Overlay")
+	FColor MouseTextColor;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Debug Overlay")
+	FColor HoveredTextColor;
+
+	// Stores the counters of the mammal, the buffer grows with the mammal slot array
+	void SetMammalCounters(const FTBMammalHandle Mammal, const FTBMammalDebugCounters& Counters);
+
+	// Drops all stored counters
+	void ResetMammalCounters();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Counters by mammal handle index
+	TArray<FTBMammalDebugCounters> MammalCounters;
+
+	FDelegateHandle DrawDelegateHandle;
+
+	// Called by the debug draw service every frame
+	void DrawOverlay(UCanvas* Canvas, APlayerController* PlayerController);
+
+	// Draws the counters of the mammal on the tile, if there is one
+	void DrawTileCounters(UCanvas* Canvas, APlayerController* PlayerController, const ATBSquareMapGenerator* MapGenerator, const FTBTileHandle Tile, const bool bIsHovered) const;
+};
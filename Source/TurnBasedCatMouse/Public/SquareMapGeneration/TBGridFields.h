@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TBHandles.h"
+
+class ATBSquareMapGenerator;
+
+/**
+ * Per tile distance, in steps over walkable tiles, to the nearest of a set of source tiles. Built once per round with a
+ * multi-source BFS that expands a whole wavefront in parallel, so any number of mammals can read it with O(1) lookups.
+ * Indexed by tile handle index, so it is only built for maps up to MaxMapSize.
+ */
+struct TURNBASEDCATMOUSE_API FTBDistanceField
+{
+public:
+	// Distance of the tiles that no source reaches within the max distance
+	static constexpr int32 Unreached = -1;
+
+	// A full map field is 4 bytes per tile, bigger maps are skipped
+	static constexpr int32 MaxMapSize = 4096;
+
+	/**
+	 * @brief Rebuilds the field for the current map.
+	 * @param Map The map to walk, obstacles block the BFS and mammals don't.
+	 * @param Sources Tiles with distance 0.
+	 * @param MaxDistance The BFS stops after this many waves, farther tiles stay Unreached. Values below 1 are used as 1.
+	 * @return False if the map is too big for a field.
+	 */
+	bool Build(const ATBSquareMapGenerator& Map, const TArray<FTBTileHandle>& Sources, const int32 MaxDistance);
+
+	// Drops the field, IsBuilt returns false afterwards. Memory is kept for the next build.
+	void Reset();
+
+	FORCEINLINE bool IsBuilt() const { return bIsBuilt; }
+
+	FORCEINLINE int32 GetDistance(const FTBTileHandle Tile) const { return Distances[Tile.GetIndex()]; }
+
+	/**
+	 * @brief Removes the tiles that are not the closest to the sources, the order of the kept tiles does not change.
+	 * Leaves the tiles untouched if none of them is reached or none of them gets closer than CurrentTile.
+	 * @param Tiles Any array with Num, operator[] and a shrinking SetNum, e.g. a TTBArenaArray.
+	 */
+	template<typename ArrayType>
+	void KeepClosestTiles(const FTBTileHandle CurrentTile, ArrayType& Tiles) const
+	{
+		const int32 CurrentDistance = GetDistance(CurrentTile);
+		int32 BestDistance = Unreached;
+		for(int32 i = 0; i < Tiles.Num(); i++)
+		{
+			const int32 Distance = GetDistance(Tiles[i]);
+			if(Distance != Unreached && (BestDistance == Unreached || Distance < BestDistance))
+			{
+				BestDistance = Distance;
+			}
+		}
+
+		// nothing in range or no tile gets closer, the move stays random
+		if(BestDistance == Unreached || (CurrentDistance != Unreached && BestDistance >= CurrentDistance)) return;
+
+		int32 NumKept = 0;
+		for(int32 i = 0; i < Tiles.Num(); i++)
+		{
+			if(GetDistance(Tiles[i]) == BestDistance)
+			{
+				Tiles[NumKept++] = Tiles[i];
+			}
+		}
+		Tiles.SetNum(NumKept);
+	}
+
+	FORCEINLINE SIZE_T GetAllocatedSize() const { return Distances.GetAllocatedSize() + Frontier.GetAllocatedSize() + NextFrontier.GetAllocatedSize(); }
+
+private:
+	TArray<int32> Distances;
+
+	// Tiles of the current and the next wave, sized to the map once so waves never allocate
+	TArray<FTBTileHandle> Frontier;
+	TArray<FTBTileHandle> NextFrontier;
+
+	bool bIsBuilt = false;
+
+	// Waves smaller than this are expanded on a single thread
+	static constexpr int32 ParallelWaveThreshold = 1024;
+};
+
+/**
+ * Per tile influence of a set of source tiles, each source adds 1 to every tile in a (2 * Radius + 1) square box around it.
+ * Built once per round with a separable box blur: a running sum along the rows, then a running sum down the columns
+ * that processes 4 columns per SIMD register. Lookups are O(1), so the cost per mammal does not depend on the population.
+ * Works on tile coordinates, so obstacles don't block the influence and hex maps get an approximation.
+ */
+struct TURNBASEDCATMOUSE_API FTBInfluenceMap
+{
+public:
+	// A full map is 8 bytes per tile while building, bigger maps are skipped
+	static constexpr int32 MaxMapSize = 4096;
+
+	/**
+	 * @brief Rebuilds the influence map for the current map.
+	 * @param Map The map the source tiles belong to.
+	 * @param Sources Tiles that spread influence, a tile can be a source more than once.
+	 * @param Radius Number of tiles the influence spreads in each direction. Values below 1 are used as 1.
+	 * @return False if the map is too big.
+	 */
+	bool Build(const ATBSquareMapGenerator& Map, const TArray<FTBTileHandle>& Sources, const int32 Radius);
+
+	// Drops the map, IsBuilt returns false afterwards. Memory is kept for the next build.
+	void Reset();
+
+	FORCEINLINE bool IsBuilt() const { return bIsBuilt; }
+
+	FORCEINLINE float GetInfluence(const FTBTileHandle Tile) const { return Influence[Tile.GetIndex()]; }
+
+	/**
+	 * @brief Removes the tiles that don't have the lowest influence, all tiles are kept if they have the same influence.
+	 * @param Tiles Any array with Num, operator[] and a shrinking SetNum, e.g. a TTBArenaArray.
+	 */
+	template<typename ArrayType>
+	void KeepLeastInfluencedTiles(ArrayType& Tiles) const
+	{
+		float LeastInfluence = TNumericLimits<float>::Max();
+		for(int32 i = 0; i < Tiles.Num(); i++)
+		{
+			LeastInfluence = FMath::Min(LeastInfluence, GetInfluence(Tiles[i]));
+		}
+
+		// influences are whole source counts, so equal tiles compare equal
+		int32 NumKept = 0;
+		for(int32 i = 0; i < Tiles.Num(); i++)
+		{
+			if(GetInfluence(Tiles[i]) == LeastInfluence)
+			{
+				Tiles[NumKept++] = Tiles[i];
+			}
+		}
+		Tiles.SetNum(NumKept);
+	}
+
+	FORCEINLINE SIZE_T GetAllocatedSize() const { return Influence.GetAllocatedSize() + RowSums.GetAllocatedSize(); }
+
+private:
+	// Splatted sources, then the final influence
+	TArray<float> Influence;
+
+	// Result of the horizontal pass
+	TArray<float> RowSums;
+
+	bool bIsBuilt = false;
+};
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TBGridTopology.generated.h"
+
+// Neighbourhood and layout of the tiles of a map. Tiles are always stored by (X,Y) coordinates, only the neighbours and world locations change.
+UENUM(BlueprintType)
+enum class ETBGridTopology : uint8
+{
+	// Square tiles with north, south, west and east neighbours
+	Square4,
+	// Square tiles with the diagonal neighbours too
+	Square8,
+	// Pointy top hexagons, odd rows are shifted right by half a tile
+	Hex,
+
+	Num UMETA(Hidden)
+};
+
+// Compass directions, each topology maps them to one of its neighbours
+enum class EDirectionType : uint8
+{
+	North,
+	South,
+	East,
+	West
+};
+
+/**
+ * Compile time description of a topology. Neighbour offsets are indexed by the parity of the row, so hex rows need no branch
+ * and square topologies just repeat the same table. Every specialization has the same members.
+ */
+template<ETBGridTopology Topology>
+struct TTBGridTopology;
+
+template<>
+struct TTBGridTopology<ETBGridTopology::Square4>
+{
+	static constexpr int32 NumNeighbours = 4;
+
+	// North, south, west, east, the order the original direction loop used
+	static constexpr int8 Offsets[2][NumNeighbours][2] =
+	{
+		{ {0, 1}, {0, -1}, {-1, 0}, {1, 0} },
+		{ {0, 1}, {0, -1}, {-1, 0}, {1, 0} }
+	};
+
+	// Neighbour index of each EDirectionType
+	static constexpr int8 DirectionNeighbours[4] = { 0, 1, 3, 2 };
+
+	// Distance between rows and shift of odd rows, in tile sizes
+	static constexpr float RowSpacing = 1.f;
+	static constexpr float OddRowShift = 0.f;
+};
+
+template<>
+struct TTBGridTopology<ETBGridTopology::Square8>
+{
+	static constexpr int32 NumNeighbours = 8;
+
+	// Square4 neighbours first, then the diagonals
+	static constexpr int8 Offsets[2][NumNeighbours][2] =
+	{
+		{ {0, 1}, {0, -1}, {-1, 0}, {1, 0}, {-1, 1}, {1, 1}, {-1, -1}, {1, -1} },
+		{ {0, 1}, {0, -1}, {-1, 0}, {1, 0}, {-1, 1}, {1, 1}, {-1, -1}, {1, -1} }
+	};
+
+	static constexpr int8 DirectionNeighbours[4] = { 0, 1, 3, 2 };
+
+	static constexpr float RowSpacing = 1.f;
+	static constexpr float OddRowShift = 0.f;
+};
+
+template<>
+struct TTBGridTopology<ETBGridTopology::Hex>
+{
+	static constexpr int32 NumNeighbours = 6;
+
+	// East, west, then the two neighbours in the previous and the next row, which depend on the row parity
+	static constexpr int8 Offsets[2][NumNeighbours][2] =
+	{
+		{ {1, 0}, {-1, 0}, {0, -1}, {-1, -1}, {0, 1}, {-1, 1} },
+		{ {1, 0}, {-1, 0}, {1, -1}, {0, -1}, {1, 1}, {0, 1} }
+	};
+
+	// there is no tile straight north or south, those go to the east one of the two neighbours in the next or previous row
+	static constexpr int8 DirectionNeighbours[4] = { 4, 2, 0, 1 };
+
+	// rows of pointy top hexagons overlap by a quarter
+	static constexpr float RowSpacing = 0.75f;
+	static constexpr float OddRowShift = 0.5f;
+};
+
+// Max neighbour count of the topologies from TopologyIndex on, a topology without a specialization fails to compile here
+template<uint8 TopologyIndex = 0>
+constexpr int32 TBGetMaxGridNeighbours()
+{
+	constexpr int32 NumNeighbours = TTBGridTopology<static_cast<ETBGridTopology>(TopologyIndex)>::NumNeighbours;
+	if constexpr(TopologyIndex + 1 < static_cast<uint8>(ETBGridTopology::Num))
+	{
+		return FMath::Max(NumNeighbours, TBGetMaxGridNeighbours<TopologyIndex + 1>());
+	}
+	else
+	{
+		return NumNeighbours;
+	}
+}
+
+// Max neighbour count of all topologies, the capacity to use for fixed size adjacency arrays
+static constexpr int32 TBMaxGridNeighbours = TBGetMaxGridNeighbours();
+
+/**
+ * @brief Calls Func with the topology's TTBGridTopology specialization, so the caller's loop is compiled once per topology.
+ * @param Topology The runtime topology to dispatch on.
+ * @param Func Generic lambda taking a TTBGridTopology value, e.g. [&](auto TopologyTraits) { ... }.
+ */
+template<typename FuncType>
+FORCEINLINE decltype(auto) DispatchGridTopology(const ETBGridTopology Topology, FuncType&& Func)
+{
+	switch(Topology)
+	{
+	case ETBGridTopology::Square8:
+		return Func(TTBGridTopology<ETBGridTopology::Square8>());
+	case ETBGridTopology::Hex:
+		return Func(TTBGridTopology<ETBGridTopology::Hex>());
+	default:
+		return Func(TTBGridTopology<ETBGridTopology::Square4>());
+	}
+}
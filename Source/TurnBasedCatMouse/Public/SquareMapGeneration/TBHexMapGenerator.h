@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "TBHexMapGenerator.generated.h"
+
+/**
+ * Generates a hexagonal map. Storage, chunking, streaming and the mammal rules are shared with ATBSquareMapGenerator,
+ * only the topology is fixed to hex, so every tile has 6 neighbours and odd rows are shifted by half a tile.
+ * The tile mesh should be a pointy top hexagon that fits in the bounds of the square tile.
+ */
+UCLASS()
+class TURNBASEDCATMOUSE_API ATBHexMapGenerator : public ATBSquareMapGenerator
+{
+	GENERATED_BODY()
+
+public:
+	ATBHexMapGenerator();
+
+	virtual bool GenerateSquareMap() override;
+};
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Z-order (Morton) curve helpers. Tiles that are close on the map get close codes, so walking them in code order stays cache friendly.
+struct FTBMorton
+{
+	// Spreads the low 16 bits of Value so there is a zero bit between each of them
+	static FORCEINLINE uint32 Part1By1(uint32 Value)
+	{
+		Value &= 0x0000FFFF;
+		Value = (Value | (Value << 8)) & 0x00FF00FF;
+		Value = (Value | (Value << 4)) & 0x0F0F0F0F;
+		Value = (Value | (Value << 2)) & 0x33333333;
+		Value = (Value | (Value << 1)) & 0x55555555;
+		return Value;
+	}
+
+	// Gathers the even bits of Value into the low 16 bits, the inverse of Part1By1
+	static FORCEINLINE uint32 Compact1By1(uint32 Value)
+	{
+		Value &= 0x55555555;
+		Value = (Value | (Value >> 1)) & 0x33333333;
+		Value = (Value | (Value >> 2)) & 0x0F0F0F0F;
+		Value = (Value | (Value >> 4)) & 0x00FF00FF;
+		Value = (Value | (Value >> 8)) & 0x0000FFFF;
+		return Value;
+	}
+
+	// Interleaves the coordinates, X in the even bits and Y in the odd bits. Coordinates must fit in 16 bits.
+	static FORCEINLINE uint32 Encode(const uint32 X, const uint32 Y)
+	{
+		return Part1By1(X) | (Part1By1(Y) << 1);
+	}
+
+	// Coordinates of a code made by Encode
+	static FORCEINLINE FIntPoint Decode(const uint32 Code)
+	{
+		return FIntPoint(Compact1By1(Code), Compact1By1(Code >> 1));
+	}
+};
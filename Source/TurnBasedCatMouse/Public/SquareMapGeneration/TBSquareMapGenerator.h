@@ -4,33 +4,139 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "TBHandles.h"
+#include "SquareMapGeneration/TBMorton.h"
+#include "SquareMapGeneration/TBGridTopology.h"
 #include "TBSquareMapGenerator.generated.h"
 
-enum class EDirectionType : uint8
+// Species of a mammal, stored on the tiles and used for the block occupancy summaries.
+// Cat and Mouse are the built in species, a species table on the manager can add more as the values after them.
+enum class ETBMammalSpecies : uint8
 {
-	North,
-	South,
-	East,
-	West
+	Cat,
+	Mouse,
+
+	// rows 2 and up of the species table, their rules come from the table only
+	Species2,
+	Species3,
+	Species4,
+	Species5,
+	Species6,
+	Species7,
+
+	Num
+};
+
+// Max number of species in a game, species masks are a byte
+static constexpr int32 TBMaxSpecies = static_cast<int32>(ETBMammalSpecies::Num);
+static_assert(TBMaxSpecies <= 8, "Species masks are a byte");
+
+// Bit of the species in a species mask
+constexpr uint8 TBSpeciesBit(const ETBMammalSpecies Species) { return static_cast<uint8>(1u << static_cast<uint8>(Species)); }
+
+// Terrain of a tile. Only Ground is walkable, the others are obstacles.
+UENUM(BlueprintType)
+enum class ETBTerrainType : uint8
+{
+	Ground,
+	Rock,
+	Water
 };
 
 // forward declarations
 class UHierarchicalInstancedStaticMeshComponent;
-class ATBMammalBase;
+class UTBDebugOverlayComponent;
+class UTBTileHeatmapComponent;
+class UTBBakedMapAsset;
 
+// State of a single tile. Coordinates and world location are derived from the tile handle, so tiles stay small.
 USTRUCT()
 struct FTileInfo
 {
 	GENERATED_BODY()
 public:
-	FVector2D Pos2D;
-	FVector WordLocation;
-	bool bIsEmptyTile;
-	
-	UPROPERTY()
-	ATBMammalBase* MammalRef;
+	// Mammal standing on this tile, invalid if the tile is empty
+	FTBMammalHandle Mammal;
+
+	// Species of Mammal, only meaningful if the tile is not empty
+	ETBMammalSpecies Species = ETBMammalSpecies::Cat;
+
+	FORCEINLINE bool IsEmpty() const { return !Mammal.IsValid(); }
+};
+
+// Tiles are allocated, simulated and rendered in square chunks of TileChunkSize x TileChunkSize
+static constexpr int32 TileChunkSize = 32;
+
+// Number of 64 bit words of a per chunk tile bit mask
+static constexpr int32 TileChunkMaskWords = TileChunkSize * TileChunkSize / 64;
+
+struct FTBTileChunk
+{
+	// Tiles of the chunk, indexed by ATBSquareMapGenerator::GetLocalIndexOfTile. Tiles outside of the map are never used.
+	TArray<FTileInfo> Tiles;
+
+	// Bit per tile, set if a mammal stands on it. Same indices as Tiles.
+	uint64 OccupiedMask[TileChunkMaskWords] = {};
+
+	// One occupancy layer per species, so species queries are mask tests too. Same indices as Tiles.
+	uint64 SpeciesMasks[TBMaxSpecies][TileChunkMaskWords] = {};
+};
+
+// Occupancy counts of a TileChunkSize x TileChunkSize block. Kept for every block, allocated or not.
+struct FTBBlockSummary
+{
+	// Walkable tiles without a mammal
+	int32 NumEmptyTiles = 0;
+	int32 NumObstacles = 0;
+	int32 NumMammals = 0;
+
+	// A block has at most TileChunkSize * TileChunkSize mammals
+	uint16 NumMammalsOfSpecies[TBMaxSpecies] = {};
+
+	FORCEINLINE int32 GetNumMammals() const { return NumMammals; }
 };
 
+// Queued change of a dense tile instance, applied by ATBSquareMapGenerator::FlushTileInstanceUpdates
+struct FTBPendingTileTransform
+{
+	int32 InstanceIndex = INDEX_NONE;
+	FTransform Transform;
+};
+
+struct FTBPendingTileCustomData
+{
+	int32 InstanceIndex = INDEX_NONE;
+	int32 DataIndex = 0;
+	float Value = 0;
+};
+
+// Previous state of a tile, appended to the tile journal of the map generator on every occupancy change
+struct FTBTileDelta
+{
+	FTBTileHandle Tile;
+	FTBMammalHandle OldMammal;
+	ETBMammalSpecies OldSpecies = ETBMammalSpecies::Cat;
+};
+
+// Live memory of a map by subsystem, see ATBSquareMapGenerator::GetMemoryStats
+struct FTBMapMemoryStats
+{
+	int64 NumTiles = 0;
+	int32 NumAllocatedChunks = 0;
+
+	// Chunk pointer array and the allocated chunks with their tiles
+	SIZE_T TileChunkBytes = 0;
+
+	// Block summaries, block row counts and walkability masks
+	SIZE_T BlockSummaryBytes = 0;
+
+	// Instance data of the tile mesh components, including the streamed chunk pool
+	SIZE_T TileMeshBytes = 0;
+
+	SIZE_T HeatmapBytes = 0;
+
+	FORCEINLINE SIZE_T GetTotalBytes() const { return TileChunkBytes + BlockSummaryBytes + TileMeshBytes + HeatmapBytes; }
+};
 
 UCLASS()
 class TURNBASEDCATMOUSE_API ATBSquareMapGenerator : public AActor
@@ -43,6 +149,18 @@ public:
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squara Map Generation")
 	UHierarchicalInstancedStaticMeshComponent* InstancedStaticMeshComponent;
+
+	// Renders the obstacle tiles, the terrain type is passed to the material as the first custom data float
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squara Map Generation")
+	UHierarchicalInstancedStaticMeshComponent* ObstacleMeshComponent;
+
+	// Draws mammal counters around the camera focus when ShowDebug is true
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squara Map Generation")
+	UTBDebugOverlayComponent* DebugOverlayComponent;
+
+	// Writes the board state into a texture sampled by the tile material, once per round
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squara Map Generation")
+	UTBTileHeatmapComponent* TileHeatmapComponent;
 	
 	// Wall class to spawn (it should be the same size as TileClass)
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Square Map Generation")
@@ -54,23 +172,274 @@ public:
 	
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation")
 	bool ShowDebug;
+
+	// If true, ShowDebug also enables the debug widget of every mammal. Slow on big populations, DebugOverlayComponent is used otherwise.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation")
+	bool bUsePerMammalDebugWidgets;
+
+	/* If true, tile chunks are allocated only when they are used and freed again when no mammal stands on them,
+	 * and tile meshes are streamed in around the camera instead of instancing the whole map.
+	 * Required for maps bigger than 999x999.
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation|Sparse Grid")
+	bool bUseSparseGrid;
+
+	// Number of chunks rendered around the camera chunk in each direction when bUseSparseGrid is true
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation|Sparse Grid", meta = (ClampMin=0))
+	int RenderChunkRadius;
+
+	// If true, tiles inside a chunk are stored in Z-order (Morton) instead of row by row, so neighbours share cache lines more often
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation")
+	bool bUseMortonTileLayout;
+
+	// Neighbourhood and tile layout of the generated map, mammals use whatever adjacency the topology gives them
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation")
+	ETBGridTopology GridTopology;
+
+	// Approximate fraction of the tiles that become obstacles, half rock and half water. 0 disables the terrain layer.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation|Terrain", meta = (ClampMin=0, ClampMax=1))
+	float ObstacleDensity;
+
+	// Scale of the noise the terrain is generated from, smaller values give bigger lakes and rock fields
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation|Terrain", meta = (ClampMin=0.001))
+	float TerrainNoiseScale;
+
+	// Same seed gives the same terrain, the terrain never uses the global random stream
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation|Terrain")
+	int TerrainSeed;
+
+	/* Map baked in the editor with BakeMap. If it was baked with the current settings and tile mesh, GenerateSquareMap copies
+	 * the grid, the instances and the wall placements from it instead of generating them. Otherwise the map is generated at runtime.
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Square Map Generation|Baking")
+	UTBBakedMapAsset* BakedMap;
+
+	// GenerateSquareMap logs a warning if the estimated memory of the map is above this
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Square Map Generation", meta = (ClampMin=0))
+	float MapMemoryBudgetMB;
+
+	// Max SquareMapSize when bUseSparseGrid is true
+	static constexpr int32 MaxSparseSquareMapSize = 16384;
+
+	// Rough size of an instance in the tile mesh components, game thread data plus the render copy
+	static constexpr int32 EstimatedBytesPerTileInstance = sizeof(FMatrix) * 2;
 	
 private:
 	FVector TileHalfExtents;
 	FVector SquareMapMiddle;
 
-	// 2d array of all the tiles
-	TArray<TArray<FTileInfo*>> Tiles;
+	// Location of the first tile (0,0)
+	FVector MapStartLocation;
+
+	// Number of chunks in each row and column of the map
+	int32 NumChunksPerSide;
+
+	// Unique across all generators and incremented on each GenerateSquareMap, tile handles of a previous map fail to resolve
+	FTBTileHandle::StorageType MapGeneration;
+
+	// bUseMortonTileLayout of the current map, the layout can't change until the map is regenerated
+	bool bIsMortonTileLayout;
+
+	// GridTopology of the current map
+	ETBGridTopology MapTopology;
+
+	// Terrain settings of the current map, the terrain can't change until the map is regenerated
+	float MapObstacleDensity;
+	float MapTerrainNoiseScale;
+	FVector2D TerrainNoiseOffset;
+
+	// Noise values below WaterThreshold are water and above RockThreshold are rock, picked so ObstacleDensity of the tiles are obstacles
+	float WaterThreshold;
+	float RockThreshold;
+
+	// Walkability bit per tile, TileChunkMaskWords words per block with the same indices as the chunk tiles.
+	// Empty if the map has no obstacles, then every tile is walkable.
+	TArray<uint64> BlockWalkableMasks;
+
+	// Mesh components rendering the obstacles of the streamed chunks in sparse mode, same indices as ChunkMeshComponentPool
+	UPROPERTY()
+	TArray<UHierarchicalInstancedStaticMeshComponent*> ChunkObstacleComponentPool;
+
+	// World distance between rows and world shift of odd rows of the current map, from the topology
+	float RowSpacing;
+	float OddRowShift;
+
+	// Walls spawned by SpawnBorderWalls, destroyed on regeneration
+	UPROPERTY()
+	TArray<AActor*> BorderWalls;
+
+	// All chunks of the map, indexed by ChunkY * NumChunksPerSide + ChunkX. Unallocated chunks are nullptr and completely empty.
+	TArray<TUniquePtr<FTBTileChunk>> Chunks;
+
+	// Indices of the allocated chunks, so per round work scales with the used area instead of the map size
+	TArray<int32> AllocatedChunkIndices;
+
+	// Occupancy summary of each block, blocks are the same as chunks and use the same index
+	TArray<FTBBlockSummary> BlockSummaries;
+
+	// Sum of NumEmptyTiles for each row of blocks, used to pick random empty tiles hierarchically
+	TArray<int32> BlockRowEmptyTiles;
+
+	// Number of empty tiles on the whole map
+	int32 TotalEmptyTiles;
+
+	// Mesh components used to stream chunks around the camera in sparse mode
+	UPROPERTY()
+	TArray<UHierarchicalInstancedStaticMeshComponent*> ChunkMeshComponentPool;
+
+	// Number of tiles (X,Y) instanced by each component in ChunkMeshComponentPool, edge chunks can be smaller
+	TArray<FIntPoint> ChunkMeshComponentLayouts;
+
+	// Chunk index to index in ChunkMeshComponentPool, for all currently streamed in chunks
+	TMap<int32, int32> StreamedChunkMeshComponents;
 
-	// holding all the tiles as 1d array
-	TArray<FTileInfo*> AllTiles;
+	// Indices in ChunkMeshComponentPool that are not used by any chunk
+	TArray<int32> FreeChunkMeshComponents;
 
-	// Spawns border walls. WallClass must be valid
-	void SpawnBorderWalls();
+	// Chunk the camera was on during the last streaming update
+	FIntPoint LastCameraChunk;
+
+	// Tile instance changes queued since the last flush, in the order they were made
+	TArray<FTBPendingTileTransform> PendingTileTransforms;
+	TArray<FTBPendingTileCustomData> PendingTileCustomData;
+
+	bool bIsTileInstanceFlushScheduled;
+
+	// Occupancy changes are appended here while it is set, see SetTileJournal
+	TArray<FTBTileDelta>* TileJournal;
+
+	// Clears the grid and sets up the chunks and the block summaries of an empty map with the first tile at StartLocation
+	void InitializeMapGrid(const FVector& StartLocation);
+
+	// True if BakedMap was baked with the settings of the current map. InitializeMapGrid must have been called.
+	bool CanUseBakedMap() const;
+
+	// Copies the walkability masks and the obstacle counts from BakedMap, the baked GenerateWalkableMasks
+	void LoadBakedWalkableMasks();
+
+	// Location of every tile relative to the first tile, in instance order
+	void BuildTileInstanceLocations(TArray<FVector>& OutLocations) const;
+
+	// Adds or reuses the dense tile instances so there is one per tile, instance index = Y * SquareMapSize + X.
+	// Locations are relative to the first tile.
+	void UpdateDenseTileInstances(const TArray<FVector>& Locations);
+
+	// Flushes the queued tile instance changes on the next tick, at most once per frame
+	void ScheduleTileInstanceFlush();
+
+	// Middle of the map and the border wall placements, relative to the first tile. The scale multiplies the wall's own scale.
+	void GetBorderWallPlacements(FVector& OutMapMiddle, TArray<FTransform>& OutPlacements) const;
+
+	// Spawns border walls at the placements. WallClass must be valid
+	void SpawnBorderWalls(const TArray<FTransform>& Placements);
+
+	// Builds the walkability masks from the terrain and removes the obstacles from the block summaries
+	void GenerateWalkableMasks();
+
+	// Location relative to the first tile and terrain of each obstacle tile in the given tile range
+	void GetObstacleInstances(const FIntPoint& MinTile, const FIntPoint& MaxTile, TArray<FVector>& OutLocations, TArray<float>& OutTerrainValues) const;
+
+	// Adds an obstacle instance for each obstacle tile in the given tile range
+	void AddObstacleInstances(UHierarchicalInstancedStaticMeshComponent* MeshComponent, const FIntPoint& MinTile, const FIntPoint& MaxTile) const;
+
+	// Adds the obstacle instances in one batch, locations are relative to the first tile
+	void AddObstacleInstances(UHierarchicalInstancedStaticMeshComponent* MeshComponent, const TArray<FVector>& Locations, const TArray<float>& TerrainValues) const;
+
+	// Bits of the tiles that are walkable and have no mammal, for one word of a block mask
+	FORCEINLINE uint64 GetEmptyTileBits(const int32 ChunkIndex, const int32 Word) const
+	{
+		const uint64 Walkable = BlockWalkableMasks.Num() > 0 ? BlockWalkableMasks[ChunkIndex * TileChunkMaskWords + Word] : ~0ull;
+		const FTBTileChunk* Chunk = Chunks[ChunkIndex].Get();
+		return Chunk ? Walkable & ~Chunk->OccupiedMask[Word] : Walkable;
+	}
+
+	// Bits of the tiles with a mammal of one of the species in SpeciesMask, for one word of a block mask
+	FORCEINLINE uint64 GetSpeciesTileBits(const int32 ChunkIndex, const int32 Word, uint8 SpeciesMask) const
+	{
+		const FTBTileChunk* Chunk = Chunks[ChunkIndex].Get();
+		if(!Chunk) return 0;
+
+		uint64 Bits = 0;
+		while(SpeciesMask != 0)
+		{
+			Bits |= Chunk->SpeciesMasks[FMath::CountTrailingZeros(SpeciesMask)][Word];
+			SpeciesMask &= SpeciesMask - 1;
+		}
+		return Bits;
+	}
+
+	// True if the tile at the coordinates is walkable and has no mammal, a single mask test
+	FORCEINLINE bool IsTileEmptyAt(const int32 X, const int32 Y) const
+	{
+		const int32 LocalIndex = GetLocalIndexOfTile(X, Y);
+		return (GetEmptyTileBits(GetChunkIndexOfTile(X, Y), LocalIndex / 64) >> (LocalIndex % 64)) & 1;
+	}
+
+	// Calls Func for each neighbour of the tile that is inside the map, in the order of the topology's offset table
+	template<typename TopologyType, typename FuncType>
+	FORCEINLINE void ForEachAdjacentTileOf(const FTBTileHandle SourceTile, FuncType& Func) const
+	{
+		const FIntPoint Coordinates = GetTileCoordinates(SourceTile);
+		const auto& Offsets = TopologyType::Offsets[Coordinates.Y & 1];
+		for(int32 i = 0; i < TopologyType::NumNeighbours; i++)
+		{
+			const FTBTileHandle TileResult = GetTileAt(Coordinates.X + Offsets[i][0], Coordinates.Y + Offsets[i][1]);
+			if(TileResult.IsValid())
+			{
+				Func(TileResult);
+			}
+		}
+	}
+
+	// Neighbour of the tile at the index of the topology's offset table, invalid if it is outside of the map
+	template<typename TopologyType>
+	FORCEINLINE FTBTileHandle GetAdjacentTileOf(const FTBTileHandle SourceTile, const int32 NeighbourIndex) const
+	{
+		const FIntPoint Coordinates = GetTileCoordinates(SourceTile);
+		const auto& Offset = TopologyType::Offsets[Coordinates.Y & 1][NeighbourIndex];
+		return GetTileAt(Coordinates.X + Offset[0], Coordinates.Y + Offset[1]);
+	}
+
+	// Allocates and initializes the chunk if it is not allocated yet
+	FTBTileChunk* GetOrAllocateChunk(const int32 ChunkX, const int32 ChunkY);
+
+	FORCEINLINE int32 GetChunkIndexOfTile(const int32 X, const int32 Y) const { return (Y / TileChunkSize) * NumChunksPerSide + (X / TileChunkSize); }
+
+	// Index of the tile inside its chunk's tile array
+	FORCEINLINE int32 GetLocalIndexOfTile(const int32 X, const int32 Y) const
+	{
+		return bIsMortonTileLayout ? FTBMorton::Encode(X % TileChunkSize, Y % TileChunkSize) : (Y % TileChunkSize) * TileChunkSize + (X % TileChunkSize);
+	}
+
+	// Coordinates inside its chunk of the tile at the local index, the inverse of GetLocalIndexOfTile
+	FORCEINLINE FIntPoint GetLocalTileCoordinates(const int32 LocalIndex) const
+	{
+		return bIsMortonTileLayout ? FTBMorton::Decode(LocalIndex) : FIntPoint(LocalIndex % TileChunkSize, LocalIndex / TileChunkSize);
+	}
+
+	// Returns the tile if the handle is valid and its chunk is allocated, otherwise nullptr
+	const FTileInfo* FindTile(const FTBTileHandle Tile) const;
+	FTileInfo* FindTile(const FTBTileHandle Tile);
+
+	// Allocates the tile's chunk if needed and returns the tile. Returns nullptr and ensures if the handle is stale or invalid.
+	FTileInfo* GetOrAllocateTile(const FTBTileHandle Tile);
+
+	// Adds Delta to the occupancy counts of the tile's block
+	void UpdateBlockSummary(const int32 X, const int32 Y, const ETBMammalSpecies Species, const int32 Delta);
+
+	// Streams chunk meshes in and out around the camera, only used in sparse mode
+	void UpdateStreamedChunks();
+
+	// Assigns a pooled mesh component to the chunk, creating one if needed
+	void StreamInChunk(const int32 ChunkX, const int32 ChunkY);
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void DestroyBorderWalls();
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -80,24 +449,196 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "Square Map Generation")
 	virtual bool GenerateSquareMap();
+
+#if WITH_EDITOR
+	// Generates the map with the current settings into BakedMap, without spawning anything. Save the asset afterwards.
+	UFUNCTION(CallInEditor, Category = "Square Map Generation|Baking")
+	void BakeMap();
+#endif
 	
 	virtual FActorSpawnParameters GetActorSpawnParameters();
 	
 	FVector GetTileHalfExtents() const;
 
+	FORCEINLINE int32 GetSquareMapSize() const { return SquareMapSize; }
+
+	// World location of the tile at the given coordinates, works for unallocated chunks too
+	FVector GetTileWorldLocation(const int32 X, const int32 Y) const;
+
+	FVector GetTileWorldLocation(const FTBTileHandle Tile) const;
+
 	/**
-	 * @brief Gets the tile in the specified direction from the given SourceTile tile.
+	 * @brief Gets the handle of the tile at the given coordinates. Never allocates.
+	 * @return If the coordinates are inside the map returns the tile handle, otherwise returns an invalid handle.
+	 */
+	FTBTileHandle GetTileAt(const int32 X, const int32 Y) const;
+
+	// Returns true if the handle is set and belongs to the current map
+	FORCEINLINE bool IsValidTile(const FTBTileHandle Tile) const
+	{
+		return Tile.IsValid() && Tile.GetGeneration() == MapGeneration && Tile.GetIndex() < static_cast<uint32>(SquareMapSize * SquareMapSize);
+	}
+
+	FORCEINLINE FIntPoint GetTileCoordinates(const FTBTileHandle Tile) const
+	{
+		return FIntPoint(Tile.GetIndex() % SquareMapSize, Tile.GetIndex() / SquareMapSize);
+	}
+
+	// Coordinates of the tile nearest to the world location, can be outside of the map
+	FIntPoint GetTileCoordinatesAtWorldLocation(const FVector& WorldLocation) const;
+
+	// Returns true if the tile is walkable and no mammal stands on it, so a mammal can move there. Never allocates. False for invalid handles.
+	bool IsTileEmpty(const FTBTileHandle Tile) const;
+
+	// Returns false for obstacle tiles and invalid handles
+	bool IsTileWalkable(const FTBTileHandle Tile) const;
+
+	/**
+	 * @brief Terrain of the tile at the given coordinates. It is a pure function of the coordinates and TerrainSeed, so it needs no storage.
+	 * @return Always Ground if ObstacleDensity is 0.
+	 */
+	ETBTerrainType GetTileTerrain(const int32 X, const int32 Y) const;
+
+	// Returns the mammal standing on the tile, or an invalid handle if the tile is empty
+	FTBMammalHandle GetTileOccupant(const FTBTileHandle Tile) const;
+
+	// Returns the species of the mammal standing on the tile. The tile must not be empty.
+	ETBMammalSpecies GetTileOccupantSpecies(const FTBTileHandle Tile) const;
+
+	// Returns true if a mammal of one of the species in SpeciesMask stands on the tile, see TBSpeciesBit
+	bool IsTileOccupiedBySpecies(const FTBTileHandle Tile, const uint8 SpeciesMask) const;
+
+	// Marks the tile as occupied by the given mammal and updates the block summary. In sparse mode allocates the tile's chunk.
+	void SetTileOccupant(const FTBTileHandle Tile, const FTBMammalHandle Mammal, const ETBMammalSpecies Species);
+
+	// Marks the tile as empty and updates the block summary
+	void ClearTile(const FTBTileHandle Tile);
+
+	// SetTileOccupant and ClearTile append the previous state of the tile to the journal until it is set to nullptr. Used by the round history.
+	FORCEINLINE void SetTileJournal(TArray<FTBTileDelta>* InTileJournal) { TileJournal = InTileJournal; }
+
+	// Puts the occupant of the delta back on its tile, or clears the tile if it was empty
+	void RestoreTile(const FTBTileDelta& Delta);
+
+	/**
+	 * @brief Queues a new world transform for the tile's instance. Changes are batched by contiguous instance ranges
+	 * and applied once per frame, the last change of a tile wins. Only dense maps have an instance per tile.
+	 * @return False if the tile has no instance.
+	 */
+	bool SetTileInstanceTransform(const FTBTileHandle Tile, const FTransform& Transform);
+
+	/**
+	 * @brief Queues a custom data value for the tile's instance, e.g. a highlight. Applied with the other changes once per frame.
+	 * @param DataIndex Must be lower than the NumCustomDataFloats of InstancedStaticMeshComponent.
+	 * @return False if the tile has no instance or the data index is out of range.
+	 */
+	bool SetTileInstanceCustomData(const FTBTileHandle Tile, const int32 DataIndex, const float Value);
+
+	// Applies the queued tile instance changes now and marks the render state dirty once
+	void FlushTileInstanceUpdates();
+
+	// Frees the allocated chunks that no mammal stands on. Only does work in sparse mode. Tile handles stay valid.
+	void ReleaseEmptyChunks();
+
+	// Calls Func(ChunkIndex, Chunk) for each allocated chunk with at least one mammal, chunks without mammals are skipped
+	template<typename FuncType>
+	void ForEachActiveChunk(FuncType Func) const
+	{
+		for(const int32 ChunkIndex : AllocatedChunkIndices)
+		{
+			if(BlockSummaries[ChunkIndex].GetNumMammals() > 0)
+			{
+				Func(ChunkIndex, *Chunks[ChunkIndex]);
+			}
+		}
+	}
+
+	// Appends the indices of the chunks with at least one mammal, e.g. to run a ParallelFor over the occupied area only
+	void GetActiveChunkIndices(TArray<int32>& OutChunkIndices) const;
+
+	/**
+	 * @brief Appends the tiles with a mammal of one of the species in SpeciesMask, see TBSpeciesBit.
+	 * Only the active chunks holding those species are read, a word of their species masks at a time, so the cost follows
+	 * the occupied area instead of the map size or the mammal actors. The tiles come in chunk order.
+	 */
+	void GetSpeciesTiles(const uint8 SpeciesMask, TArray<FTBTileHandle>& OutTiles) const;
+
+	FORCEINLINE int32 GetNumAllocatedChunks() const { return AllocatedChunkIndices.Num(); }
+
+	FORCEINLINE int32 GetNumChunksPerSide() const { return NumChunksPerSide; }
+
+	FORCEINLINE const FTBBlockSummary& GetBlockSummary(const int32 ChunkIndex) const { return BlockSummaries[ChunkIndex]; }
+
+	FORCEINLINE int32 GetTotalEmptyTiles() const { return TotalEmptyTiles; }
+
+	/**
+	 * @brief Counts the blocks by the fraction of their tiles taken by mammals of the species, in OutBins.Num() equal bins.
+	 * Blocks without the species count in bin 0. Reads the block summaries only.
+	 */
+	void GetBlockDensityHistogram(const ETBMammalSpecies Species, TArrayView<uint32> OutBins) const;
+
+	// Measures the memory currently used by the map
+	FTBMapMemoryStats GetMemoryStats() const;
+
+	/**
+	 * @brief Estimates the memory a map would use before generating it.
+	 * In sparse mode only the chunks in RenderChunkRadius are counted, chunks allocated by mammals come on top.
+	 * @param MapSize Number of tiles per side.
+	 * @param bSparse Whether the map uses the sparse grid.
+	 */
+	SIZE_T EstimateMapMemory(const int32 MapSize, const bool bSparse) const;
+
+	// Calls Func(TileHandle) for each neighbour of the tile inside the map. The topology is resolved once per call, not per neighbour.
+	template<typename FuncType>
+	FORCEINLINE void ForEachAdjacentTile(const FTBTileHandle SourceTile, FuncType Func) const
+	{
+		if(Chunks.Num() <= 0) return;
+
+		DispatchGridTopology(MapTopology, [this, SourceTile, &Func](auto TopologyTraits)
+		{
+			ForEachAdjacentTileOf<decltype(TopologyTraits)>(SourceTile, Func);
+		});
+	}
+
+	/**
+	 * @brief Gets the tile in the specified direction from the given SourceTile tile, through the neighbour the map's topology maps the direction to.
 	 * @param SourceTile The tile to check the direction from.
 	 * @param Direction The direction to check.
-	 * @return If valid, returns the tile in the given direction from the SourceTile, otherwise returns nullptr.
+	 * @return If valid, returns the tile in the given direction from the SourceTile, otherwise returns an invalid handle.
 	 */
-	FTileInfo* GetTileAtDirection(const FTileInfo* SourceTile, const EDirectionType Direction) const;
+	FTBTileHandle GetTileAtDirection(const FTBTileHandle SourceTile, const EDirectionType Direction) const;
+
+	// Max number of tiles GetAllAdjacentTiles can return for any topology, the capacity to use for fixed size adjacency arrays
+	static constexpr int32 MaxAdjacentTiles = TBMaxGridNeighbours;
+
+	// Returns only the empty adjacent tiles of the map's topology.
+	TArray<FTBTileHandle> GetAllAdjacentEmptyTiles(const FTBTileHandle SourceTile) const;
+
+	// Returns all adjacent tiles of the map's topology.
+	TArray<FTBTileHandle> GetAllAdjacentTiles(const FTBTileHandle SourceTile) const;
 
-	// Calls GetTileAtDirection for each direction and returns only empty adjacent tiles.
-	TArray<FTileInfo*> GetAllAdjacentEmptyTiles(const FTileInfo* SourceTile) const;
+	// Adds the empty adjacent tiles to OutTiles, which can be any array with Add, e.g. a TTBArenaArray with MaxAdjacentTiles capacity
+	template<typename ArrayType>
+	void GetAllAdjacentEmptyTiles(const FTBTileHandle SourceTile, ArrayType& OutTiles) const
+	{
+		ForEachAdjacentTile(SourceTile, [this, &OutTiles](const FTBTileHandle TileResult)
+		{
+			if(IsTileEmpty(TileResult))
+			{
+				OutTiles.Add(TileResult);
+			}
+		});
+	}
 
-	// Calls GetTileAtDirection for each direction and returns all adjacent tiles.
-	TArray<FTileInfo*> GetAllAdjacentTiles(const FTileInfo* SourceTile) const;
+	// Adds all adjacent tiles to OutTiles, which can be any array with Add
+	template<typename ArrayType>
+	void GetAllAdjacentTiles(const FTBTileHandle SourceTile, ArrayType& OutTiles) const
+	{
+		ForEachAdjacentTile(SourceTile, [&OutTiles](const FTBTileHandle TileResult)
+		{
+			OutTiles.Add(TileResult);
+		});
+	}
 	
-	FTileInfo* GetRandomEmptyTile() const;
+	FTBTileHandle GetRandomEmptyTile() const;
 };
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "TBTileHeatmapComponent.generated.h"
+
+class UTexture2D;
+class UMaterialInstanceDynamic;
+enum class ETBMammalSpecies : uint8;
+
+UENUM(BlueprintType)
+enum class ETBTileHeatmapMode : uint8
+{
+	// Heatmap is not written and the tile material is left untouched
+	Disabled,
+	// RGB is the occupant's CurrentTileColor, alpha is 255 on occupied tiles
+	TileColor,
+	// R is the species (0 empty, 1 cat, 2 mouse, species index + 1 for table species), G the starve counter, B the breed counter, alpha is 255 on occupied tiles
+	TileState
+};
+
+/**
+ * Keeps one texel per tile in a transient texture that the tile material samples. The whole board is rewritten into a
+ * CPU buffer and uploaded with a single texture region update per round, instead of touching actors or instance data.
+ * The tile material reads it through TextureParameterName and maps world XY to texels with MapParameterName.
+ */
+UCLASS(ClassGroup=(TurnBased))
+class TURNBASEDCATMOUSE_API UTBTileHeatmapComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTBTileHeatmapComponent();
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Tile Heatmap")
+	ETBTileHeatmapMode HeatmapMode;
+
+	// Written to the empty tiles in TileColor mode
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Tile Heatmap")
+	FColor EmptyTileColor;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Tile Heatmap")
+	FName TextureParameterName;
+
+	// Vector parameter set to (first tile X, first tile Y, tile size X, tile size Y). Tile size Y is negative because tile Y grows towards -Y,
+	// so the material can use (WorldXY - FirstTileXY) / TileSize + 0.5 as tile coordinates
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Tile Heatmap")
+	FName MapParameterName;
+
+	// Scalar parameter set to the number of tiles per side
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Tile Heatmap")
+	FName MapSizeParameterName;
+
+	// Heatmaps are only created for maps up to this size, bigger sparse maps would need a texture per chunk
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Tile Heatmap", meta = (ClampMin=2))
+	int MaxHeatmapSize;
+
+	UFUNCTION(BlueprintPure, Category = "Tile Heatmap")
+	UTexture2D* GetHeatmapTexture() const { return HeatmapTexture; }
+
+	/**
+	 * @brief Creates the heatmap texture for a new map and binds it to the tile material.
+	 * @param MeshComponent Tile mesh component, its material is replaced by a dynamic instance.
+	 * @param MapSize Number of tiles per side.
+	 * @param FirstTileLocation World location of the tile (0,0).
+	 * @param TileSize World size of a tile.
+	 * @return False if the heatmap is disabled or the map is too big.
+	 */
+	bool InitializeHeatmap(UPrimitiveComponent* MeshComponent, const int32 MapSize, const FVector& FirstTileLocation, const FVector2D& TileSize);
+
+	// Clears the CPU buffer, call before writing the tiles of a round
+	void BeginHeatmapUpdate();
+
+	// Writes a single occupied tile into the CPU buffer
+	void WriteTile(const FIntPoint& Coordinates, const FLinearColor& TileColor, const ETBMammalSpecies Species, const uint8 StarveCounter, const uint8 BreedCounter);
+
+	// Uploads the CPU buffer to the texture with one region update
+	void FlushHeatmap();
+
+	FORCEINLINE bool IsHeatmapActive() const { return HeatmapTexture != nullptr; }
+
+	// CPU buffer and texture memory
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	UPROPERTY(Transient)
+	UTexture2D* HeatmapTexture;
+
+	UPROPERTY(Transient)
+	UMaterialInstanceDynamic* TileMaterialInstance;
+
+	// One texel per tile, row major, Y down
+	TArray<FColor> TexelBuffer;
+
+	int32 HeatmapSize;
+};
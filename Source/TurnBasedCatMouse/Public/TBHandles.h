@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Generational handle stored in a 32-bit integer. The low IndexBits select a slot, the remaining high bits hold the slot's generation,
+ * so a handle to a freed or regenerated slot fails to resolve instead of dangling.
+ * Handles are plain values and can be copied, compared, hashed and serialized freely.
+ */
+template<uint32 InIndexBits, typename TagType>
+struct TTBHandle
+{
+	using StorageType = uint32;
+
+	static constexpr uint32 IndexBits = InIndexBits;
+	static constexpr uint32 GenerationBits = 32 - IndexBits;
+	static constexpr StorageType IndexMask = (StorageType(1) << IndexBits) - 1;
+
+	// Generations wrap before reaching the all ones pattern, so a valid handle is never equal to InvalidValue
+	static constexpr StorageType NumGenerations = (StorageType(1) << GenerationBits) - 1;
+	static constexpr uint32 MaxIndex = IndexMask;
+	static constexpr StorageType InvalidValue = ~StorageType(0);
+
+	TTBHandle() : Value(InvalidValue) {}
+
+	static FORCEINLINE TTBHandle Make(const uint32 Index, const StorageType Generation)
+	{
+		checkSlow(Index <= MaxIndex && Generation < NumGenerations);
+		TTBHandle Handle;
+		Handle.Value = (Generation << IndexBits) | Index;
+		return Handle;
+	}
+
+	static FORCEINLINE StorageType GetNextGeneration(const StorageType Generation) { return (Generation + 1) % NumGenerations; }
+
+	FORCEINLINE bool IsValid() const { return Value != InvalidValue; }
+	FORCEINLINE uint32 GetIndex() const { return Value & IndexMask; }
+	FORCEINLINE StorageType GetGeneration() const { return Value >> IndexBits; }
+	FORCEINLINE StorageType GetValue() const { return Value; }
+	FORCEINLINE void Reset() { Value = InvalidValue; }
+
+	FORCEINLINE bool operator==(const TTBHandle& Other) const { return Value == Other.Value; }
+	FORCEINLINE bool operator!=(const TTBHandle& Other) const { return Value != Other.Value; }
+
+	friend FORCEINLINE uint32 GetTypeHash(const TTBHandle& Handle) { return ::GetTypeHash(Handle.Value); }
+
+	friend FArchive& operator<<(FArchive& Ar, TTBHandle& Handle) { return Ar << Handle.Value; }
+
+private:
+	StorageType Value;
+};
+
+// Tile index (Y * SquareMapSize + X) and map generation. 28 index bits cover the largest sparse map (16384x16384),
+// the 4 generation bits make a handle kept from one of the last 14 maps fail to resolve.
+using FTBTileHandle = TTBHandle<28, struct FTBTileHandleTag>;
+
+// Slot in the manager's mammal slot array and the slot's generation. Up to ~1M mammals alive at once.
+using FTBMammalHandle = TTBHandle<20, struct FTBMammalHandleTag>;
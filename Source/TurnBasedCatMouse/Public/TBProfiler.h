@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "TBStats.h"
+
+// Named CPU scopes of the game. Round only covers the whole round when moves are instant, otherwise the part StartNextRound runs.
+enum class ETBProfileScope : uint8
+{
+	Generation,
+	Spawning,
+	Round,
+	BuildFields,
+	Move,
+	Eat,
+	Breed,
+	Starve,
+	Num
+};
+
+// Totals and percentiles of a scope over the samples of a profiling run
+struct FTBProfileSummaryRow
+{
+	FString Scenario;
+	FString Scope;
+	int64 Calls = 0;
+
+	// Number of samples the scope ran in, percentiles are over these
+	int32 Samples = 0;
+
+	double TotalMs = 0;
+	double MeanMs = 0;
+	double P50Ms = 0;
+	double P90Ms = 0;
+	double P99Ms = 0;
+	double MaxMs = 0;
+};
+
+/**
+ * Adds up the time of the TB_PROFILE_SCOPE scopes while it is collecting. Each EndSample turns the time since the
+ * previous one into one sample per scope, the profiling scenarios take a sample per round.
+ * The scopes are also Unreal Insights CPU events and cycle counters of "stat TurnBased", which work without a profiler.
+ * Only the game thread is measured.
+ */
+class TURNBASEDCATMOUSE_API FTBProfiler
+{
+public:
+	FTBProfiler();
+	~FTBProfiler();
+
+	// Makes this the profiler the scopes report to, and clears its samples
+	void Begin();
+
+	// Closes the open sample and stops collecting
+	void End();
+
+	// Closes the open sample, scopes that didn't run in it get no sample
+	void EndSample();
+
+	// Appends a row per scope that ran, tagged with the scenario
+	void GetSummary(const FString& Scenario, TArray<FTBProfileSummaryRow>& OutRows) const;
+
+	FORCEINLINE static FTBProfiler* GetActive() { return ActiveProfiler; }
+
+	// Called by the scopes, ignored off the game thread
+	void AddTime(const ETBProfileScope Scope, const uint64 Cycles);
+
+	static const TCHAR* GetScopeName(const ETBProfileScope Scope);
+
+	// Writes the rows as CSV, one row per scenario and scope
+	static bool SaveSummary(const FString& FilePath, const TArray<FTBProfileSummaryRow>& Rows);
+
+	// Reads a file of SaveSummary. False if it is missing or has no rows.
+	static bool LoadSummary(const FString& FilePath, TArray<FTBProfileSummaryRow>& OutRows);
+
+	/**
+	 * @brief Logs a warning for each scenario and scope whose mean or 90th percentile grew by more than Threshold over the baseline.
+	 * Scopes faster than MinComparedMs in the baseline are too noisy to compare and skipped.
+	 * @param Threshold Allowed growth as a fraction, 0.1 is 10%.
+	 * @return Number of regressions.
+	 */
+	static int32 CompareToBaseline(const TArray<FTBProfileSummaryRow>& Rows, const TArray<FTBProfileSummaryRow>& BaselineRows, const float Threshold);
+
+	// Baseline mean and 90th percentile below this are not compared
+	static constexpr double MinComparedMs = 0.05;
+
+private:
+	static FTBProfiler* ActiveProfiler;
+
+	// Time and calls of the open sample
+	uint64 SampleCycles[static_cast<int32>(ETBProfileScope::Num)];
+	int64 SampleCalls[static_cast<int32>(ETBProfileScope::Num)];
+
+	int64 TotalCalls[static_cast<int32>(ETBProfileScope::Num)];
+	TArray<double> SamplesMs[static_cast<int32>(ETBProfileScope::Num)];
+};
+
+// Times its lifetime into the active profiler, if any
+struct FTBProfileScopeTimer
+{
+	FORCEINLINE explicit FTBProfileScopeTimer(const ETBProfileScope InScope)
+		: Scope(InScope), StartCycles(FTBProfiler::GetActive() ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	FORCEINLINE ~FTBProfileScopeTimer()
+	{
+		if(StartCycles != 0 && FTBProfiler::GetActive())
+		{
+			FTBProfiler::GetActive()->AddTime(Scope, FPlatformTime::Cycles64() - StartCycles);
+		}
+	}
+
+private:
+	ETBProfileScope Scope;
+	uint64 StartCycles;
+};
+
+// Names a CPU scope for Unreal Insights, "stat TurnBased" and the active FTBProfiler. Scope is a value of ETBProfileScope.
+#define TB_PROFILE_SCOPE(Scope) \
+	TRACE_CPUPROFILER_EVENT_SCOPE(TB_##Scope); \
+	SCOPE_CYCLE_COUNTER(STAT_TB##Scope); \
+	FTBProfileScopeTimer PREPROCESSOR_JOIN(TBProfileScopeTimer_, __LINE__)(ETBProfileScope::Scope)
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Fixed capacity array living in an FTBRoundArena. It never frees or grows, the memory goes away with the next arena reset.
+ * Only for trivially destructible types like handles.
+ */
+template<typename ElementType>
+class TTBArenaArray
+{
+	static_assert(TIsTriviallyDestructible<ElementType>::Value, "TTBArenaArray elements are never destructed");
+
+public:
+	TTBArenaArray() = default;
+
+	TTBArenaArray(ElementType* InData, const int32 InCapacity)
+		: Data(InData), ArrayNum(0), ArrayMax(InCapacity)
+	{
+	}
+
+	FORCEINLINE void Add(const ElementType& Element)
+	{
+		check(ArrayNum < ArrayMax);
+		Data[ArrayNum++] = Element;
+	}
+
+	// Keeps the order of the remaining elements, like TArray::RemoveAt
+	void RemoveAt(const int32 Index)
+	{
+		check(Index >= 0 && Index < ArrayNum);
+		for(int32 i = Index; i < ArrayNum - 1; i++)
+		{
+			Data[i] = Data[i + 1];
+		}
+		ArrayNum--;
+	}
+
+	FORCEINLINE void Reset() { ArrayNum = 0; }
+
+	// Shrinks the array, it can't grow past the elements that were added
+	FORCEINLINE void SetNum(const int32 NewNum) { check(NewNum >= 0 && NewNum <= ArrayNum); ArrayNum = NewNum; }
+
+	FORCEINLINE int32 Num() const { return ArrayNum; }
+
+	FORCEINLINE int32 Max() const { return ArrayMax; }
+
+	FORCEINLINE ElementType& operator[](const int32 Index) { check(Index >= 0 && Index < ArrayNum); return Data[Index]; }
+	FORCEINLINE const ElementType& operator[](const int32 Index) const { check(Index >= 0 && Index < ArrayNum); return Data[Index]; }
+
+	FORCEINLINE ElementType* begin() { return Data; }
+	FORCEINLINE ElementType* end() { return Data + ArrayNum; }
+	FORCEINLINE const ElementType* begin() const { return Data; }
+	FORCEINLINE const ElementType* end() const { return Data + ArrayNum; }
+
+private:
+	ElementType* Data = nullptr;
+	int32 ArrayNum = 0;
+	int32 ArrayMax = 0;
+};
+
+/**
+ * Linear allocator for the temporary data of a round. Allocations are a pointer bump and are all released together by Reset.
+ * If a round needs more than the block, the rest is served from overflow allocations and the block grows to the peak on the next reset,
+ * so after a few rounds every reset is O(1).
+ */
+class TURNBASEDCATMOUSE_API FTBRoundArena
+{
+public:
+	explicit FTBRoundArena(const SIZE_T InitialBlockSize = 16 * 1024);
+	~FTBRoundArena();
+
+	FTBRoundArena(const FTBRoundArena&) = delete;
+	FTBRoundArena& operator=(const FTBRoundArena&) = delete;
+
+	void* Allocate(const SIZE_T Size, const SIZE_T Alignment);
+
+	// Allocates an empty array that can hold Capacity elements
+	template<typename ElementType>
+	TTBArenaArray<ElementType> AllocateArray(const int32 Capacity)
+	{
+		ElementType* Data = static_cast<ElementType*>(Allocate(sizeof(ElementType) * Capacity, alignof(ElementType)));
+		return TTBArenaArray<ElementType>(Data, Capacity);
+	}
+
+	// Releases all allocations. Everything allocated before is invalid afterwards.
+	void Reset();
+
+	// Bytes allocated since the last reset
+	FORCEINLINE SIZE_T GetUsedBytes() const { return BlockOffset + OverflowBytes; }
+
+	// Bytes used by the round before the last reset
+	FORCEINLINE SIZE_T GetLastPeakBytes() const { return LastPeakBytes; }
+
+	FORCEINLINE SIZE_T GetBlockSize() const { return BlockSize; }
+
+private:
+	uint8* Block;
+	SIZE_T BlockSize;
+	SIZE_T BlockOffset;
+
+	// Allocations that did not fit in the block, freed on reset
+	TArray<void*> OverflowAllocations;
+	SIZE_T OverflowBytes;
+
+	SIZE_T LastPeakBytes;
+};
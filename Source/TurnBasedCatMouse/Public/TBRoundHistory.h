@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+
+// Mammal slots per record page, pages are the unit checkpoints share and copy
+static constexpr int32 TBRoundHistoryPageSize = 256;
+
+// State of a slot of the manager's mammal slot array at the end of a round
+struct FTBMammalRecord
+{
+	// Handle of the mammal living in the slot, invalid if the slot is free
+	FTBMammalHandle Handle;
+	FTBTileHandle Tile;
+	ETBMammalSpecies Species = ETBMammalSpecies::Cat;
+	uint8 StarveCounter = 0;
+	uint8 BreedCounter = 0;
+	uint8 SavedBreedCounter = 0;
+
+	FORCEINLINE bool IsAlive() const { return Handle.IsValid(); }
+
+	FORCEINLINE bool operator==(const FTBMammalRecord& Other) const
+	{
+		return Handle == Other.Handle && Tile == Other.Tile && Species == Other.Species && StarveCounter == Other.StarveCounter
+			&& BreedCounter == Other.BreedCounter && SavedBreedCounter == Other.SavedBreedCounter;
+	}
+
+	FORCEINLINE bool operator!=(const FTBMammalRecord& Other) const { return !(*this == Other); }
+};
+
+// Previous record of a slot that changed during a round
+struct FTBMammalDelta
+{
+	int32 SlotIndex = 0;
+	FTBMammalRecord OldRecord;
+};
+
+// Changes of one round, undone in reverse order
+struct FTBRoundDelta
+{
+	int32 Round = 0;
+	TArray<FTBTileDelta> TileDeltas;
+	TArray<FTBMammalDelta> MammalDeltas;
+};
+
+struct FTBMammalRecordPage
+{
+	FTBMammalRecord Records[TBRoundHistoryPageSize];
+};
+
+// Mammal records at the end of a round. Pages are shared with the live records until one side writes to them.
+struct FTBRoundCheckpoint
+{
+	int32 Round = 0;
+	TArray<TSharedPtr<FTBMammalRecordPage>> Pages;
+};
+
+/**
+ * Lets a game step back to an earlier round without a full snapshot per round.
+ * Each round keeps the tiles the map generator changed and the mammal records that changed, so undoing a round costs
+ * time proportional to its changes, not to the board size. The mammal records live in copy on write pages, and every
+ * CheckpointInterval rounds a checkpoint shares the current pages. Restoring a checkpoint only compares the pages
+ * written since, and checkpoints stay available after the deltas of their rounds are dropped.
+ * The manager records at round boundaries, rewinds bring the grid and the records back and the manager updates the actors.
+ */
+class TURNBASEDCATMOUSE_API FTBRoundHistory
+{
+public:
+	FTBRoundHistory();
+	~FTBRoundHistory();
+
+	/**
+	 * @brief Forgets the previous history and starts a new one at Round. The records of the living mammals have to be
+	 * written with RecordMammal, EndRound then takes the first checkpoint.
+	 * @param InMapGenerator Map whose tile changes are recorded.
+	 * @param InCheckpointInterval A checkpoint is taken at the end of every round that is a multiple of this.
+	 * @param InMaxRewindRounds Number of rounds whose deltas are kept.
+	 * @param InMaxCheckpoints Number of checkpoints kept, the oldest is dropped first.
+	 */
+	void Start(ATBSquareMapGenerator* InMapGenerator, const int32 Round, const int32 InCheckpointInterval, const int32 InMaxRewindRounds, const int32 InMaxCheckpoints);
+
+	// Drops every delta and checkpoint and stops recording
+	void Reset();
+
+	// Opens the delta of the next round, the map's tile changes are recorded into it until EndRound
+	void BeginRound(const int32 Round);
+
+	// Closes the round, takes a checkpoint if the round is on the interval and drops what is past the limits
+	void EndRound();
+
+	// Writes the record of a slot, the previous record goes to the open round's delta if it changed
+	void RecordMammal(const int32 SlotIndex, const FTBMammalRecord& Record);
+
+	// True if the round can be restored, either from the kept deltas or from a checkpoint of that round
+	bool CanRewindTo(const int32 TargetRound) const;
+
+	/**
+	 * @brief Brings the map grid and the records back to the end of TargetRound and forgets the rounds after it.
+	 * Uses the oldest checkpoint not before TargetRound, then undoes the deltas of the rounds between.
+	 * @param OutChangedSlots Slots whose record changed, the caller brings their mammals in line with GetRecord.
+	 * @return False if the round can't be restored, nothing is changed then.
+	 */
+	bool RewindTo(const int32 TargetRound, TArray<int32>& OutChangedSlots);
+
+	// Record of the slot at the last recorded round, a free slot record if the slot was never used
+	const FTBMammalRecord& GetRecord(const int32 SlotIndex) const;
+
+	FORCEINLINE bool IsActive() const { return MapGenerator != nullptr; }
+
+	// True between BeginRound and EndRound
+	FORCEINLINE bool IsRoundOpen() const { return bIsRoundOpen; }
+
+	FORCEINLINE int32 GetCurrentRound() const { return CurrentRound; }
+
+	// Oldest round the deltas reach back to, older rounds can only be restored from their checkpoints
+	int32 GetOldestDeltaRound() const;
+
+	FORCEINLINE int32 GetNumCheckpoints() const { return Checkpoints.Num(); }
+
+	// Bytes of the deltas and of the record pages, pages shared by checkpoints are counted once
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	ATBSquareMapGenerator* MapGenerator;
+
+	// Records at the end of CurrentRound, written in place when a page is not shared
+	TArray<TSharedPtr<FTBMammalRecordPage>> Pages;
+
+	// Deltas of consecutive rounds, the last one is open during a round
+	TArray<FTBRoundDelta> Deltas;
+
+	// Oldest first
+	TArray<FTBRoundCheckpoint> Checkpoints;
+
+	int32 CurrentRound;
+	int32 CheckpointInterval;
+	int32 MaxRewindRounds;
+	int32 MaxCheckpoints;
+	bool bIsRoundOpen;
+
+	// Record of the slot for writing, copies its page first if a checkpoint shares it
+	FTBMammalRecord& GetWritableRecord(const int32 SlotIndex);
+
+	// Replaces the records with the checkpoint's and moves the grid occupants of the slots that differ
+	void RestoreCheckpoint(const FTBRoundCheckpoint& Checkpoint, TSet<int32>& ChangedSlots);
+
+	// Undoes the tile and mammal changes of the delta in reverse order
+	void UndoDelta(const FTBRoundDelta& Delta, TSet<int32>& ChangedSlots);
+};
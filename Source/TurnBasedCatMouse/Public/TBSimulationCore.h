@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TBHandles.h"
+#include "SquareMapGeneration/TBGridFields.h"
+#include "SquareMapGeneration/TBSquareMapGenerator.h"
+#include "Mammals/TBSpeciesTraits.h"
+
+// Rules of one species, copied from the mammal class defaults
+struct FTBSpeciesRules
+{
+	uint8 StarvationTurnCount = 3;
+	uint8 BreedTurnCount = 0;
+	bool bCanEat = false;
+	bool bCanStarve = false;
+	bool bCanBreed = true;
+	bool bCanHunt = true;
+	bool bCanEvade = true;
+
+	// Species bits of the mammals it eats, already masked by the species traits
+	uint8 PreyMask = 0;
+};
+
+// Everything the rules read besides the board, copied from the manager when the core is initialized
+struct FTBSimulationSettings
+{
+	FTBSpeciesRules CatRules;
+	FTBSpeciesRules MouseRules;
+
+	// ETBMammalProcessingOrder::ZOrder, mammals are sorted every ZOrderSortInterval rounds
+	bool bSortByZOrder = false;
+	int32 ZOrderSortInterval = 10;
+
+	bool bEnableCatHunting = false;
+	int32 MaxHuntDistance = 64;
+	bool bEnableMouseEvasion = false;
+	int32 ThreatRadius = 3;
+};
+
+enum class ETBRoundEventType : uint8
+{
+	// Mammal moved from FromTile to Tile
+	Move,
+	// Mammal moved from FromTile to Tile and ate OtherMammalId standing there
+	Eat,
+	// Mammal was born on Tile, OtherMammalId is the parent
+	Birth,
+	// Mammal starved on Tile
+	Starve
+};
+
+// One change of a round, in the order the rules made it
+struct FTBRoundEvent
+{
+	ETBRoundEventType Type = ETBRoundEventType::Move;
+	uint32 MammalId = 0;
+	uint32 OtherMammalId = 0;
+	FTBTileHandle FromTile;
+	FTBTileHandle Tile;
+};
+
+// State of a mammal at the end of a round
+struct FTBMammalSnapshot
+{
+	uint32 Id = 0;
+	ETBMammalSpecies Species = ETBMammalSpecies::Cat;
+	FTBTileHandle Tile;
+	uint8 StarveCounter = 0;
+	uint8 BreedCounter = 0;
+	uint8 SavedBreedCounter = 0;
+};
+
+// Outcome of one simulated round: the events to replay and the population after it
+struct FTBRoundResult
+{
+	int32 Round = 0;
+
+	TArray<FTBRoundEvent> Events;
+
+	// Cats then mice, in turn order
+	TArray<FTBMammalSnapshot> Mammals;
+	int32 NumCats = 0;
+	int32 NumMice = 0;
+
+	int32 CatsBorn = 0;
+	int32 MiceBorn = 0;
+	int32 CatsStarved = 0;
+	int32 MiceStarved = 0;
+	int32 MiceEaten = 0;
+
+	// Keeps the memory for the next round
+	void Reset();
+
+	FORCEINLINE SIZE_T GetAllocatedSize() const { return Events.GetAllocatedSize() + Mammals.GetAllocatedSize(); }
+};
+
+/**
+ * The cat and mouse rules without actors. Mammals are plain arrays indexed by slot and the board is a flat occupant array,
+ * so a round can be stepped on any thread. Reproduces ATBMammalBase and ATBTurnedBasedManager turn for turn, including
+ * the order of the random calls, so the same random sequence gives the same game.
+ * The map is only read for its topology and walkability, which don't change during a game.
+ */
+class TURNBASEDCATMOUSE_API FTBSimulationCore
+{
+public:
+	// Occupant arrays are 4 bytes per tile, bigger maps are not simulated
+	static constexpr int32 MaxMapSize = 4096;
+
+	/**
+	 * @brief Clears the core and binds it to a map.
+	 * @param InMap The map to simulate on, it must outlive the core or the next Initialize.
+	 * @param InSettings Rules of the game.
+	 * @param InRound Round the board is at, StepRound plays the one after it.
+	 * @return False if the map is too big.
+	 */
+	bool Initialize(const ATBSquareMapGenerator* InMap, const FTBSimulationSettings& InSettings, const int32 InRound);
+
+	// Drops the mammals and the map
+	void Reset();
+
+	/**
+	 * @brief Adds a mammal at the end of its species' turn order. The tile must be empty.
+	 * @return Id of the mammal, ids are never reused.
+	 */
+	uint32 AddMammal(const ETBMammalSpecies Species, const FTBTileHandle Tile, const uint8 StarveCounter, const uint8 BreedCounter, const uint8 SavedBreedCounter);
+
+	// Replaces the rules for the next rounds
+	FORCEINLINE void SetSettings(const FTBSimulationSettings& InSettings) { Settings = InSettings; }
+
+	// Random calls use this stream, so the core can run off the game thread
+	void SetRandomSeed(const int32 Seed);
+
+	// Random calls use FMath::RandRange like the actors instead of the stream. Only safe on the game thread.
+	FORCEINLINE void SetUseGlobalRandom(const bool bInUseGlobalRandom) { bUseGlobalRandom = bInUseGlobalRandom; }
+
+	// Plays one round and writes its events and the new population to OutResult
+	void StepRound(FTBRoundResult& OutResult);
+
+	// Writes the current population to OutResult.Mammals, cats then mice in turn order
+	void WriteSnapshot(FTBRoundResult& OutResult) const;
+
+	FORCEINLINE bool IsInitialized() const { return Map != nullptr; }
+	FORCEINLINE int32 GetCurrentRound() const { return CurrentRound; }
+	FORCEINLINE int32 GetNumCats() const { return Cats.Num(); }
+	FORCEINLINE int32 GetNumMice() const { return Mice.Num(); }
+
+	// Id of the mammal on the tile, or 0 if it is empty
+	uint32 GetTileOccupantId(const FTBTileHandle Tile) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	const ATBSquareMapGenerator* Map = nullptr;
+	FTBSimulationSettings Settings;
+	int32 CurrentRound = 0;
+
+	FRandomStream RandomStream;
+	bool bUseGlobalRandom = false;
+
+	// Per slot mammal data, slots of dead mammals are reused
+	TArray<uint32> Ids;
+	TArray<ETBMammalSpecies> Species;
+	TArray<FTBTileHandle> Tiles;
+	TArray<uint8> StarveCounters;
+	TArray<uint8> BreedCounters;
+	TArray<uint8> SavedBreedCounters;
+	TArray<int32> FreeSlots;
+
+	// Ids start at 1, 0 is no mammal
+	uint32 NextId = 1;
+
+	// Slot of the mammal on each tile, INDEX_NONE if empty. Indexed by tile handle index.
+	TArray<int32> TileOccupants;
+
+	// Slots in turn order
+	TArray<int32> Cats;
+	TArray<int32> Mice;
+
+	// Same lists and quirks as the manager's AllMammalsToBreed and MammalsToStarve
+	TArray<int32> MammalsToBreed;
+	TArray<int32> MammalsToStarve;
+
+	FTBDistanceField PreyDistanceField;
+	FTBInfluenceMap ThreatInfluenceMap;
+
+	FORCEINLINE const FTBSpeciesRules& GetRules(const int32 Slot) const
+	{
+		return Species[Slot] == ETBMammalSpecies::Cat ? Settings.CatRules : Settings.MouseRules;
+	}
+
+	FORCEINLINE bool IsTileEmpty(const FTBTileHandle Tile) const
+	{
+		return TileOccupants[Tile.GetIndex()] == INDEX_NONE && Map->IsTileWalkable(Tile);
+	}
+
+	// Same call and range as UKismetMathLibrary::RandomIntegerInRange
+	int32 RandomIntegerInRange(const int32 Min, const int32 Max);
+
+	int32 AllocateSlot();
+	void ReleaseSlot(const int32 Slot);
+
+	void SortByZOrder(TArray<int32>& Slots) const;
+	void BuildRoundFields();
+
+	// ATBMammalBase::ExecuteTurn and OnMoveFinished, specialized for the species of the mammal in the slot
+	template<ETBMammalSpecies InSpecies>
+	void ExecuteTurn(const int32 Slot, FTBRoundResult& Result);
+
+	// Removes the eaten mammal, like ATBTurnedBasedManager::OnKillRequested
+	void KillMammal(const int32 Slot);
+
+	// ATBTurnedBasedManager::TryBreedMammals and TryStarveMammals
+	void TryBreedMammals(FTBRoundResult& Result);
+	void TryStarveMammals(FTBRoundResult& Result);
+};
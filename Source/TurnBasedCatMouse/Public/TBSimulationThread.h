@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+#include "TBSimulationCore.h"
+
+class FRunnableThread;
+
+enum class ETBSimulationCommandType : uint8
+{
+	// Simulate rounds until paused or the result queue is full
+	Start,
+	// Stop after the current round and drop the steps that are left
+	Pause,
+	// Simulate at least NumRounds more rounds from now, the rounds simulated while running count towards them
+	Step,
+	// Replace the rules, the rounds that are already simulated keep the old ones
+	SetSettings
+};
+
+struct FTBSimulationCommand
+{
+	ETBSimulationCommandType Type = ETBSimulationCommandType::Pause;
+	int32 NumRounds = 0;
+	FTBSimulationSettings Settings;
+};
+
+/**
+ * Runs a simulation core on its own thread, independent of the game thread and the frame rate.
+ * Commands come in and round results go out through single producer, single consumer lock free queues, so neither
+ * side ever takes a lock. Results are pooled: the game thread hands every result back with RecycleResult.
+ * Only the game thread may call the public functions.
+ */
+class TURNBASEDCATMOUSE_API FTBSimulationThread : public FRunnable
+{
+public:
+	/**
+	 * @brief Takes over the core and starts the thread paused.
+	 * @param InCore An initialized core with the starting population.
+	 * @param InMaxQueuedResults The thread stops simulating while this many results wait for the game thread.
+	 */
+	FTBSimulationThread(FTBSimulationCore&& InCore, const int32 InMaxQueuedResults);
+
+	// Stops and joins the thread
+	virtual ~FTBSimulationThread() override;
+
+	FTBSimulationThread(const FTBSimulationThread&) = delete;
+	FTBSimulationThread& operator=(const FTBSimulationThread&) = delete;
+
+	void StartRounds();
+	void PauseRounds();
+	void StepRounds(const int32 NumRounds);
+	void SetSettings(const FTBSimulationSettings& Settings);
+
+	// Returns the oldest queued result, or nullptr if there is none
+	FTBRoundResult* DequeueResult();
+
+	// Gives a dequeued result back to the thread's pool, it must not be used afterwards
+	void RecycleResult(FTBRoundResult* Result);
+
+	// Waits until a result is queued or the timeout passes
+	void WaitForResult(const uint32 WaitTimeMs) const;
+
+	// True once a species is extinct, no more results will be queued
+	FORCEINLINE bool IsFinished() const { return FPlatformAtomics::AtomicRead(&bIsFinished) != 0; }
+
+	// Game thread mirror of the last Start or Pause command
+	FORCEINLINE bool IsRunning() const { return bIsRunningRequested; }
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+private:
+	// Only touched by the simulation thread after construction
+	FTBSimulationCore Core;
+	bool bIsRunning;
+	int32 NumStepsLeft;
+
+	// Every result ever allocated, so the destructor can free the ones in the queues
+	TArray<TUniquePtr<FTBRoundResult>> AllocatedResults;
+
+	TQueue<FTBSimulationCommand, EQueueMode::Spsc> Commands;
+	TQueue<FTBRoundResult*, EQueueMode::Spsc> Results;
+	TQueue<FTBRoundResult*, EQueueMode::Spsc> RecycledResults;
+
+	// Wakes the simulation thread for a command or free space in the result queue
+	FEvent* WakeEvent;
+
+	// Wakes the game thread when a result is queued
+	FEvent* ResultEvent;
+
+	FRunnableThread* Thread;
+
+	int32 MaxQueuedResults;
+	volatile int32 NumQueuedResults;
+	volatile int32 bIsFinished;
+	volatile int32 bIsStopRequested;
+
+	bool bIsRunningRequested;
+
+	void EnqueueCommand(FTBSimulationCommand&& Command);
+};
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+// Shown with "stat TurnBased"
+DECLARE_STATS_GROUP(TEXT("TurnBased"), STATGROUP_TurnBased, STATCAT_Advanced);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Tile Chunks"), STAT_TBTileChunkMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Block Summaries"), STAT_TBBlockSummaryMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Tile Meshes"), STAT_TBTileMeshMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Tile Heatmap"), STAT_TBTileHeatmapMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Mammal Actors"), STAT_TBMammalActorMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Mammal Bookkeeping"), STAT_TBMammalBookkeepingMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Round Arena Peak"), STAT_TBRoundArenaMemory, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+
+// Cycle counters of the TB_PROFILE_SCOPE scopes, see TBProfiler.h
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generation"), STAT_TBGeneration, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawning"), STAT_TBSpawning, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Round"), STAT_TBRound, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build Fields"), STAT_TBBuildFields, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Move"), STAT_TBMove, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Eat"), STAT_TBEat, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Breed"), STAT_TBBreed, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Starve"), STAT_TBStarve, STATGROUP_TurnBased, TURNBASEDCATMOUSE_API);
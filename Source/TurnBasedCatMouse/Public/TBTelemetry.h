@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+
+class FRunnableThread;
+
+// Number of equal bins of the block density histograms
+static constexpr int32 TBTelemetryDensityBins = 16;
+
+// Integer and float columns of a record, in the order FTBTelemetryBlock::AddRound writes them
+static constexpr int32 TBTelemetryNumIntColumns = 8 + TBTelemetryDensityBins * 2;
+static constexpr int32 TBTelemetryNumFloatColumns = 6;
+
+// One row of the telemetry, the state of the game after a finished round
+struct FTBTelemetryRecord
+{
+	int32 Round = 0;
+	int32 AliveCats = 0;
+	int32 AliveMice = 0;
+	int32 CatsBorn = 0;
+	int32 MiceBorn = 0;
+	int32 CatsStarved = 0;
+	int32 MiceStarved = 0;
+	int32 MiceEaten = 0;
+
+	// Wall time of the round phases in ms, see FTBRoundStats
+	float RoundMs = 0;
+	float BuildFieldsMs = 0;
+	float TurnsMs = 0;
+	float BreedMs = 0;
+	float StarveMs = 0;
+	float GarbageCollectionMs = 0;
+
+	// Number of blocks by the fraction of their tiles taken by the species, see ATBSquareMapGenerator::GetBlockDensityHistogram
+	uint32 CatDensity[TBTelemetryDensityBins] = {};
+	uint32 MouseDensity[TBTelemetryDensityBins] = {};
+};
+
+// Records stored column by column, the unit the writer thread encodes and writes
+struct TURNBASEDCATMOUSE_API FTBTelemetryBlock
+{
+	int32 NumRounds = 0;
+
+	// NumRounds values per column
+	TArray<int64> IntColumns[TBTelemetryNumIntColumns];
+	TArray<float> FloatColumns[TBTelemetryNumFloatColumns];
+
+	void AddRound(const FTBTelemetryRecord& Record);
+
+	// Writes row RowIndex back into a record
+	void GetRound(const int32 RowIndex, FTBTelemetryRecord& OutRecord) const;
+
+	// Keeps the memory for the next block
+	void Reset();
+
+	void Reserve(const int32 NumRoundsToReserve);
+
+	// Names of the columns in file order
+	static void GetColumnNames(TArray<FString>& OutIntColumnNames, TArray<FString>& OutFloatColumnNames);
+};
+
+/**
+ * Streams round records to a file on its own thread. The game thread only appends to the current block, full blocks
+ * go to the writer thread through a single producer, single consumer lock free queue and come back to a pool once written.
+ * Integer columns are delta and varint encoded, so a round usually takes a few dozen bytes.
+ * If the writer falls so far behind that every pooled block is queued, rounds are dropped instead of blocking the game thread.
+ * Only the game thread may call the public functions.
+ */
+class TURNBASEDCATMOUSE_API FTBTelemetryWriter : public FRunnable
+{
+public:
+	/**
+	 * @brief Creates the file, writes its header and starts the writer thread.
+	 * @param InFilePath File to write, an existing file is replaced.
+	 * @param InRoundsPerBlock Rounds collected before a block is handed to the writer thread.
+	 * @param InMaxBlocks Max number of blocks in flight, which bounds the memory of the writer.
+	 */
+	FTBTelemetryWriter(const FString& InFilePath, const int32 InRoundsPerBlock, const int32 InMaxBlocks);
+
+	// Writes the partial block and joins the thread, the file is complete afterwards
+	virtual ~FTBTelemetryWriter() override;
+
+	FTBTelemetryWriter(const FTBTelemetryWriter&) = delete;
+	FTBTelemetryWriter& operator=(const FTBTelemetryWriter&) = delete;
+
+	// False if the file could not be created, records are ignored then
+	FORCEINLINE bool IsOpen() const { return Thread != nullptr; }
+
+	void AddRound(const FTBTelemetryRecord& Record);
+
+	// Hands the partial block to the writer thread
+	void Flush();
+
+	FORCEINLINE const FString& GetFilePath() const { return FilePath; }
+	FORCEINLINE int64 GetNumDroppedRounds() const { return NumDroppedRounds; }
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+	// First bytes of the file and of each block, "TBTM" and "TBLK"
+	static constexpr uint32 FileMagic = 0x4D544254;
+	static constexpr uint32 BlockMagic = 0x4B4C4254;
+
+	// Version of the file format, readers refuse other versions
+	static constexpr uint32 FileVersion = 2;
+
+private:
+	FString FilePath;
+
+	// Only touched by the writer thread after the header is written
+	TUniquePtr<FArchive> FileWriter;
+	TArray<uint8> EncodeBuffer;
+
+	// Every block ever allocated, the queues only pass pointers around
+	TArray<TUniquePtr<FTBTelemetryBlock>> AllocatedBlocks;
+
+	// Block the game thread is filling, nullptr until the next round needs one
+	FTBTelemetryBlock* CurrentBlock;
+
+	TQueue<FTBTelemetryBlock*, EQueueMode::Spsc> FullBlocks;
+	TQueue<FTBTelemetryBlock*, EQueueMode::Spsc> RecycledBlocks;
+
+	// Wakes the writer thread for a full block or the stop request
+	FEvent* WakeEvent;
+
+	FRunnableThread* Thread;
+
+	int32 RoundsPerBlock;
+	int32 MaxBlocks;
+	int64 NumDroppedRounds;
+	volatile int32 bIsStopRequested;
+
+	// A recycled block or a new one while under MaxBlocks, nullptr if all of them are queued
+	FTBTelemetryBlock* AcquireBlock();
+
+	void WriteBlock(const FTBTelemetryBlock& Block);
+};
+
+/**
+ * Reads a file of FTBTelemetryWriter block by block, so files of millions of rounds are read in constant memory.
+ * Also available as the TB.ReadTelemetry console command, which logs a summary and can convert the file to CSV.
+ */
+class TURNBASEDCATMOUSE_API FTBTelemetryReader
+{
+public:
+	// Opens the file and reads its header. False if it is missing or of another format version.
+	bool Open(const FString& FilePath);
+
+	// Reads the next block, false at the end of the file or at a truncated block
+	bool ReadNextBlock(FTBTelemetryBlock& OutBlock);
+
+	FORCEINLINE const TArray<FString>& GetIntColumnNames() const { return IntColumnNames; }
+	FORCEINLINE const TArray<FString>& GetFloatColumnNames() const { return FloatColumnNames; }
+
+	/**
+	 * @brief Reads the whole file, logs a summary of the populations and the phase timings, and optionally writes it as CSV.
+	 * @param FilePath Telemetry file to read.
+	 * @param CsvFilePath CSV file to write, nothing is written if empty.
+	 * @return False if the file can't be read.
+	 */
+	static bool Summarize(const FString& FilePath, const FString& CsvFilePath);
+
+private:
+	TUniquePtr<FArchive> FileReader;
+	TArray<uint8> DecodeBuffer;
+	TArray<FString> IntColumnNames;
+	TArray<FString> FloatColumnNames;
+};
@@ -4,16 +4,177 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Mammals/TBMammalMovementSystem.h"
+#include "TBHandles.h"
+#include "TBRoundArena.h"
+#include "TBRoundHistory.h"
+#include "SquareMapGeneration/TBGridFields.h"
+#include "TBSimulationCore.h"
+#include "TBSimulationThread.h"
+#include "TBTelemetry.h"
+#include "Tasks/Task.h"
 #include "TBTurnedBasedManager.generated.h"
 
-struct FTileInfo;
 class ATBMammalBase;
 class ATBSquareMapGenerator;
+class UTBMammalCluster;
+
+UENUM(BlueprintType)
+enum class ETBMammalProcessingOrder : uint8
+{
+	// Mammals take their turns in spawn order
+	SpawnOrder,
+
+	// Mammals are periodically sorted along a Z-order curve of their tiles, so consecutive turns touch nearby tiles
+	ZOrder
+};
+
+// Row of the manager's species table
+USTRUCT(BlueprintType)
+struct FTBSpeciesDefinition
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Species")
+	TSubclassOf<ATBMammalBase> MammalClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Species", meta = (ClampMin=0))
+	int32 NumberToSpawn = 0;
+
+	// Rows of the species table this species eats, its row of the predator-prey matrix
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Species")
+	TArray<int32> PreySpecies;
+};
+
+// Fixed game the profiling mode plays, see ATBTurnedBasedManager::RunProfilingScenarios
+USTRUCT(BlueprintType)
+struct FTBProfilingScenario
+{
+	GENERATED_BODY()
+public:
+	// Name of the scenario in the summary and the baseline, without commas
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Profiling")
+	FString Name;
+
+	// Overrides the SquareMapSize of the map generator class
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Profiling", meta = (ClampMin=1))
+	int32 MapSize = 64;
+
+	// Spawn counts of the cats and the mice, rows 0 and 1 of the species table
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Profiling", meta = (ClampMin=0))
+	int32 NumCats = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Profiling", meta = (ClampMin=0))
+	int32 NumMice = 256;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Profiling")
+	int32 Seed = 1;
+
+	// Max number of rounds to play, fewer if a species dies out
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Profiling", meta = (ClampMin=1))
+	int32 Rounds = 200;
+};
+
+// Compact snapshot of the game published once per round, the HUD listens to OnRoundStatsUpdated instead of polling getters
+USTRUCT(BlueprintType)
+struct FTBRoundStats
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 Round = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	bool bIsRoundOngoing = false;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 AliveCats = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 AliveMice = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 CatsBorn = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 MiceBorn = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 CatsStarved = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 MiceStarved = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int32 MiceEaten = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	float AverageCatStarveCounter = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	float AverageCatBreedCounter = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	float AverageMouseBreedCounter = 0;
+
+	// Living mammals of each species, in species table order. The cat and mouse fields above are rows 0 and 1.
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	TArray<int32> AliveMammalsBySpecies;
+
+	// Peak usage of the manager's round arena during the round
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats")
+	int64 RoundArenaPeakBytes = 0;
+
+	// Wall time from the start of the round until it finished, in ms. Includes the time moves were animated.
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats|Timings")
+	float RoundMs = 0;
+
+	// Wall time of the round phases in ms. Only the turns are timed when the round was simulated by the pipeline, as the time it was presented.
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats|Timings")
+	float BuildFieldsMs = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats|Timings")
+	float TurnsMs = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats|Timings")
+	float BreedMs = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats|Timings")
+	float StarveMs = 0;
+
+	// Time the engine spent collecting garbage since the previous round finished, in ms. Covers reachability and unhashing,
+	// and the destruction of the unreachable objects when it isn't spread over the following frames.
+	UPROPERTY(BlueprintReadOnly, Category = "Round Stats|Timings")
+	float GarbageCollectionMs = 0;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnRoundStatsUpdatedSignature, const FTBRoundStats&, RoundStats);
+
+// Hidden actors of dead mammals of one species, reused by the next spawns
+USTRUCT()
+struct FTBMammalPool
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	TArray<TObjectPtr<ATBMammalBase>> Mammals;
+};
+
+// Slot of the manager's mammal slot array, addressed by FTBMammalHandle
+struct FTBMammalSlot
+{
+	ATBMammalBase* Mammal = nullptr;
+	uint32 Generation = 0;
+};
 
 UCLASS()
 class TURNBASEDCATMOUSE_API ATBTurnedBasedManager : public AActor
 {
 	GENERATED_BODY()
+
+	// plays games on both sides and compares them after every round
+	friend class FTBSimulationCoreMatchesActorsTest;
+
 public:
 	// Sets default values for this actor's properties
 	ATBTurnedBasedManager();
@@ -35,24 +196,131 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Turned Based Manager")
 	int NumberOfMiceToSpawn;
 
+	/* Species of the game in turn order, up to TBMaxSpecies rows. Rows 0 and 1 are the cats and mice of the stats and the win events.
+	 * If empty, the table is CatClass then MouseClass with the spawn counts above, each eating the species of its EatableMammalClass.
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Turned Based Manager|Species")
+	TArray<FTBSpeciesDefinition> SpeciesTable;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Turned Based Manager")
 	float StartNextRoundTime;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager")
 	bool bAutoStartNextRound;
 
+	// Order in which the mammals of a species take their turns. Species play in species table order.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager")
+	ETBMammalProcessingOrder MammalProcessingOrder;
+
+	// Cats and mice are sorted again every ZOrderSortInterval rounds when MammalProcessingOrder is ZOrder
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager", meta = (ClampMin=1))
+	int ZOrderSortInterval;
+
+	// If true, mammals jump to their target tiles and StartNextRound plays the whole round synchronously. Used for headless runs and benchmarks.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager")
+	bool bInstantMoves;
+
+	// A warning is logged when the estimated memory of the mammal actors goes above this
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager", meta = (ClampMin=0))
+	float MammalMemoryBudgetMB;
+
+	// Dead mammal actors of each species kept hidden for the next births instead of being destroyed, 0 destroys them right away.
+	// Destroying a clustered actor dissolves the cluster, it is created again at the end of the next round.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager", meta = (ClampMin=0))
+	int MaxPooledMammals;
+
+	// If true, cooked builds put the live and pooled mammal actors in one garbage collection cluster.
+	// Not used with per mammal debug widgets, the widgets they create later would be outside the cluster.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager")
+	bool bClusterMammalActors;
+
+	// If true, cats that can't eat step towards the nearest mouse instead of moving randomly, using a distance field built once per round
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Hunting")
+	bool bEnableCatHunting;
+
+	// Cats notice mice up to this many steps away when hunting
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Hunting", meta = (ClampMin=1))
+	int MaxHuntDistance;
+
+	// If true, mice move to the adjacent tile with the least cat threat, using an influence map built once per round
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Evasion")
+	bool bEnableMouseEvasion;
+
+	// Every cat threatens the tiles up to this many tiles away on each axis
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Evasion", meta = (ClampMin=1))
+	int ThreatRadius;
+
+	// If true, the rules run in a simulation core that computes the next round on a worker task while the actors animate the current one.
+	// Read when a game starts, ignored with bInstantMoves. Rule and hunting settings are copied at that point too.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Pipeline")
+	bool bPipelineRounds;
+
+	// If true, pipelined games run the simulation core on a dedicated thread instead of one task per round.
+	// The thread runs ahead on its own while bAutoStartNextRound is true, otherwise it is driven by the simulation commands.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Pipeline")
+	bool bUseSimulationThread;
+
+	// Max number of simulated rounds waiting to be presented, the simulation thread pauses when it gets this far ahead
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Pipeline", meta = (ClampMin=1))
+	int MaxQueuedSimulatedRounds;
+
+	// If true, every game streams its round stats, block density histograms and phase timings to a telemetry file.
+	// Read when a game starts. Read the files back with the TB.ReadTelemetry console command.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Telemetry")
+	bool bExportTelemetry;
+
+	// Directory of the telemetry files, Saved/Telemetry of the project if empty
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Telemetry")
+	FString TelemetryDirectory;
+
+	// Rounds collected on the game thread before they are handed to the writer thread
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Telemetry", meta = (ClampMin=1))
+	int TelemetryRoundsPerBlock;
+
+	// If true, every round records the tiles and mammals it changed, so RewindRounds can step the game back. Read when a game starts, pipelined games have no history.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Rollback")
+	bool bEnableRoundHistory;
+
+	// The round history shares its state as a checkpoint every this many rounds
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Rollback", meta = (ClampMin=1))
+	int RoundHistoryCheckpointInterval;
+
+	// Number of rounds that can be rewound one by one
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Rollback", meta = (ClampMin=1))
+	int MaxRewindRounds;
+
+	// Checkpoints kept, rounds older than MaxRewindRounds can still be restored if they have one
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Rollback", meta = (ClampMin=1))
+	int MaxRoundHistoryCheckpoints;
+
+	// Games played by RunProfilingScenarios and the -TBProfile command line
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Profiling")
+	TArray<FTBProfilingScenario> ProfilingScenarios;
+
+	// A scope regresses when its mean or 90th percentile round time grows by more than this fraction of the baseline
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Turned Based Manager|Profiling", meta = (ClampMin=0))
+	float ProfilingRegressionThreshold;
+
+	// Number of finished rounds kept in the round stats history
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Turned Based Manager", meta = (ClampMin=1))
+	int RoundStatsHistorySize;
+
 	//
 
+	// Called when a round starts and when it finishes with the new stats
+	UPROPERTY(BlueprintAssignable, Category = "Turned Based Manager|Events")
+	FOnRoundStatsUpdatedSignature OnRoundStatsUpdated;
+
 	UPROPERTY(BlueprintReadOnly)
 	ATBSquareMapGenerator* SquareMapGeneratorRef;
 private:
 	int CurrentRound;
 
-	// Index of the next cat to move in current round. Resets to zero after each round
-	int CurrentCatIndex;
+	// Species whose mammals are taking their turns
+	int CurrentTurnSpecies;
 
-	// Index of the next cat to move in current round. Resets to zero after each round
-	int CurrentMouseIndex;
+	// Index of the next mammal of CurrentTurnSpecies to play. Both reset to zero at the start of each round.
+	int NextTurnIndex;
 
 	// All living cats
 	TArray<ATBMammalBase*> Cats;
@@ -60,6 +328,19 @@ private:
 	// All living mice
 	TArray<ATBMammalBase*> Mice;
 
+	// All living mammals of the species after the cats and the mice, by species index - 2
+	TArray<ATBMammalBase*> OtherSpeciesMammals[TBMaxSpecies - 2];
+
+	// SpeciesTable, or the table built from the cat and mouse settings, for the current game
+	TArray<FTBSpeciesDefinition> ActiveSpecies;
+
+	// Predator-prey matrix, bit P of row S is set if species S eats species P
+	uint8 SpeciesPreyMasks[TBMaxSpecies];
+
+	// Species eaten by any species, and species that eat any
+	uint8 PreySpeciesMask;
+	uint8 PredatorSpeciesMask;
+
 	/* Mammals in this list are going to breed after move turns finished.
 	 * If breed was successful and finished for the mammal it will be removed from this list.
 	 */
@@ -69,19 +350,185 @@ private:
 	TArray<ATBMammalBase*> MammalsToStarve;
 
 	bool bIsRoundOngoing;
+
+	// True while DispatchTurns is starting turns
+	bool bIsDispatchingTurns;
+
+	// Set when a turn finishes while DispatchTurns is running
+	bool bHasPendingTurn;
+
+	// Temporary arrays of the current round are allocated here and released at once in OnRoundFinished
+	FTBRoundArena RoundArena;
+
+	// Distance to the nearest mouse, built at the start of each round when bEnableCatHunting is true
+	FTBDistanceField PreyDistanceField;
+
+	// Number of cats around each tile, built at the start of each round when bEnableMouseEvasion is true
+	FTBInfluenceMap ThreatInfluenceMap;
+
+	// Interpolates the moves of all mammals, the manager only ticks while it has active moves
+	FTBMammalMovementSystem MovementSystem;
+
+	// Living mammals by handle index. Freed slots are reused with the next generation.
+	TArray<FTBMammalSlot> MammalSlots;
+
+	// Indices of the unused slots in MammalSlots
+	TArray<int32> FreeMammalSlots;
+
+	// Pools by species index. Spawning and destroying an actor per birth and death would create and collect its UObjects every round.
+	UPROPERTY(Transient)
+	TArray<FTBMammalPool> MammalPools;
+
+	// Root of the cluster of the mammal actors of the game while bClusterMammalActors is used, null otherwise
+	UPROPERTY(Transient)
+	TObjectPtr<UTBMammalCluster> MammalCluster;
+
+	// Garbage collection time since the last finished round, and the start of the running collection, in cycles.
+	// It spans the pre and post collect delegates: reachability analysis, unhashing, and the purge of the unreachable
+	// objects when the engine purges in full. An incremental purge in the following frames isn't counted.
+	uint64 GarbageCollectionCycles;
+	uint64 GarbageCollectionStartCycles;
+	FDelegateHandle PreGarbageCollectHandle;
+	FDelegateHandle PostGarbageCollectHandle;
 	
 	FTimerHandle TimerHandle_StartNextRound;
 
+	// Stats of the current round, births and deaths are counted as they happen
+	FTBRoundStats CurrentRoundStats;
+
+	// Ring buffer of the stats of the finished rounds, RoundStatsHistoryHead is the oldest entry once it is full
+	TArray<FTBRoundStats> RoundStatsHistory;
+	int32 RoundStatsHistoryHead;
+
+	// Estimated size of one mammal actor with its components, averaged over the species of the game from their class defaults
+	SIZE_T EstimatedBytesPerMammal;
+
+	// Set while the population is over MammalMemoryBudgetMB, so the warning is logged once per crossing
+	bool bIsOverMammalMemoryBudget;
+
+	// Set once a round field failed to build for the map size, so the warning is logged once per game
+	bool bHasWarnedFieldMapSize;
+
+	// True if the running game is simulated by SimulationCore, the actors only present its results
+	bool bIsPipelineActive;
+
+	// True while the moves of FrontRoundResult are animated, the round finishes when they all arrive
+	bool bIsPresentingRound;
+
+	// Board of a pipelined game, one round ahead of the actors. Only PendingRoundTask touches it while the task runs.
+	FTBSimulationCore SimulationCore;
+
+	// Round the actors present and round the worker writes, swapped when the next round starts
+	FTBRoundResult FrontRoundResult;
+	FTBRoundResult BackRoundResult;
+
+	// Worker task simulating the next round into BackRoundResult
+	UE::Tasks::FTask PendingRoundTask;
+
+	// Bytes of SimulationCore and the round results, measured each time before PendingRoundTask is launched so the stats never read them while it runs
+	SIZE_T PipelineBookkeepingBytes;
+
+	// Actors of the mammals of SimulationCore by simulation id
+	TMap<uint32, ATBMammalBase*> SimulatedMammals;
+
+	// Owns the simulation core when bUseSimulationThread is true, SimulationCore is empty then
+	TUniquePtr<FTBSimulationThread> SimulationThread;
+
+	// Rounds asked for with StepSimulation that were not presented yet, StartNextRound keeps polling for them while the thread is paused
+	int32 NumSteppedSimulationRounds;
+
+	// Set while StartNextRound found no queued round, it retries every frame while the thread is running or stepped
+	bool bIsWaitingForSimulatedRound;
+
+	// Writes the telemetry file of the running game, null unless bExportTelemetry was set when it started
+	TUniquePtr<FTBTelemetryWriter> TelemetryWriter;
+
+	// Tile and mammal changes of the past rounds, only recorded while bEnableRoundHistory was set when the game started
+	FTBRoundHistory RoundHistory;
+
+	// Size of the next generated map instead of the generator's SquareMapSize if above 0, set by the profiling scenarios
+	int32 MapSizeOverride;
+
+	// Topology of the next generated map instead of the generator's GridTopology if set, set by the automation tests
+	TOptional<ETBGridTopology> GridTopologyOverride;
+
+	// Start of the current round and of its turns, in cycles
+	uint64 RoundStartCycles;
+	uint64 TurnsStartCycles;
+
 private:
 	/**
 	 * @brief Spawns a mammal on the given tile and sets references accordingly.
-	 * @param MammalClass The class of the mammal to spawn.
+	 * @param Species The species table row of the mammal to spawn.
 	 * @param TargetTile The tile to spawn mammal on.
 	 * @return Returns a pointer to the spawned mammal.
 	 */
-	ATBMammalBase* SpawnMammal(TSubclassOf<ATBMammalBase> MammalClass, FTileInfo* TargetTile) const;
+	ATBMammalBase* SpawnMammal(const ETBMammalSpecies Species, const FTBTileHandle TargetTile);
+
+	// Spawns the actor of a mammal on the tile without a handle and without occupying the tile
+	ATBMammalBase* SpawnMammalActor(const ETBMammalSpecies Species, const FTBTileHandle TargetTile);
+
+	// Clears the mammal's tile, releases its handle and pools or destroys its actor
+	void DestroyMammal(ATBMammalBase* Mammal);
+
+	// Hides the actor in the pool of its species, or destroys it if the pool is full
+	void ReleaseMammalActor(ATBMammalBase* Mammal);
+
+	// Number of actors in the mammal pools
+	int32 GetNumPooledMammals() const;
+
+	// True if the mammal actors of this game go into MammalCluster
+	bool ShouldClusterMammalActors() const;
+
+	// Time the garbage collections for the round stats
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
+
+	// Binds the events the mammal's place in the food web needs, sets the refs and adds the mammal to its species list
+	void AddSpawnedMammal(ATBMammalBase* Mammal);
+
+	// Fills ActiveSpecies and the predator-prey matrix from SpeciesTable, or from the cat and mouse settings if it is empty
+	void BuildSpeciesTable();
+
+	// True for exactly the cat eats mouse food web of the species traits, the only one the simulation core plays
+	bool IsBuiltInFoodWeb() const;
+
+	FORCEINLINE int32 GetNumSpecies() const { return ActiveSpecies.Num(); }
+
+	FORCEINLINE TArray<ATBMammalBase*>& GetMammalsOfSpecies(const ETBMammalSpecies Species)
+	{
+		const int32 SpeciesIndex = static_cast<int32>(Species);
+		return SpeciesIndex == 0 ? Cats : SpeciesIndex == 1 ? Mice : OtherSpeciesMammals[SpeciesIndex - 2];
+	}
+
+	FORCEINLINE const TArray<ATBMammalBase*>& GetMammalsOfSpecies(const ETBMammalSpecies Species) const
+	{
+		return const_cast<ATBTurnedBasedManager*>(this)->GetMammalsOfSpecies(Species);
+	}
+
+	// Number of living mammals of all species
+	int32 GetNumMammals() const;
+
+	// Calls Func for every living mammal, species in turn order
+	template<typename FuncType>
+	void ForEachMammal(FuncType Func) const
+	{
+		for(int32 SpeciesIndex = 0; SpeciesIndex < GetNumSpecies(); SpeciesIndex++)
+		{
+			for(ATBMammalBase* Mammal : GetMammalsOfSpecies(static_cast<ETBMammalSpecies>(SpeciesIndex)))
+			{
+				Func(Mammal);
+			}
+		}
+	}
+
+	// Assigns a slot to the mammal and returns its handle
+	FTBMammalHandle AllocateMammalHandle(ATBMammalBase* Mammal);
+
+	// Frees the slot of the handle, the handle and its copies no longer resolve
+	void ReleaseMammalHandle(const FTBMammalHandle Handle);
 	
-	// Spawns cats and mouse at random tiles
+	// Spawns the mammals of each species at random tiles
 	void InitSpawnMammals();
 
 	// Tries to breed mammals in AllMammalsToBreed list at the end of each round.
@@ -89,6 +536,78 @@ private:
 
 	// Tries to starve mammals in MammalsToStarve list at the end of each round.
 	void TryStarveMammals();
+
+	// Starts turns until one of them has to wait for its move to finish, or the round ends
+	void DispatchTurns();
+
+	// Starts the turn of the next cat, or the next mouse after all cats played, or finishes the round
+	void ExecuteNextTurn();
+
+	// Sorts the mammals by the Z-order (Morton) code of their tiles
+	void SortMammalsByZOrder(TArray<ATBMammalBase*>& Mammals) const;
+
+	// Estimated size of one actor of the class with its default components, 0 if there is no class
+	static SIZE_T EstimateMammalClassMemory(const TSubclassOf<ATBMammalBase> MammalClass);
+
+	// Logs a warning if NumMammals mammal actors would go over MammalMemoryBudgetMB
+	void CheckMammalMemoryBudget(const int32 NumMammals);
+
+	// Bytes used by the manager's mammal arrays, slots and the movement system
+	SIZE_T GetMammalBookkeepingBytes() const;
+
+	// Pushes the current memory usage to the TurnBased stats group
+	void UpdateMemoryStats() const;
+
+	// Rebuilds or drops the per round grid fields the mammals read during their turns
+	void BuildRoundFields();
+
+	// Fills the population and average counters of CurrentRoundStats, adds it to the history and broadcasts it
+	void PublishFinishedRoundStats();
+
+	// Opens a new telemetry file for the game that starts if bExportTelemetry is true
+	void StartTelemetry();
+
+	// Writes the rest of the telemetry of the game and closes its file
+	void StopTelemetry();
+
+	// Appends the finished round to the telemetry file, rounds republished by a rewind are not written again
+	void RecordTelemetry();
+
+	// Writes the records of the living mammals to the round history and closes the round there
+	void RecordRoundHistory();
+
+	// Spawns, destroys or moves the mammals of the slots so they match their round history records. The grid must already match.
+	void ApplyMammalRecords(const TArray<int32>& SlotIndices);
+
+	// Rewrites the heatmap and the debug overlay counters from the living mammals
+	void UpdateBoardViews();
+
+	// Copies the spawned mammals and the rules to SimulationCore and starts simulating the first round
+	void StartRoundPipeline();
+
+	// Waits for the worker and drops the simulation core
+	void StopRoundPipeline();
+
+	// Starts simulating the next round into BackRoundResult, unless one of the species is extinct
+	void LaunchNextSimulatedRound();
+
+	// Rules of the current settings and mammal classes for the simulation core. False if a mammal class is missing or the food web is not the built in one.
+	bool MakeSimulationSettings(FTBSimulationSettings& OutSettings) const;
+
+	// Tries StartNextRound again next frame if it is waiting for the simulation thread
+	void PollSimulatedRound();
+
+	/**
+	 * @brief Compares the actor game with the core after the same round, used by the simulation core automation test.
+	 * @param Core The core that played the round.
+	 * @param Result The core's result of the round, its snapshot is compared with Cats and Mice.
+	 * @param OutDivergence Description of the first difference found.
+	 * @return True if both states are identical.
+	 */
+	bool MatchesSimulationCore(const FTBSimulationCore& Core, const FTBRoundResult& Result, FString& OutDivergence) const;
+
+	// Replays the events of a simulated round on the actors and the map, and starts animating the moves
+	void PresentRoundResult(const FTBRoundResult& Result);
 protected:
 	UFUNCTION(BlueprintImplementableEvent, Category = "Turned Based Manager|Events")
 	void OnCatsWin();
@@ -132,6 +651,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -147,6 +668,89 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager")
 	void StartNextRound();
 
+	// Destroys the map and all mammals, StartTurnBasedGame can be called again afterwards
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager")
+	void ResetTurnBasedGame();
+
+	/**
+	 * @brief Plays the same seeded game with spawn order and with Z-order mammal processing and logs the round times.
+	 * Restarts a normal game afterwards. Also available as the TB.BenchmarkMammalOrdering console command.
+	 * @param Rounds Max number of rounds to play for each ordering.
+	 * @param Seed Random seed used for both runs.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager")
+	void BenchmarkMammalOrdering(const int Rounds, const int Seed);
+
+	/**
+	 * @brief Steps the game back between two rounds, using the round history. The rounds after the target are forgotten,
+	 * so the game can be played on with other settings or another seed. The turn order of the mammals can differ from the original game.
+	 * Also available as the TB.RewindRounds console command.
+	 * @param Rounds Number of rounds to go back.
+	 * @param Seed Seed of the random sequence of the following rounds, the sequence is left as is if negative.
+	 * @return False if there is no history, a round is ongoing or the round is no longer in the history.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager|Rollback")
+	bool RewindRounds(const int Rounds, const int Seed);
+
+	/**
+	 * @brief Plays each of the ProfilingScenarios headless with instant moves and times the TB_PROFILE_SCOPE scopes per round.
+	 * Writes the per scope totals and percentiles to Saved/Profiling and compares them with the baseline, logging each regression.
+	 * Restarts a normal game afterwards. Also available as the TB.Profile console command and with -TBProfile on the command line,
+	 * e.g. "-nullrhi -TBProfile -TBProfileBaseline=Path -TBProfileThreshold=0.1 -TBProfileTrace", which exits with 1 on a regression.
+	 * @param BaselinePath Summary to compare with, Saved/Profiling/TBProfileBaseline.csv if empty. Written from this run if it doesn't exist.
+	 * @param RegressionThreshold Allowed growth over the baseline as a fraction, 0.1 is 10%.
+	 * @param bCaptureTrace If true, an Unreal Insights trace of the CPU scopes is written next to the summary.
+	 * @return False if a scope regressed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager|Profiling")
+	bool RunProfilingScenarios(const FString& BaselinePath, const float RegressionThreshold, const bool bCaptureTrace);
+
+	// Lets the simulation thread run ahead, up to MaxQueuedSimulatedRounds rounds. Only with bUseSimulationThread.
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager|Pipeline")
+	void ResumeSimulation();
+
+	// Stops the simulation thread after the current round and drops the steps that are left. Queued rounds are still presented.
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager|Pipeline")
+	void PauseSimulation();
+
+	// Asks the simulation thread to advance Rounds rounds from now. Rounds it simulates while running count towards them,
+	// so a step taken while running doesn't add rounds after a later pause.
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager|Pipeline")
+	void StepSimulation(const int Rounds);
+
+	// Sends the current rule, hunting and evasion settings to the simulation core, rounds that are already simulated keep the old ones
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager|Pipeline")
+	void ApplySimulationSettings();
+
+	// Logs the memory of the map and the mammals by subsystem. Also available as the TB.MemoryReport console command.
+	UFUNCTION(BlueprintCallable, Category = "Turned Based Manager")
+	void LogMemoryReport() const;
+
+	/**
+	 * @brief Starts interpolating the mammal to the target location, ATBMammalBase::OnMoveFinished is called when it arrives.
+	 * @param Mammal The mammal to move.
+	 * @param TargetLocation The world location to move to.
+	 */
+	void RequestMammalMove(ATBMammalBase* Mammal, const FVector& TargetLocation);
+
+	// Distance to the nearest mouse at the start of the round, not built unless bEnableCatHunting is true
+	FORCEINLINE const FTBDistanceField& GetPreyDistanceField() const { return PreyDistanceField; }
+
+	// Cat threat around each tile at the start of the round, not built unless bEnableMouseEvasion is true
+	FORCEINLINE const FTBInfluenceMap& GetThreatInfluenceMap() const { return ThreatInfluenceMap; }
+
+	// Arena for temporaries that live until the end of the current round
+	FORCEINLINE FTBRoundArena& GetRoundArena() { return RoundArena; }
+
+	// Returns the mammal of the handle in O(1), or nullptr if the handle is invalid or the mammal is dead
+	FORCEINLINE ATBMammalBase* ResolveMammal(const FTBMammalHandle Handle) const
+	{
+		if(!Handle.IsValid() || !MammalSlots.IsValidIndex(Handle.GetIndex())) return nullptr;
+
+		const FTBMammalSlot& Slot = MammalSlots[Handle.GetIndex()];
+		return Slot.Generation == Handle.GetGeneration() ? Slot.Mammal : nullptr;
+	}
+
 	UFUNCTION(BlueprintPure, Category = "Turn Based Manager") FORCEINLINE
 	int GetCurrentRound() const { return CurrentRound; }
 
@@ -158,5 +762,13 @@ public:
 
 	UFUNCTION(BlueprintPure, Category = "Turn Based Manager") FORCEINLINE
 	bool GetIsRoundOnGoing() const {return bIsRoundOngoing; }
+
+	// Returns the last published stats
+	UFUNCTION(BlueprintPure, Category = "Turn Based Manager") FORCEINLINE
+	FTBRoundStats GetLatestRoundStats() const { return CurrentRoundStats; }
+
+	// Copies the stats of the finished rounds, oldest first
+	UFUNCTION(BlueprintCallable, Category = "Turn Based Manager")
+	void GetRoundStatsHistory(TArray<FTBRoundStats>& OutRoundStats) const;
 	
 };